@@ -0,0 +1,10 @@
+#ifndef CAMERA2_GUARD
+#define CAMERA2_GUARD
+
+// Shared by every 2D program, set once per frame with App.glSetUniform("Proj")
+layout (std140) uniform Camera2
+{
+	vec4 Proj; // Camera x, y, aspect ratio and scale
+};
+
+#endif
@@ -7,7 +7,7 @@ layout (location = 3) in vec4 Idx0;
 layout (location = 4) in vec4 Idx1;
 layout (location = 5) in mat2x4 Extra;
 
-uniform vec4 Proj;
+#include "Assets/PGA2/camera2.glsl"
 
 out vec4 Frag_Color;
 
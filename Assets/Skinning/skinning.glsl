@@ -9,9 +9,13 @@ layout (location = 3) in ivec4 Idx0;
 layout (location = 4) in ivec4 Idx1;
 layout (location = 5) in mat2x4 Extra;
 
-uniform vec4 Proj;
-uniform motor Model;
-uniform motor Bones[3];
+#include "Assets/PGA2/camera2.glsl"
+
+layout (std140) uniform Skin
+{
+	motor Model;
+	motor Bones[3];
+};
 
 out vec4 Frag_Color;
 out vec2 Frag_UV; 
@@ -5,10 +5,12 @@
 #include <cstdlib>
 #include <type_traits>
 #include <tuple>
+#include <utility>
 #include <string>
 #include <array>
 #include <vector>
 #include <unordered_map>
+#include <atomic>
 
 // Macros
 #ifndef _DEBUG
@@ -40,10 +42,20 @@
 #define LOGW(format, ...) GASandbox::App::Log(true, __FILE__, __LINE__, __func__, 0xFF00FFFF, format, ##__VA_ARGS__)
 #define LOGE(format, ...) GASandbox::App::Log(true, __FILE__, __LINE__, __func__, 0xFF0000FF, format, ##__VA_ARGS__)
 
+// Scoped profiler zone, the name must outlive the capture (string literal)
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#ifdef GASANDBOX_NO_PROFILE
+#define PROFILE(name) ((void)0)
+#else
+#define PROFILE(name) GASandbox::sProfZone PROFILE_CONCAT(profZone, __LINE__)(name)
+#endif
+
 #define ASSERT(condition, message) \
     do { \
         if (!(condition)) { \
 			LOGE("Assertion failed: %s", message); \
+			GASandbox::App::LogFlush(); \
             std::abort(); \
         } \
     } while (false)
@@ -211,15 +223,41 @@ namespace GASandbox
 	}
 
 	// File
+	// Strings are interned by the file backend and stay valid until App::FileShutdown
 	struct sFileInfo
 	{
-		string path{};
-		string name{};
-		string ext{};
+		cstring path{ "" };
+		cstring name{ "" };
+		cstring ext{ "" };
 
 		size_type pathHash{ 0 };
 		size_type nameHash{ 0 };
 		size_type extHash{ 0 };
+
+		i64 writeTime{ 0 };			// Set when listed while watching
+		size_type contentHash{ 0 }; // Set when listed while watching, 0 otherwise
+	};
+
+	// Read only bytes of a file, released by App::FileUnmap or when the view goes out of scope. Loose files are read into
+	// a heap copy since they may be rewritten at any time, pack entries are handed out in place and cache and baked
+	// files are mapped. The bytes are always followed by a zero so text can go straight to C style parsers.
+	struct sFileView
+	{
+		cstring data{ nullptr };
+		size_type size{ 0 };
+		bool mapped{ false };	// Pages mapped from the file, otherwise a heap copy (or nothing for an empty file)
+		void* copy{ nullptr };
+
+		sFileView() = default;
+		sFileView(sFileView&& other);
+		sFileView& operator=(sFileView&& other);
+		~sFileView();
+
+		sFileView(const sFileView&) = delete;
+		sFileView& operator=(const sFileView&) = delete;
+
+		bool empty() const { return size == 0; }
+		string str() const { return string(data ? data : "", size); }
 	};
 
 	// Window
@@ -254,6 +292,21 @@ namespace GASandbox
 	enum struct eGlBufferUsage { IMMUTABLE, DEFAULT, DYNAMIC };
 	enum struct eGlBufferAccess { NONE, READ, WRITE };
 
+	enum struct eGlVertexType : u32 { FLOAT = 0, U8 = 1, I8 = 2, U16 = 3, I16 = 4, U32 = 5, I32 = 6 };
+
+	// Built in vertex formats, FULL is the 64 byte GlAddVertex layout and the default of every batch
+	enum struct eGlVertexFormat : u32 { FULL = 1, XYC = 2, XYZC = 3 };
+
+	// One attribute of a vertex format, normalized integers are read as floats by the shader, the others as integers
+	struct sGlVertexAttrib
+	{
+		u32 location{ 0 };
+		u32 components{ 4 };
+		eGlVertexType type{ eGlVertexType::FLOAT };
+		bool normalized{ false };
+		u32 offset{ 0 };	// Bytes into the vertex, attributes cover whole 32 bit words
+	};
+
 	enum struct eGlTopology : u32
 	{
 		POINTS = BIT(1),
@@ -269,6 +322,21 @@ namespace GASandbox
 	enum struct eNetEvent : u32 { CONNECT = 0, RECEIVE = 1, DISCONNECT = 2, TIMEOUT = 3 };
 	enum struct eNetPacketMode : u32 { RELIABLE = BIT(1), UNSEQUENCED = BIT(2), UNREALIABLE = BIT(4) };
 
+	// Jobs
+	using fJob = void (*)(void* data);
+	using fJobRange = void (*)(void* data, u32 begin, u32 end);
+	using fJobKernel = void (*)(f64* values, u32 begin, u32 end);
+
+	// Unfinished jobs submitted with this counter, it must outlive them and every job that runs after it
+	struct sJobCounter
+	{
+		std::atomic<u32> pending{ 0 };
+		void* waiting{ nullptr }; // Jobs started once pending drops to zero, owned by the job system
+	};
+
+	// Memory
+	enum struct eMemTag : u32 { APP = 0, CODE = 1, GRAPHICS = 2, GUI = 3, AUDIO = 4, NET = 5, COUNT = 6 };
+
 	// Code
 	using sCodeVM = void*;
 	using sCodeHandle = void*;
@@ -303,6 +371,38 @@ namespace GASandbox
 		eWinMode windowMode{ eWinMode::WINDOWED };
 		i32 msaa{ 8 };
 		bool headless{ false };
+
+		// Scheduler
+		f64 tickRate{ 60 };		// Fixed simulation ticks per second
+		u32 tickBudget{ 8 };	// Max ticks per frame before the backlog is dropped
+		f64 virtualDt{ 0 };		// Headless frame delta, 0 runs one tick per frame as fast as possible
+		bool pipelined{ false };	// Simulate frame N+1 on a worker thread while frame N is submitted (never headless)
+		u32 jobThreads{ 0 };		// Job system workers, 0 uses one per hardware thread minus the main thread
+
+		// Runner
+		string scene{};			// Index entry (position or path) or a .wren file, empty runs the first index entry
+		u32 frames{ 0 };		// Stop after this many frames, 0 runs until the window closes
+		f64 seconds{ 0 };		// Stop after this much (virtual when headless) time, 0 runs until the window closes
+		string report{};		// Per frame timings written at exit, CSV for a .csv path, JSON otherwise
+		string trace{};			// Profiler capture of the whole run written at exit as Chrome trace JSON
+		string scriptStats{};	// Per foreign method call statistics written at exit, CSV for a .csv path, JSON otherwise
+		string dumpDraws{};		// Draw merge statistics and the last frame's recorded and submitted draws written at exit
+
+		// Hot reload
+		f64 watchInterval{ 0.5 };	// Seconds between asset change checks, 0 disables watching (always off headless)
+
+		// Assets
+		string pack{};					// Read instead of the Assets folder when set, empty reads the folder
+		string writePack{};				// Bake the Assets folder into this pack and exit
+		string checkShaders{};			// Preprocess this shader (every .glsl for "all"), report errors and exit
+		string preprocess{};			// Write this shader preprocessed to stdout and exit
+		f64 loadBudget{ 2 };			// Milliseconds per frame for finishing async loads (model data, texture uploads)
+		string cache{ "Cache" };		// Decoded images, audio and models keyed by content hash, empty disables it
+		size_type cacheLimit{ 512u << 20 };	// Least recently used files are pruned at startup above this many bytes
+		string baked{ "Baked" };		// Outputs of GASandboxBake, preferred by the loaders while their source is unchanged, empty ignores them
+
+		// Memory
+		size_type frameArena{ 1 << 20 };	// Initial bytes of the per frame arena, it grows to the peak use at the next frame
 	};
 
 	class App
@@ -319,6 +419,23 @@ namespace GASandbox
 
 		static const list<sFileInfo>& FileGetIndex();
 		static const list<sFileInfo>& FileGetManifest();
+		static const sFileInfo* FileFind(cstring filepath);
+		static const list<u32>& FileFindByName(cstring name); // Indices into the manifest
+		static const list<u32>& FileFindByExt(cstring ext);
+		static const list<u32>& FileFindInDir(cstring dirpath);
+		static void FilePollChanges(list<sFileInfo>& changed);
+		static bool FilePack(cstring filepath);
+
+		// Jobs
+		static bool JobInitialize(const sAppConfig& config);
+		static void JobShutdown();
+
+		// Memory
+		static bool MemInitialize(const sAppConfig& config);
+		static void MemShutdown();
+
+		static void MemFrame();
+		static void MemGuiRender(bool* open);
 
 		// Window
 		static bool WinInitialize(const sAppConfig& config);
@@ -327,11 +444,20 @@ namespace GASandbox
 		static void WinPollEvents();
 		static void WinSwapBuffers();
 		static bool WinShouldClose();
+		static void WinDefer(bool enabled);
+		static void WinHandoff();
 
 		// Graphics
 		static bool GlInitialize(const sAppConfig& config);
 		static void GlShutdown();
 
+		static void GlPacketBegin(u32 packet);
+		static void GlPacketEnd();
+		static void GlPacketGui(u32 packet);
+		static void GlPacketSubmit(u32 packet);
+		static bool GlDumpDraws(cstring filepath);
+		static void GlFinishLoads(f64 budget);
+
 		// Gui
 		static bool GuiInitialize(const sAppConfig& config);
 		static void GuiShutdown();
@@ -374,7 +500,12 @@ namespace GASandbox
 		static bool CodeIsPaused();
 		static void CodeTogglePaused();
 
+		static void CodeStatsFrame();
+		static bool CodeStatsSave(cstring filepath);
+		static void CodeStatsGuiRender(bool* open);
+
 		static void CodeUpdate(f64 dt);
+		static void CodeFixedUpdate(f64 dt);
 		static void CodeRender();
 		static void CodeNetcode(bool server, u32 client, eNetEvent event, u16 peer, u32 channel, u32 packet);
 		static f32 CodeAudio(f64 sampleRate, f64 dt);
@@ -386,17 +517,43 @@ namespace GASandbox
 		static void GuiReload();
 		static void NetReload();
 		static void SfxReload();
+		static void JobReload();
+		static void FileReload();
 		static void CodeReload();
+		static void ReloadChanged(const list<sFileInfo>& changed);
+		static u32 GlReloadShaders(const list<sFileInfo>& changed);
+		static bool GlPreprocessShader(cstring filepath, string& out);
+
+		// Offline bake, each writes the runtime ready outputs of one source and skips the ones still fresh
+		static bool GlBakeImage(cstring filepath);
+		static bool GlBakeModel(cstring filepath);
+		static bool SfxBakeAudio(cstring filepath);
+		static bool CodeReloadModules(const list<sFileInfo>& changed);
 
 		static void Update(f64 dt);
+		static void FixedUpdate(f64 dt);
 		static void Render();
+		static void RenderFrame();
+
+		// Pipelined frames
+		static void PipelineFrame(f64 dt);
+		static void PipelineSimulate(f64 dt, u32 packet);
+		static void PipelineWorker();
+		static void PipelineStop();
+
+		// Profiler
+		static void ProfFrame();
+		static void ProfGuiRender(bool* open);
 
 	public:
 		static i32 Run(i32 argc, char** args);
+		static i32 Bake(i32 argc, char** args);
 
 		// Util
 		static void QueueReload();
 		static void Log(bool verbose, cstring file, i32 line, cstring func, u32 color, cstring format, ...);
+		static void LogFlush();
+		static void LogShutdown();
 		static void LogClear();
 
 		static f64 GetTime();
@@ -404,14 +561,79 @@ namespace GASandbox
 		static void Breakpoint(bool cond);
 		static bool IsHeadless();
 
+		static f64 TickDt();
+		static f64 TickAlpha();
+		static void SetTickRate(f64 hz);
+		static bool Pipelined();
+		static void SetPipelined(bool enabled);
+
 		static size_type Hash(cstring str);
 		static size_type Hash(const string& str);
+		static size_type Hash(cstring data, size_type size);
+
+		// Jobs
+		static void JobSubmit(fJob job, void* data, sJobCounter* counter = nullptr, sJobCounter* after = nullptr);
+		static void JobWait(sJobCounter& counter);
+		static void JobParallelFor(u32 count, u32 grain, fJobRange func, void* data);
+		static void JobBindKernel(cstring name, fJobKernel kernel);
+		static u32 JobWorkerCount();
+
+		// Memory
+		static void* MemAlloc(eMemTag tag, size_type size);
+		static void* MemRealloc(eMemTag tag, void* ptr, size_type size);
+		static void MemFree(void* ptr);
+		static void* MemFrameAlloc(size_type size);
+		static size_type MemBytes(eMemTag tag);
+		static size_type MemTotalBytes();
+		static u32 MemFrameAllocs();
+		static void MemCountHeapAlloc(); // Called by the executable's global operator new
+
+		// Profiler
+		static bool ProfBegin(cstring name);
+		static void ProfEnd();
+		static void ProfScriptBegin(cstring name); // Script zones only close script zones, the rest closes with ProfScriptClose
+		static void ProfScriptEnd();
+		static void ProfScriptClose();
+		static void ProfThread(cstring name);
+		static void ProfEnable(bool enabled);
+		static bool ProfIsEnabled();
+		static void ProfRecord(bool recording);
+		static bool ProfSave(cstring filepath);
+		static cstring ProfName(cstring name);
+
+		static void CodeStatsEnable(bool enabled);
+		static bool CodeStatsEnabled();
 
 		// File
 		static sFileInfo FileGetInfo(cstring filepath);
 		static cstring FilePath(cstring filepath);
+		static sFileView FileMap(cstring filepath);
+		static void FileUnmap(sFileView& view);
 		static string FileLoad(cstring filepath);
+
+		// Decoded asset cache, a hit maps the stored payload (followed by a small trailer) and the loader skips decoding
+		static size_type FileCacheKey(const sFileView& content, cstring settings);
+		static sFileView FileCacheLoad(size_type key);
+		static void FileCacheStore(size_type key, const void* data, size_type size);
+		static void FileCacheReject(size_type key);
+		static u32 FileCacheHits();
+		static u32 FileCacheMisses();
+
+		// Baked assets, keyed by path and settings, a load maps the payload (followed by a trailer) unless the source or one
+		// of the files it depends on changed since
+		static sFileView FileBakedLoad(cstring filepath, cstring settings);
+		static bool FileBakedFresh(cstring filepath, cstring settings);
+		static bool FileBakedStore(cstring filepath, cstring settings, const void* data, size_type size, const list<string>& depends = {});
+		static u32 FileBakedWrites();
 		static void FileSave(cstring filepath, const string& src);
+		static void FileSave(cstring filepath, cstring data, size_type size);
+		static void FileFlush();
+
+		// Chunks stay valid until the next read or the close, a read returns false at the end of the file
+		static u32 FileStreamOpen(cstring filepath, size_type chunkSize);
+		static bool FileStreamRead(u32 stream, cstring& data, size_type& size);
+		static size_type FileStreamSize(u32 stream);
+		static void FileStreamClose(u32 stream);
 
 		// Window
 		static fWinGlProc WinGetProcAddress(cstring procname);
@@ -441,6 +663,7 @@ namespace GASandbox
 		static void GlViewport(i32 x, i32 y, u32 w, u32 h);
 		static void GlScissor(i32 x, i32 y, u32 w, u32 h);
 		static void GlClear(f32 r, f32 g, f32 b, f32 a, f64 d, i32 s, eGlClearFlags flags);
+		static void GlSetSortDraws(bool enabled);
 
 		static u32 GlLoadShader(cstring filepath);
 		static u32 GlCreateShader(cstring source);
@@ -454,15 +677,24 @@ namespace GASandbox
 		static i32 GlImageHeight(u32 image);
 		static i32 GlImageChannels(u32 image);
 		static u8* GlImageData(u32 image);
+		static bool GlImageReady(u32 image);
 
 		static u32 GlCreateTexture(
 			u32 image, eGlTextureFormat format,
 			eGlTextureFilter minFilter, eGlTextureFilter magFilter,
 			eGlTextureWrap wrapS, eGlTextureWrap wrapT,
 			bool genMipmaps);
+		static u32 GlCreateTextureAsync(
+			u32 image, eGlTextureFormat format,
+			eGlTextureFilter minFilter, eGlTextureFilter magFilter,
+			eGlTextureWrap wrapS, eGlTextureWrap wrapT,
+			bool genMipmaps);
+		static bool GlTextureReady(u32 texture);
 		static void GlDestroyTexture(u32 texture);
 
 		static u32 GlLoadModel(cstring filepath);
+		static u32 GlLoadModelAsync(cstring filepath);
+		static bool GlModelReady(u32 model);
 		static void GlDestroyModel(u32 model);
 		//static i32 GlImageWidth(u32 image);
 		//static i32 GlImageHeight(u32 image);
@@ -478,11 +710,17 @@ namespace GASandbox
 			u32 c0, u32 c1, u32 i0, u32 i1,
 			f32 v0, f32 v1, f32 v2, f32 v3,
 			f32 v4, f32 v5, f32 v6, f32 v7);
+		static void GlAddVertexXYC(f32 x, f32 y, u32 c);
+		static void GlAddVertexXYZC(f32 x, f32 y, f32 z, u32 c);
+		static void GlAddVertices(const void* vertices, u32 count); // Packed in the format of the current batch
 
-		static void GlBegin(bool alpha, bool ztest, f32 pointSize, f32 lineWidth);
+		static u32 GlCreateVertexFormat(const sGlVertexAttrib* attribs, u32 count);
+		static void GlBegin(bool alpha, bool ztest, f32 pointSize, f32 lineWidth, u32 format = (u32)eGlVertexFormat::FULL);
 		static void GlEnd(bool indexed, u32 mode, u32 count);
 
 		static void GlSetUniform(cstring name);
+		static u32 GlGetUniform(u32 shader, cstring name);
+		static void GlSetUniformId(u32 uniform);
 
 		static void GlSetTex2D(u32 i, u32 texture);
 
@@ -561,6 +799,7 @@ namespace GASandbox
 		static bool SfxIsCallbackBound();
 
 		static u32 SfxLoadAudio(cstring filepath);
+		static bool SfxAudioReady(u32 audio);
 		static void SfxDestroyAudio(u32 audio);
 
 		static u32 SfxCreateChannel(f32 volume);
@@ -697,6 +936,8 @@ namespace GASandbox
 		static void CodeSetSlotF32(sCodeVM vm, i32 slot, f32 value);
 		static void CodeSetSlotF64(sCodeVM vm, i32 slot, f64 value);
 		static void CodeSetSlotString(sCodeVM vm, i32 slot, cstring text);
+		static void CodeSetSlotBytes(sCodeVM vm, i32 slot, cstring bytes, size_type size);
+		static void CodeSetSlotNull(sCodeVM vm, i32 slot);
 		static void* CodeSetSlotNewObject(sCodeVM vm, i32 slot, i32 classSlot, size_type size);
 		static void CodeSetSlotHandle(sCodeVM vm, i32 slot, sCodeHandle handle);
 
@@ -717,6 +958,64 @@ namespace GASandbox
 		static void CodeCallFunction(sCodeVM vm, sCodeHandle handle);
 	};
 
+	// Profiler zone, only a flag check when the profiler is disabled
+	struct sProfZone
+	{
+		bool active;
+
+		explicit sProfZone(cstring name) : active(App::ProfBegin(name)) {}
+		~sProfZone() { if (active) App::ProfEnd(); }
+
+		sProfZone(const sProfZone&) = delete;
+		sProfZone& operator=(const sProfZone&) = delete;
+	};
+
+	inline sFileView::sFileView(sFileView&& other)
+		: data(other.data), size(other.size), mapped(other.mapped), copy(other.copy)
+	{
+		other.data = nullptr;
+		other.size = 0;
+		other.mapped = false;
+		other.copy = nullptr;
+	}
+
+	inline sFileView& sFileView::operator=(sFileView&& other)
+	{
+		if (this != &other)
+		{
+			App::FileUnmap(*this);
+			std::swap(data, other.data);
+			std::swap(size, other.size);
+			std::swap(mapped, other.mapped);
+			std::swap(copy, other.copy);
+		}
+		return *this;
+	}
+
+	inline sFileView::~sFileView() { App::FileUnmap(*this); }
+
+	// Standard allocator counted under a memory tag, for backend containers
+	template <typename T, eMemTag Tag>
+	struct sMemAllocator
+	{
+		using value_type = T;
+		template <typename U> struct rebind { using other = sMemAllocator<U, Tag>; };
+
+		sMemAllocator() = default;
+		template <typename U> sMemAllocator(const sMemAllocator<U, Tag>&) {}
+
+		T* allocate(size_type n) { return static_cast<T*>(App::MemAlloc(Tag, n * sizeof(T))); }
+		void deallocate(T* ptr, size_type) { App::MemFree(ptr); }
+	};
+
+	template <typename T, typename U, eMemTag Tag>
+	bool operator==(const sMemAllocator<T, Tag>&, const sMemAllocator<U, Tag>&) { return true; }
+	template <typename T, typename U, eMemTag Tag>
+	bool operator!=(const sMemAllocator<T, Tag>&, const sMemAllocator<U, Tag>&) { return false; }
+
+	template <typename T, eMemTag Tag>
+	using tagged_list = std::vector<T, sMemAllocator<T, Tag>>;
+
 	// Code template API inspired by: https://github.com/Nelarius/wrenpp
 
 	template<typename T>
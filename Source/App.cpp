@@ -8,41 +8,169 @@
 #include <cmath>
 #include <cstdarg>
 #include <cstdio>
-#include <fstream>
-#include <sstream>
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <chrono>
 #include <ctime>
-#include <iomanip>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
 
 namespace GASandbox
 {
+	// Log records are formatted by the caller and handed to the writer thread through a bounded MPSC ring.
+	// The file and func pointers must be string literals (__FILE__, __func__), they are read after the call returns.
+	constexpr size_type LOG_RING_SIZE = 1024; // Must be a power of two
+	constexpr size_type LOG_TEXT_SIZE = 1024;
+	constexpr size_type LOG_BATCH_SIZE = 64;
+
+	// Console store: fixed pool of records linked in display order, the least recently logged entry is evicted first.
+	// Records never move so the dedup table can index them directly, eviction and dedup are both O(1).
+	constexpr size_type LOG_CONSOLE_SIZE = 1024;
+	constexpr size_type LOG_MESSAGE_SIZE = LOG_TEXT_SIZE + 256; // Text plus verbose metadata
+	constexpr size_type LOG_TABLE_SIZE = LOG_CONSOLE_SIZE * 2; // Must be a power of two
+	constexpr u32 LOG_NONE = 0xFFFFFFFF;
+
+	enum struct eLogState : u32 { IDLE = 0, RUNNING = 1, STOPPED = 2 };
+
+	struct sLogRecord
+	{
+		std::atomic<size_type> sequence{ 0 };
+		i64 time{ 0 };
+		cstring file{ nullptr };
+		cstring func{ nullptr };
+		i32 line{ 0 };
+		u32 color{ 0xFFFFFFFF };
+		bool verbose{ false };
+		u32 length{ 0 };
+		char text[LOG_TEXT_SIZE]{};
+	};
+
 	struct sLogData
 	{
 		u32 color{ 0xFFFFFFFF };
-		string message{};
+		u32 count{ 0 };
+		u32 prev{ LOG_NONE };
+		u32 next{ LOG_NONE };
 		size_type hash{ 0 };
-		size_type count{ 0 };
+		u32 length{ 0 };
+		char message[LOG_MESSAGE_SIZE]{};
+	};
+
+	struct sLogSlot
+	{
+		size_type hash{ 0 };
+		u32 index{ LOG_NONE };
+	};
+
+	// Runner timings of a single frame, in seconds
+	struct sAppFrame
+	{
+		f64 dt{ 0 };
+		u32 ticks{ 0 };
+		u32 allocs{ 0 };	// Native heap allocations, scripts excluded
+		f64 update{ 0 };
+		f64 gc{ 0 };
+		f64 net{ 0 };
+		f64 fixed{ 0 };
+		f64 code{ 0 };
+		f64 sfx{ 0 };
+		f64 render{ 0 };
+	};
+
+	struct sAppColumn
+	{
+		cstring name;
+		f64 sAppFrame::* field;
+	};
+
+	// One startup step, logged with the others once the first frame has updated
+	struct sAppStartup
+	{
+		cstring name{ nullptr };
+		f64 seconds{ 0 };
+	};
+
+	static const sAppColumn APP_COLUMNS[] =
+	{
+		{ "update", &sAppFrame::update },
+		{ "gc", &sAppFrame::gc },
+		{ "net", &sAppFrame::net },
+		{ "fixed", &sAppFrame::fixed },
+		{ "code", &sAppFrame::code },
+		{ "sfx", &sAppFrame::sfx },
+		{ "render", &sAppFrame::render },
+	};
+
+	// Pipelined frames: the worker simulates and records frame N+1 into one packet while the main thread submits frame N
+	// from the other. Both threads meet at the handoff, where input, window changes, reloads and packets change hands.
+	struct sAppPipeline
+	{
+		std::thread thread{};
+		std::mutex mutex{};
+		std::condition_variable wake{};
+		std::condition_variable done{};
+		bool busy{ false };		// Worker owns the vm, the gui context and the recording packet
+		bool quit{ false };
+		bool ready{ false };	// A recorded packet waits for submission
+		bool visible{ false };	// The worker built a gui frame into the recorded packet
+		f64 dt{ 0 };
+		u32 packet{ 0 };
+
+		bool enabled{ false };	// From the config
+		bool optOut{ false };	// Scene called App.setPipelined(false)
 	};
 
 	struct sAppGlobal
 	{
 		// App
-		list<sLogData> logs{};
-		hashmap<size_type, size_type> logsHash{};
+		sLogData logs[LOG_CONSOLE_SIZE]{};
+		sLogSlot logsHash[LOG_TABLE_SIZE]{};
+		u32 logsFirst{ LOG_NONE };
+		u32 logsLast{ LOG_NONE };
+		u32 logsCount{ 0 };
 		std::mutex logMutex{};
 
+		// Log pipeline
+		sLogRecord logRing[LOG_RING_SIZE]{};
+		std::atomic<size_type> logHead{ 0 };
+		std::atomic<size_type> logTail{ 0 };
+		std::atomic<eLogState> logState{ eLogState::IDLE };
+		std::atomic<bool> logSleeping{ false };
+		std::once_flag logOnce{};
+		std::mutex logWakeMutex{};
+		std::condition_variable logWake{};
+		std::thread logThread{};
+		FILE* logFile{ nullptr };
+		i64 logStampTime{ -1 };
+		char logStamp[32]{};
+
 		u32 frames{ 0 };
 		f64 time{ 0 };
 		f64 fps{ 0 };
 		f64 spf{ 0 };
 
 		i32 currentIndex{ 0 };
+		string scenePath{}; // Script outside the index picked on the command line
+
+		// Runner
+		sAppFrame frame{};
+		list<sAppFrame> frameTimings{};
+		list<sAppStartup> startup{};
+
+		// Scheduler
+		f64 tickDt{ 1.0 / 60.0 };
+		f64 tickAccum{ 0 };
+		f64 tickAlpha{ 0 };
+		u32 tickBudget{ 8 };
+
+		sAppPipeline pipe{};
 
 		bool breakpoint{ false };
 		bool reload{ true };
@@ -52,126 +180,610 @@ namespace GASandbox
 		f32 fontSize{ 1.0f };
 		bool showImGuiDemo{ false };
 		bool showConsole{ false };
+		bool showProfiler{ false };
+		bool showScriptCalls{ false };
+		bool showMemory{ false };
 		bool winAlwaysOnTop{ false };
 	};
 	static sAppGlobal g;
 
-	// Static utils
-	static size_type str_hash(const string& str)
+	// Runner
+	using app_clock = std::chrono::steady_clock;
+
+	struct sAppTimer
 	{
-		static std::hash<string> g_hash{};
-		return g_hash(str);
+		f64& out;
+		app_clock::time_point start{ app_clock::now() };
+
+		explicit sAppTimer(f64& out) : out(out) {}
+		~sAppTimer() { out += std::chrono::duration<f64>(app_clock::now() - start).count(); }
+	};
+
+	// Taken during static initialization, as close to process start as the app gets
+	static const app_clock::time_point app_start = app_clock::now();
+
+	template<typename F>
+	static bool app_startup(cstring name, F&& init)
+	{
+		PROFILE(name);
+
+		sAppStartup step{};
+		step.name = name;
+		bool ok = false;
+		{
+			sAppTimer timer(step.seconds);
+			ok = init();
+		}
+
+		g.startup.push_back(step);
+		return ok;
 	}
 
-	// App
-	void App::QueueReload()
+	static void app_log_startup()
 	{
-		g.reload = true;
+		string steps{};
+		char step[64];
+		for (const auto& s : g.startup)
+		{
+			std::snprintf(step, sizeof(step), "%s %.1f ms, ", s.name, s.seconds * 1000.0);
+			steps += step;
+		}
+
+		const f64 total = std::chrono::duration<f64>(app_clock::now() - app_start).count();
+		LOGI("Startup: %sfirst update %.1f ms after process start", steps.c_str(), total * 1000.0);
 	}
 
-	void App::Log(bool verbose, cstring file, i32 line, cstring func, u32 color, cstring format, ...)
+	static void app_usage(cstring exe)
 	{
-		static string buffer; // Persistent buffer to reduce allocations
+		std::printf(
+			"Usage: %s [options]\n"
+			"  --scene <entry>    Index entry (position or path in Assets/index.txt) or a .wren file\n"
+			"  --headless         Run without window, graphics or gui\n"
+			"  --frames <n>       Stop after n frames\n"
+			"  --seconds <s>      Stop after s seconds, virtual time when headless\n"
+			"  --dt <s>           Headless frame delta, defaults to one tick per frame\n"
+			"  --tick-rate <hz>   Fixed simulation ticks per second\n"
+			"  --pipelined        Simulate the next frame on a worker thread while the current one is drawn\n"
+			"  --jobs <n>         Job system worker threads, defaults to one per core minus the main thread\n"
+			"  --report <file>    Write per frame timings at exit, CSV for a .csv file, JSON otherwise\n"
+			"  --trace <file>     Profile the whole run and write a Chrome trace (chrome://tracing) at exit\n"
+			"  --script-stats <file>  Count calls and time per foreign method, written at exit as CSV or JSON\n"
+			"  --dump-draws <file>  Write draw merge statistics and the last frame's draw stream at exit, records headless too\n"
+			"  --watch <s>        Seconds between asset change checks for hot reload, 0 disables it\n"
+			"  --pack <file>      Asset pack read instead of the Assets folder\n"
+			"  --write-pack <file>  Bake the Assets folder into a pack and exit\n"
+			"  --check-shaders <file|all>  Preprocess shaders, report missing includes, cycles and unbalanced #if, and exit\n"
+			"  --preprocess <file>  Write a shader with its includes expanded to stdout and exit\n"
+			"  --load-budget <ms> Main thread time per frame for finishing async loads (default 2)\n"
+			"  --cache <dir>      Decoded asset cache directory (default Cache), empty disables it\n"
+			"  --baked <dir>      Outputs of GASandboxBake, preferred over decoding while fresh (default Baked), empty ignores them\n"
+			"  --help             Show this message\n",
+			exe);
+	}
 
-		std::lock_guard<std::mutex> lock(g.logMutex);
+	// Whole string only, so "abc" or "10x" are rejected instead of read as 0 or 10
+	static bool app_parse_uint(cstring value, u32& out)
+	{
+		char* end = nullptr;
+		const unsigned long v = std::strtoul(value, &end, 10);
+		if (value[0] == '-' || end == value || *end != '\0' || v > 0xFFFFFFFFul)
+			return false;
 
-		// Get timestamp
-		auto now = std::chrono::system_clock::now();
-		auto in_time_t = std::chrono::system_clock::to_time_t(now);
+		out = (u32)v;
+		return true;
+	}
 
-		std::ostringstream ss;
-		ss << std::put_time(std::localtime(&in_time_t), "[%Y-%m-%d %H:%M:%S]");
+	static bool app_parse_number(cstring value, f64 min, f64& out)
+	{
+		char* end = nullptr;
+		const f64 v = std::strtod(value, &end);
+		if (end == value || *end != '\0' || !std::isfinite(v) || v < min)
+			return false;
 
-		string timestamp = ss.str();
+		out = v;
+		return true;
+	}
 
-		// Initialize the argument list
-		va_list args;
-		va_start(args, format);
+	// Preprocessing needs no graphics context, what it can't catch is left to the driver
+	static bool app_check_shaders(const sAppConfig& config)
+	{
+		bool valid = true;
+		string src{};
+		if (!config.preprocess.empty())
+		{
+			valid &= App::GlPreprocessShader(config.preprocess.c_str(), src);
+			std::fwrite(src.data(), 1, src.size(), stdout);
+		}
 
-		va_list args_copy;
-		va_copy(args_copy, args);
+		if (config.checkShaders.empty())
+			return valid;
 
-		// Determine the size of the formatted string
-		i32 size = std::vsnprintf(nullptr, 0, format, args_copy);
-		if (size < 0)
+		list<cstring> paths{};
+		if (config.checkShaders == "all")
 		{
-			va_end(args_copy);
-			throw std::runtime_error("Error during formatting.");
+			const auto& manifest = App::FileGetManifest();
+			for (const u32 file : App::FileFindByExt("glsl"))
+				paths.push_back(manifest[file].path);
 		}
+		else
+			paths.push_back(config.checkShaders.c_str());
 
-		buffer.resize(size + 1); // +1 for null terminator
+		u32 failed = 0;
+		for (cstring path : paths)
+			failed += App::GlPreprocessShader(path, src) ? 0 : 1;
 
-		// Format the message directly into the buffer
-		std::vsnprintf(&buffer[0], buffer.size(), format, args);
-		va_end(args);
+		LOGI("Checked %zu shaders, %u failed", paths.size(), failed);
+		return valid && failed == 0;
+	}
 
-		cstring filename = std::max(strrchr(file, '/'), strrchr(file, '\\'));
-		filename = filename ? filename + 1 : file; // Move past '/' or '\' if found
+	// One job per source, every output is its own file so the jobs never share anything
+	struct sAppBakeJob
+	{
+		cstring path{ nullptr };
+		bool (*bake)(cstring filepath){ nullptr };
+		bool failed{ false };
+	};
 
-		// We have the same log already, skip to avoid many repeating logs
-		static std::hash<string> g_hash{};
-		size_type hash = g_hash(func) ^ g_hash(filename) ^ line ^ g_hash(buffer);
-		auto it = g.logsHash.find(hash);
-		if (it != g.logsHash.end())
+	static void app_bake(void* data)
+	{
+		auto* job = static_cast<sAppBakeJob*>(data);
+		job->failed = !job->bake(job->path);
+	}
+
+	static void app_json_string(FILE* file, cstring str)
+	{
+		std::fputc('"', file);
+		for (; *str; ++str)
 		{
-			g.logs[it->second].count++;
-			std::swap(g.logs[it->second], g.logs.back());
-			return;
+			if (*str == '"' || *str == '\\')
+				std::fputc('\\', file);
+			std::fputc(*str, file);
 		}
-		g.logsHash.insert(std::make_pair(hash, g.logs.size()));
+		std::fputc('"', file);
+	}
 
-		// Create log entry
-		sLogData log{};
-		log.color = color;
-		log.hash = hash;
+	static bool app_report(cstring filepath, cstring scene, f64 tickDt)
+	{
+		FILE* file = std::fopen(filepath, "w");
+		if (file == nullptr)
+			return false;
+
+		const auto& frames = g.frameTimings;
+		const size_type len = std::strlen(filepath);
+		const bool csv = len >= 4 && std::strcmp(filepath + len - 4, ".csv") == 0;
+
+		// Times are reported in milliseconds
+		if (csv)
+		{
+			std::fprintf(file, "frame,dt,ticks,allocs");
+			for (const auto& col : APP_COLUMNS)
+				std::fprintf(file, ",%s", col.name);
+			std::fprintf(file, "\n");
+
+			for (size_type i = 0; i < frames.size(); ++i)
+			{
+				const auto& f = frames[i];
+				std::fprintf(file, "%zu,%.6f,%u,%u", i, f.dt * 1000.0, f.ticks, f.allocs);
+				for (const auto& col : APP_COLUMNS)
+					std::fprintf(file, ",%.6f", f.*col.field * 1000.0);
+				std::fprintf(file, "\n");
+			}
+		}
+		else
+		{
+			std::fprintf(file, "{\n  \"scene\": ");
+			app_json_string(file, scene);
+			std::fprintf(file, ",\n  \"unit\": \"ms\",\n  \"tickDt\": %.6f,\n  \"frames\": %zu,\n  \"summary\": {", tickDt * 1000.0, frames.size());
+
+			list<f64> values(frames.size());
+			bool first = true;
+			for (const auto& col : APP_COLUMNS)
+			{
+				f64 sum = 0;
+				for (size_type i = 0; i < frames.size(); ++i)
+				{
+					values[i] = frames[i].*col.field * 1000.0;
+					sum += values[i];
+				}
+				std::sort(values.begin(), values.end());
+
+				const size_type n = values.size();
+				std::fprintf(file, "%s\n    \"%s\": { \"mean\": %.6f, \"p50\": %.6f, \"p99\": %.6f, \"max\": %.6f }",
+					first ? "" : ",", col.name,
+					n ? sum / n : 0.0, n ? values[n / 2] : 0.0, n ? values[(size_type)((n - 1) * 0.99)] : 0.0, n ? values.back() : 0.0);
+				first = false;
+			}
+
+			// Allocation counts are not times, the steady frames show how long the scene ran without any
+			u32 maxAllocs = 0, steadyFrames = 0;
+			for (const auto& f : frames)
+			{
+				maxAllocs = std::max(maxAllocs, f.allocs);
+				steadyFrames = f.allocs == 0 ? steadyFrames + 1 : 0;
+			}
+			std::fprintf(file, "\n  },\n  \"allocs\": { \"max\": %u, \"steadyFrames\": %u },", maxAllocs, steadyFrames);
+			std::fprintf(file, "\n  \"cache\": { \"hits\": %u, \"misses\": %u },\n  \"timings\": [", FileCacheHits(), FileCacheMisses());
+			for (size_type i = 0; i < frames.size(); ++i)
+			{
+				const auto& f = frames[i];
+				std::fprintf(file, "%s\n    { \"frame\": %zu, \"dt\": %.6f, \"ticks\": %u, \"allocs\": %u", i ? "," : "", i, f.dt * 1000.0, f.ticks, f.allocs);
+				for (const auto& col : APP_COLUMNS)
+					std::fprintf(file, ", \"%s\": %.6f", col.name, f.*col.field * 1000.0);
+				std::fprintf(file, " }");
+			}
+			std::fprintf(file, "\n  ]\n}\n");
+		}
+
+		std::fclose(file);
+		return true;
+	}
+
+	// Log pipeline
+	static cstring log_timestamp(i64 time)
+	{
+		// Only reformat when the second changes, a burst of logs shares the same stamp
+		if (time != g.logStampTime)
+		{
+			std::time_t t = (std::time_t)time;
+			std::strftime(g.logStamp, sizeof(g.logStamp), "[%Y-%m-%d %H:%M:%S]", std::localtime(&t));
+			g.logStampTime = time;
+		}
+		return g.logStamp;
+	}
+
+	// Console store
+	static size_type log_hash(cstring str, size_type length, size_type seed)
+	{
+		// FNV-1a, hashes straight from the record buffers without building strings
+		size_type hash = seed ^ (size_type)14695981039346656037ULL;
+		for (size_type i = 0; i < length; ++i)
+		{
+			hash ^= (u8)str[i];
+			hash *= (size_type)1099511628211ULL;
+		}
+		return hash;
+	}
+
+	static u32 log_table_find(size_type hash)
+	{
+		u32 pos = (u32)(hash & (LOG_TABLE_SIZE - 1));
+		while (g.logsHash[pos].index != LOG_NONE)
+		{
+			if (g.logsHash[pos].hash == hash)
+				return pos;
+			pos = (pos + 1) & (LOG_TABLE_SIZE - 1);
+		}
+		return LOG_NONE;
+	}
 
-		if (verbose)
+	static void log_table_insert(size_type hash, u32 index)
+	{
+		u32 pos = (u32)(hash & (LOG_TABLE_SIZE - 1));
+		while (g.logsHash[pos].index != LOG_NONE)
+			pos = (pos + 1) & (LOG_TABLE_SIZE - 1);
+
+		g.logsHash[pos].hash = hash;
+		g.logsHash[pos].index = index;
+	}
+
+	static void log_table_erase(u32 pos)
+	{
+		// Backward shift deletion, keeps probe chains intact without tombstones
+		u32 hole = pos;
+		u32 next = pos;
+		while (true)
 		{
-			// Format metadata in the same buffer
-			size = std::snprintf(nullptr, 0, "%s [%s] (%s:%d)\n%s", timestamp.c_str(), func, filename, line, buffer.c_str());
+			next = (next + 1) & (LOG_TABLE_SIZE - 1);
+			if (g.logsHash[next].index == LOG_NONE)
+				break;
+
+			// Leave entries whose home slot lies cyclically in (hole, next]
+			u32 home = (u32)(g.logsHash[next].hash & (LOG_TABLE_SIZE - 1));
+			bool stays = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+			if (stays)
+				continue;
+
+			g.logsHash[hole] = g.logsHash[next];
+			hole = next;
+		}
+		g.logsHash[hole] = sLogSlot{};
+	}
 
-			string temp;
-			temp.resize(size + 1);
+	static void log_unlink(u32 index)
+	{
+		sLogData& log = g.logs[index];
+		if (log.prev != LOG_NONE) g.logs[log.prev].next = log.next;
+		else g.logsFirst = log.next;
+		if (log.next != LOG_NONE) g.logs[log.next].prev = log.prev;
+		else g.logsLast = log.prev;
+		log.prev = log.next = LOG_NONE;
+	}
+
+	static void log_append(u32 index)
+	{
+		sLogData& log = g.logs[index];
+		log.prev = g.logsLast;
+		log.next = LOG_NONE;
+		if (g.logsLast != LOG_NONE) g.logs[g.logsLast].next = index;
+		else g.logsFirst = index;
+		g.logsLast = index;
+	}
+
+	static u32 log_acquire()
+	{
+		if (g.logsCount < LOG_CONSOLE_SIZE)
+			return g.logsCount++;
+
+		// Full, recycle the oldest record
+		u32 index = g.logsFirst;
+		u32 pos = log_table_find(g.logs[index].hash);
+		if (pos != LOG_NONE)
+			log_table_erase(pos);
+		log_unlink(index);
+		return index;
+	}
+
+	static void log_process(const sLogRecord& rec)
+	{
+		PROFILE("LogProcess");
+
+		cstring filename = std::max(strrchr(rec.file, '/'), strrchr(rec.file, '\\'));
+		filename = filename ? filename + 1 : rec.file; // Move past '/' or '\' if found
+
+		size_type hash = log_hash(rec.func, std::strlen(rec.func), 0);
+		hash ^= log_hash(filename, std::strlen(filename), 1) ^ rec.line;
+		hash ^= log_hash(rec.text, rec.length, 2);
+
+		std::lock_guard<std::mutex> lock(g.logMutex);
+
+		// We have the same log already, skip to avoid many repeating logs
+		u32 pos = log_table_find(hash);
+		if (pos != LOG_NONE)
+		{
+			u32 index = g.logsHash[pos].index;
+			g.logs[index].count++;
+			log_unlink(index);
+			log_append(index);
+			return;
+		}
 
-			std::snprintf(&temp[0], temp.size(), "%s [%s] (%s:%d)\n%s", timestamp.c_str(), func, filename, line, buffer.c_str());
+		u32 index = log_acquire();
+		sLogData& log = g.logs[index];
+		log.color = rec.color;
+		log.count = 0;
+		log.hash = hash;
 
-			log.message = std::move(temp);
+		i32 size = 0;
+		if (rec.verbose)
+		{
+			cstring timestamp = log_timestamp(rec.time);
+			size = std::snprintf(log.message, LOG_MESSAGE_SIZE, "%s [%s] (%s:%d)\n%.*s", timestamp, rec.func, filename, rec.line, (i32)rec.length, rec.text);
 		}
 		else
 		{
-			log.message = buffer;
+			size = std::snprintf(log.message, LOG_MESSAGE_SIZE, "%.*s", (i32)rec.length, rec.text);
+		}
+		log.length = (u32)std::min((size_type)std::max(size, 0), LOG_MESSAGE_SIZE - 1);
+
+		log_table_insert(hash, index);
+		log_append(index);
+
+#ifdef _DEBUG
+		std::cout.write(log.message, log.length) << '\n';
+#else
+		if (g.logFile)
+		{
+			std::fwrite(log.message, 1, log.length, g.logFile);
+			std::fputc('\n', g.logFile);
 		}
+#endif
+	}
 
+	static void log_commit()
+	{
 #ifdef _DEBUG
-		std::cout << log.message << std::endl;
+		std::cout.flush();
 #else
-		// Write to file immediately
-		std::ofstream logFile("log.txt", std::ios::app); // Append mode
-		if (logFile.is_open())
+		if (g.logFile)
+			std::fflush(g.logFile);
+#endif
+	}
+
+	static size_type log_drain(size_type max)
+	{
+		size_type count = 0;
+		size_type tail = g.logTail.load(std::memory_order_relaxed);
+		while (count < max)
+		{
+			sLogRecord& rec = g.logRing[tail & (LOG_RING_SIZE - 1)];
+			if (rec.sequence.load(std::memory_order_acquire) != tail + 1)
+				break;
+
+			log_process(rec);
+
+			rec.sequence.store(tail + LOG_RING_SIZE, std::memory_order_release);
+			g.logTail.store(++tail, std::memory_order_release);
+			count++;
+		}
+
+		if (count > 0)
+			log_commit();
+
+		return count;
+	}
+
+	static void log_wake()
+	{
+		if (g.logSleeping.load())
+			g.logWake.notify_one();
+	}
+
+	static void log_writer()
+	{
+		App::ProfThread("Log");
+
+		while (true)
 		{
-			logFile << log.message << std::endl;
+			if (log_drain(LOG_BATCH_SIZE) > 0)
+				continue;
+
+			if (g.logState.load(std::memory_order_acquire) != eLogState::RUNNING)
+				break;
 
-			// Ensure write is committed immediately
-			logFile.flush();
-			logFile.close();
+			// Nothing queued, sleep until a producer wakes us (or poll again shortly)
+			std::unique_lock<std::mutex> lock(g.logWakeMutex);
+			g.logSleeping.store(true);
+			if (g.logHead.load() == g.logTail.load(std::memory_order_relaxed))
+				g.logWake.wait_for(lock, std::chrono::milliseconds(10));
+			g.logSleeping.store(false);
 		}
+
+		while (log_drain(LOG_BATCH_SIZE) > 0) {}
+	}
+
+	static void log_start()
+	{
+		for (size_type i = 0; i < LOG_RING_SIZE; ++i)
+			g.logRing[i].sequence.store(i, std::memory_order_relaxed);
+
+#ifndef _DEBUG
+		g.logFile = std::fopen("log.txt", "a"); // Append mode, kept open for the lifetime of the writer
 #endif
 
-		// Store log message
-		g.logs.emplace_back(std::move(log));
+		g.logState.store(eLogState::RUNNING, std::memory_order_release);
+		g.logThread = std::thread(log_writer);
+
+		// Make sure the writer is joined before the globals are destroyed, whoever owns main()
+		std::atexit([]() { App::LogShutdown(); });
+	}
 
-		// Limit log size
-		if (g.logs.size() > 1024)
+	static bool log_push(const sLogRecord& src)
+	{
+		if (g.logState.load(std::memory_order_acquire) != eLogState::RUNNING)
+			return false;
+
+		size_type pos = g.logHead.load(std::memory_order_relaxed);
+		sLogRecord* rec = nullptr;
+		while (true)
 		{
-			g.logsHash.erase(g.logs.begin()->hash);
-			g.logs.erase(g.logs.begin());
+			rec = &g.logRing[pos & (LOG_RING_SIZE - 1)];
+			size_type seq = rec->sequence.load(std::memory_order_acquire);
+			i64 diff = (i64)seq - (i64)pos;
+
+			if (diff == 0)
+			{
+				if (g.logHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				// Ring is full, let the writer catch up
+				if (g.logState.load(std::memory_order_acquire) != eLogState::RUNNING)
+					return false;
+
+				log_wake();
+				std::this_thread::yield();
+				pos = g.logHead.load(std::memory_order_relaxed);
+			}
+			else
+			{
+				pos = g.logHead.load(std::memory_order_relaxed);
+			}
+		}
+
+		rec->time = src.time;
+		rec->file = src.file;
+		rec->func = src.func;
+		rec->line = src.line;
+		rec->color = src.color;
+		rec->verbose = src.verbose;
+		rec->length = src.length;
+		std::memcpy(rec->text, src.text, src.length);
+
+		rec->sequence.store(pos + 1, std::memory_order_release);
+		log_wake();
+		return true;
+	}
+
+	// App
+	void App::QueueReload()
+	{
+		g.reload = true;
+	}
+
+	void App::Log(bool verbose, cstring file, i32 line, cstring func, u32 color, cstring format, ...)
+	{
+		thread_local sLogRecord rec{}; // Per thread staging buffer, no allocations on the caller side
+
+		std::call_once(g.logOnce, log_start);
+
+		rec.time = (i64)std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+		rec.file = file;
+		rec.func = func;
+		rec.line = line;
+		rec.color = color;
+		rec.verbose = verbose;
+
+		// Format the message directly into the staging buffer (truncated to LOG_TEXT_SIZE)
+		va_list args;
+		va_start(args, format);
+		i32 size = std::vsnprintf(rec.text, LOG_TEXT_SIZE, format, args);
+		va_end(args);
+
+		if (size < 0)
+			throw std::runtime_error("Error during formatting.");
+
+		rec.length = (u32)std::min((size_type)size, LOG_TEXT_SIZE - 1);
+
+		if (!log_push(rec))
+		{
+			// Writer is gone (shutdown), process synchronously, the wake mutex is free to serialize callers
+			std::lock_guard<std::mutex> lock(g.logWakeMutex);
+			log_process(rec);
+			log_commit();
+		}
+	}
+
+	void App::LogFlush()
+	{
+		if (g.logState.load(std::memory_order_acquire) != eLogState::RUNNING)
+			return;
+
+		const size_type target = g.logHead.load(std::memory_order_acquire);
+		while (g.logTail.load(std::memory_order_acquire) < target)
+		{
+			g.logWake.notify_one();
+			std::this_thread::yield();
+		}
+	}
+
+	void App::LogShutdown()
+	{
+		eLogState expected = eLogState::RUNNING;
+		if (!g.logState.compare_exchange_strong(expected, eLogState::STOPPED))
+			return;
+
+		g.logWake.notify_one();
+		if (g.logThread.joinable())
+			g.logThread.join();
+
+		if (g.logFile)
+		{
+			std::fclose(g.logFile);
+			g.logFile = nullptr;
 		}
 	}
 
 	void App::LogClear()
 	{
-		g.logs.clear();
-		g.logsHash.clear();
+		LogFlush();
+
+		std::lock_guard<std::mutex> lock(g.logMutex);
+		for (auto& slot : g.logsHash)
+			slot = sLogSlot{};
+		g.logsFirst = LOG_NONE;
+		g.logsLast = LOG_NONE;
+		g.logsCount = 0;
 	}
 
 	void App::Wait(u32 ms)
@@ -189,47 +801,141 @@ namespace GASandbox
 		return g.headless;
 	}
 
+	f64 App::TickDt()
+	{
+		return g.tickDt;
+	}
+
+	f64 App::TickAlpha()
+	{
+		return g.tickAlpha;
+	}
+
+	void App::SetTickRate(f64 hz)
+	{
+		if (hz <= 0)
+		{
+			LOGW("Invalid tick rate: %f", hz);
+			return;
+		}
+
+		g.tickDt = 1.0 / hz;
+	}
+
+	bool App::Pipelined()
+	{
+		return g.pipe.enabled && !g.pipe.optOut;
+	}
+
+	void App::SetPipelined(bool enabled)
+	{
+		g.pipe.optOut = !enabled;
+	}
+
 	size_type App::Hash(cstring str)
 	{
-		return Hash(string{ str });
+		return Hash(str, std::strlen(str));
 	}
 
 	size_type App::Hash(const string& str)
 	{
-		static std::hash<string> h{};
-		return h(str);
+		return Hash(str.data(), str.size());
+	}
+
+	size_type App::Hash(cstring data, size_type size)
+	{
+		// FNV-1a, stable across builds and platforms so baked data (packs, caches) can key on it
+		u64 hash = 14695981039346656037ULL;
+		for (size_type i = 0; i < size; ++i)
+		{
+			hash ^= (u8)data[i];
+			hash *= 1099511628211ULL;
+		}
+		return (size_type)hash;
 	}
 
 	bool App::Initialize(const sAppConfig& config)
 	{
+		// Sfx and Net only prepare here, the audio device and enet start on first use
+		if (!app_startup("mem", [&] { return MemInitialize(config); }))
+			return false;
+
+		if (!app_startup("job", [&] { return JobInitialize(config); }))
+			return false;
+
+		if (!app_startup("win", [&] { return WinInitialize(config); }))
+			return false;
+
 		if (!config.headless)
 		{
-			if (!WinInitialize(config))
-				return false;
-
-			if (!GlInitialize(config))
+			if (!app_startup("gl", [&] { return GlInitialize(config); }))
 				return false;
 
-			if (!GuiInitialize(config))
+			if (!app_startup("gui", [&] { return GuiInitialize(config); }))
 				return false;
 		}
 
-		if (!SfxInitialize(config))
+		if (!app_startup("sfx", [&] { return SfxInitialize(config); }))
 			return false;
 
-		if (!NetInitialize(config))
+		if (!app_startup("net", [&] { return NetInitialize(config); }))
 			return false;
 
-		if (!FileInitialize(config))
+		if (!app_startup("file", [&] { return FileInitialize(config); }))
 			return false;
 
+		// Scene picked on the command line, an index position, an index path or any script
+		if (!config.scene.empty())
+		{
+			const auto& index = FileGetIndex();
+			cstring scene = config.scene.c_str();
+
+			char* end = nullptr;
+			const long pos = std::strtol(scene, &end, 10);
+			if (end != scene && *end == '\0')
+			{
+				if (pos < 0 || pos >= (long)index.size())
+				{
+					LOGE("Scene index out of range: %ld", pos);
+					return false;
+				}
+				g.currentIndex = (i32)pos;
+			}
+			else
+			{
+				const auto info = FileGetInfo(scene);
+
+				i32 idx = 0;
+				while (idx < (i32)index.size() && index[idx].pathHash != info.pathHash)
+					idx++;
+
+				if (idx < (i32)index.size())
+				{
+					g.currentIndex = idx;
+				}
+				else if (std::strcmp(info.ext, "wren") == 0 && !FileMap(scene).empty())
+				{
+					g.scenePath = info.path;
+				}
+				else
+				{
+					LOGE("Unknown scene: %s", scene);
+					return false;
+				}
+			}
+		}
+
 		g.headless = config.headless;
+		g.tickBudget = config.tickBudget > 0 ? config.tickBudget : 1;
+		SetTickRate(config.tickRate);
+		g.pipe.enabled = config.pipelined && !config.headless;
 
 		return true;
 	}
 
 	void App::Shutdown()
 	{
+		JobShutdown();
 		FileShutdown();
 
 		CodeShutdown();
@@ -241,15 +947,30 @@ namespace GASandbox
 		{
 			GuiShutdown();
 			GlShutdown();
-			WinShutdown();
 		}
+
+		WinShutdown();
+		MemShutdown();
 	}
 
 	void App::Update(f64 dt)
 	{
-		CodeCollectGarbage();
-		WinPollEvents();
-		NetPollEvents();
+		PROFILE("Update");
+
+		{
+			sAppTimer timer(g.frame.gc);
+			CodeCollectGarbage();
+		}
+
+		// Pipelined frames poll at the handoff, glfw events belong to the main thread
+		if (!g.pipe.busy)
+			WinPollEvents();
+
+		// Once per frame, however many ticks run
+		{
+			sAppTimer timer(g.frame.net);
+			NetPollEvents();
+		}
 
 		g.frames++;
 		g.time += dt;
@@ -261,12 +982,46 @@ namespace GASandbox
 			g.time = std::fmod(g.time, 1.f);
 		}
 
-		CodeUpdate(dt);
-		SfxUpdate(dt);
+		// Fixed simulation ticks, decoupled from the frame delta
+		g.tickAccum += dt;
+
+		u32 ticks = 0;
+		while (g.tickAccum >= g.tickDt && ticks < g.tickBudget)
+		{
+			FixedUpdate(g.tickDt);
+			g.tickAccum -= g.tickDt;
+			ticks++;
+		}
+		g.frame.ticks += ticks;
+
+		// Out of budget, drop the backlog instead of spiralling
+		if (g.tickAccum >= g.tickDt)
+			g.tickAccum = std::fmod(g.tickAccum, g.tickDt);
+
+		g.tickAlpha = g.tickAccum / g.tickDt;
+
+		{
+			sAppTimer timer(g.frame.code);
+			CodeUpdate(dt);
+		}
+		{
+			sAppTimer timer(g.frame.sfx);
+			SfxUpdate(dt);
+		}
+	}
+
+	void App::FixedUpdate(f64 dt)
+	{
+		PROFILE("FixedUpdate");
+
+		sAppTimer timer(g.frame.fixed);
+		CodeFixedUpdate(dt);
 	}
 
 	void App::Render()
 	{
+		PROFILE("Render");
+
 		i32 w = WinWidth(), h = WinHeight();
 		if (w == 0 || h == 0)
 		{
@@ -281,6 +1036,18 @@ namespace GASandbox
 		GuiGlNewFrame();
 		ImGui::NewFrame();
 
+		// Recorded, then sorted and merged at submit, the gui draws on top
+		GlPacketBegin(0);
+		RenderFrame();
+		GlPacketEnd();
+		GlPacketSubmit(0);
+		GuiGlRender();
+
+		WinSwapBuffers();
+	}
+
+	void App::RenderFrame()
+	{
 		GuiRender();
 
 		ImGui::SetNextWindowPos(ImVec2(0, ImGui::GetFrameHeight()));
@@ -301,10 +1068,109 @@ namespace GASandbox
 		ImGui::PopStyleVar(2);
 		ImGui::PopStyleColor();
 		ImGui::End();
+	}
 
-		GuiGlRender();
+	void App::PipelineFrame(f64 dt)
+	{
+		PROFILE("PipelineFrame");
 
-		WinSwapBuffers();
+		if (!g.pipe.thread.joinable())
+			g.pipe.thread = std::thread(PipelineWorker);
+
+		// Handoff, the worker is idle until it is woken below. The gui frame begins and ends on this thread while the
+		// worker is idle, in between only the worker touches the gui context and the submission draws the packet's copy.
+		WinDefer(true);
+		WinPollEvents();
+		WinHandoff();
+		GuiWinNewFrame();
+		GuiGlNewFrame();
+		ImGui::NewFrame();
+
+		const u32 submit = g.pipe.packet;
+		const bool ready = g.pipe.ready;
+		{
+			std::lock_guard<std::mutex> lock(g.pipe.mutex);
+			g.pipe.dt = dt;
+			g.pipe.packet = submit ^ 1;
+			g.pipe.busy = true;
+		}
+		g.pipe.wake.notify_one();
+
+		// The first frame after a reload or a mode switch has nothing to show yet
+		if (ready)
+		{
+			sAppTimer timer(g.frame.render);
+			GlPacketSubmit(submit);
+			WinSwapBuffers();
+		}
+
+		std::unique_lock<std::mutex> lock(g.pipe.mutex);
+		g.pipe.done.wait(lock, [] { return !g.pipe.busy; });
+		g.pipe.ready = true;
+
+		if (g.pipe.visible)
+			GlPacketGui(g.pipe.packet);
+		else
+			ImGui::EndFrame();
+	}
+
+	void App::PipelineSimulate(f64 dt, u32 packet)
+	{
+		PROFILE("PipelineSimulate");
+
+		{
+			sAppTimer timer(g.frame.update);
+			Update(dt);
+		}
+
+		// Same frame as Render, recorded instead of drawn
+		GlPacketBegin(packet);
+		i32 w = WinWidth(), h = WinHeight();
+		g.pipe.visible = w != 0 && h != 0;
+		if (g.pipe.visible)
+		{
+			GlViewport(0, 0, w, h);
+			GlClear(0, 0, 0, 1, 1, 0, eGlClearFlags::ALL);
+			RenderFrame();
+		}
+		GlPacketEnd();
+	}
+
+	void App::PipelineWorker()
+	{
+		ProfThread("Simulation");
+
+		std::unique_lock<std::mutex> lock(g.pipe.mutex);
+		while (true)
+		{
+			g.pipe.wake.wait(lock, [] { return g.pipe.busy || g.pipe.quit; });
+			if (g.pipe.quit)
+				return;
+
+			lock.unlock();
+			PipelineSimulate(g.pipe.dt, g.pipe.packet);
+			lock.lock();
+
+			g.pipe.busy = false;
+			g.pipe.done.notify_one();
+		}
+	}
+
+	void App::PipelineStop()
+	{
+		if (!g.pipe.thread.joinable())
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(g.pipe.mutex);
+			g.pipe.quit = true;
+		}
+		g.pipe.wake.notify_one();
+		g.pipe.thread.join();
+
+		g.pipe.quit = false;
+		g.pipe.ready = false;
+		WinDefer(false);
 	}
 
 	void App::GuiRender()
@@ -319,13 +1185,14 @@ namespace GASandbox
 					i32 idx = 0;
 					for (const auto& i : index)
 					{
-						if (ImGui::MenuItem(i.path.c_str()))
+						if (ImGui::MenuItem(i.path))
 							break;
 						idx++;
 					}
 					if (idx != index.size())
 					{
 						g.currentIndex = idx;
+						g.scenePath.clear();
 						QueueReload();
 					}
 
@@ -336,6 +1203,12 @@ namespace GASandbox
 				{
 					if (ImGui::MenuItem("Console"))
 						g.showConsole = !g.showConsole;
+					if (ImGui::MenuItem("Profiler"))
+						g.showProfiler = !g.showProfiler;
+					if (ImGui::MenuItem("Script Calls"))
+						g.showScriptCalls = !g.showScriptCalls;
+					if (ImGui::MenuItem("Memory"))
+						g.showMemory = !g.showMemory;
 
 #ifdef _DEBUG
 					ImGui::Separator();
@@ -403,8 +1276,8 @@ namespace GASandbox
 			if (ImGui::MenuItem(CodeIsPaused() ? "Play" : "Pause"))
 				CodeTogglePaused();
 
-			const size_type bytesAllocated = CodeBytesAllocated();
-			ImGui::Text(" |  v%s  | %5.0f fps | %6.2f ms | %6.2f mb", VERSION_STR, g.fps, g.spf * 1000, bytesAllocated / 100000.f);
+			const size_type bytesAllocated = MemTotalBytes();
+			ImGui::Text(" |  v%s  | %5.0f fps | %6.2f ms | %6.2f mb", VERSION_STR, g.fps, g.spf * 1000, bytesAllocated / (1024.f * 1024.f));
 			ImGui::EndMainMenuBar();
 		}
 
@@ -413,6 +1286,21 @@ namespace GASandbox
 			ImGui::ShowDemoWindow(&g.showImGuiDemo);
 		}
 
+		if (g.showProfiler)
+		{
+			ProfGuiRender(&g.showProfiler);
+		}
+
+		if (g.showScriptCalls)
+		{
+			CodeStatsGuiRender(&g.showScriptCalls);
+		}
+
+		if (g.showMemory)
+		{
+			MemGuiRender(&g.showMemory);
+		}
+
 		if (g.showConsole)
 		{
 			ImGui::SetNextWindowPos(ImVec2(ImGui::GetIO().DisplaySize.x * 0.05f, ImGui::GetFrameHeight() + (ImGui::GetIO().DisplaySize.y - ImGui::GetFrameHeight()) * 0.25f), ImGuiCond_Appearing);
@@ -434,11 +1322,11 @@ namespace GASandbox
 						clipboard.clear();
 						clipboard.reserve(4096);
 
-						for (const auto& log : g.logs)
+						std::lock_guard<std::mutex> lock(g.logMutex);
+						for (u32 i = g.logsFirst; i != LOG_NONE; i = g.logs[i].next)
 						{
-							size_type length = log.message.size();
-							if (length > 0 && log.message[length - 1] == '\0') --length;
-							clipboard.append(log.message, 0, length).append("\n");
+							const auto& log = g.logs[i];
+							clipboard.append(log.message, log.length).append("\n");
 						}
 
 						ImGui::SetClipboardText(clipboard.c_str());
@@ -448,14 +1336,19 @@ namespace GASandbox
 				}
 
 				ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(4, 1));
-				for (const auto& log : g.logs)
 				{
-					ImGui::PushStyleColor(ImGuiCol_Text, log.color);
-					if (log.count > 0)
-						ImGui::Text("(%d) %s", log.count, log.message.c_str());
-					else
-						ImGui::TextUnformatted(log.message.c_str());
-					ImGui::PopStyleColor();
+					// The writer thread appends to the console store, hold it while drawing
+					std::lock_guard<std::mutex> lock(g.logMutex);
+					for (u32 i = g.logsFirst; i != LOG_NONE; i = g.logs[i].next)
+					{
+						const auto& log = g.logs[i];
+						ImGui::PushStyleColor(ImGuiCol_Text, log.color);
+						if (log.count > 0)
+							ImGui::Text("(%u) %.*s", log.count, (i32)log.length, log.message);
+						else
+							ImGui::TextUnformatted(log.message, log.message + log.length);
+						ImGui::PopStyleColor();
+					}
 				}
 
 				if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
@@ -478,51 +1371,384 @@ namespace GASandbox
 		config.msaa = 8;
 		config.headless = false;
 
+		for (i32 i = 1; i < argc; ++i)
+		{
+			cstring arg = args[i];
+
+			if (std::strcmp(arg, "--help") == 0)
+			{
+				app_usage(args[0]);
+				return false;
+			}
+
+			if (std::strcmp(arg, "--headless") == 0)
+			{
+				config.headless = true;
+				continue;
+			}
+
+			if (std::strcmp(arg, "--pipelined") == 0)
+			{
+				config.pipelined = true;
+				continue;
+			}
+
+			if (i + 1 >= argc)
+			{
+				LOGE("Missing value for option: %s", arg);
+				app_usage(args[0]);
+				return false;
+			}
+
+			cstring value = args[++i];
+			bool valid = true;
+			if (std::strcmp(arg, "--scene") == 0)
+				config.scene = value;
+			else if (std::strcmp(arg, "--frames") == 0)
+				valid = app_parse_uint(value, config.frames);
+			else if (std::strcmp(arg, "--seconds") == 0)
+				valid = app_parse_number(value, 0, config.seconds);
+			else if (std::strcmp(arg, "--dt") == 0)
+				valid = app_parse_number(value, 0, config.virtualDt);
+			else if (std::strcmp(arg, "--tick-rate") == 0)
+				valid = app_parse_number(value, 0, config.tickRate) && config.tickRate > 0;
+			else if (std::strcmp(arg, "--report") == 0)
+				config.report = value;
+			else if (std::strcmp(arg, "--trace") == 0)
+				config.trace = value;
+			else if (std::strcmp(arg, "--script-stats") == 0)
+				config.scriptStats = value;
+			else if (std::strcmp(arg, "--dump-draws") == 0)
+				config.dumpDraws = value;
+			else if (std::strcmp(arg, "--jobs") == 0)
+				valid = app_parse_uint(value, config.jobThreads);
+			else if (std::strcmp(arg, "--watch") == 0)
+				valid = app_parse_number(value, 0, config.watchInterval);
+			else if (std::strcmp(arg, "--pack") == 0)
+				config.pack = value;
+			else if (std::strcmp(arg, "--write-pack") == 0)
+				config.writePack = value;
+			else if (std::strcmp(arg, "--check-shaders") == 0)
+				config.checkShaders = value;
+			else if (std::strcmp(arg, "--preprocess") == 0)
+				config.preprocess = value;
+			else if (std::strcmp(arg, "--load-budget") == 0)
+				valid = app_parse_number(value, 0, config.loadBudget);
+			else if (std::strcmp(arg, "--cache") == 0)
+				config.cache = value;
+			else if (std::strcmp(arg, "--baked") == 0)
+				config.baked = value;
+			else
+			{
+				LOGE("Unknown option: %s", arg);
+				app_usage(args[0]);
+				return false;
+			}
+
+			if (!valid)
+			{
+				LOGE("Invalid value for option %s: %s", arg, value);
+				app_usage(args[0]);
+				return false;
+			}
+		}
+
+		if (config.headless && config.frames == 0 && config.seconds <= 0)
+			LOGW("Headless run without --frames or --seconds, it only stops when the script calls App.winClose().");
+
 		return true;
 	}
 
 	i32 App::Run(i32 argc, char** args)
 	{
+		ProfThread("Main");
+
 		sAppConfig config{};
 		LOGD("App configuring ...");
 		if (!Configure(argc, args, config))
 		{
+			LogShutdown();
 			return EXIT_FAILURE;
 		}
 		LOGD("App configured.");
 
+		if (!config.writePack.empty())
+		{
+			// Always baked from the loose files
+			config.pack.clear();
+			const bool packed = FileInitialize(config) && FilePack(config.writePack.c_str());
+			FileShutdown();
+			LogShutdown();
+			return packed ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		if (!config.checkShaders.empty() || !config.preprocess.empty())
+		{
+			const bool valid = FileInitialize(config) && app_check_shaders(config);
+			FileShutdown();
+			LogShutdown();
+			return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		// Before initializing, so the trace shows the startup too
+		if (!config.trace.empty())
+		{
+			ProfEnable(true);
+			ProfRecord(true);
+		}
+
 		LOGD("App initializing ...");
 		if (!Initialize(config))
 		{
+			LogShutdown();
 			return EXIT_FAILURE;
 		}
 		LOGD("App initialized.");
 
+		if (!config.report.empty() && config.frames > 0)
+			g.frameTimings.reserve(config.frames);
+
+		if (!config.scriptStats.empty())
+			CodeStatsEnable(true);
+
+		u32 frames = 0;
+		f64 elapsed = 0;
 		f64 lastTime = GetTime();
+		const bool watch = !config.headless && config.watchInterval > 0;
+		f64 nextWatch = lastTime + config.watchInterval;
+		list<sFileInfo> changed;
 		while (!WinShouldClose())
 		{
+			ProfFrame();
+			CodeStatsFrame();
+			MemFrame();
+
+			// Allocations are counted from one frame start to the next
+			if (!g.frameTimings.empty())
+				g.frameTimings.back().allocs = MemFrameAllocs();
+
+			if (watch && lastTime >= nextWatch)
+			{
+				nextWatch = lastTime + config.watchInterval;
+				FilePollChanges(changed);
+				if (!changed.empty())
+				{
+					ReloadChanged(changed);
+					lastTime = GetTime();
+				}
+			}
+
 			if (g.reload)
-				Reload(config);
+			{
+				if (frames == 0)
+					app_startup("scripts", [&] { Reload(config); return true; });
+				else
+					Reload(config);
+				lastTime = GetTime(); // Don't feed the reload time into the scheduler
+				g.pipe.ready = false; // Recorded with the previous scene's resources
+			}
+
+			// Between frames, the simulation worker is idle
+			GlFinishLoads(config.loadBudget / 1000.0);
+
+			// Scenes can opt out at any reload, the pending packet is dropped when switching back to serial frames
+			const bool pipelined = Pipelined();
+			if (!pipelined)
+			{
+				g.pipe.ready = false;
+				WinDefer(false);
+			}
 
 			f64 currentTime = GetTime();
 			f64 deltaTime = currentTime - lastTime;
 			lastTime = currentTime;
 
-			Update(deltaTime);
-			if (!config.headless)
-				Render();
+			// Headless runs on a virtual clock, either a fixed frame delta or exactly one tick per frame
+			if (config.headless)
+				deltaTime = config.virtualDt > 0 ? config.virtualDt : g.tickDt;
+
+			g.frame = sAppFrame{};
+			g.frame.dt = deltaTime;
+			if (pipelined)
+			{
+				PipelineFrame(deltaTime);
+			}
+			else
+			{
+				{
+					sAppTimer timer(g.frame.update);
+					Update(deltaTime);
+				}
+				if (!config.headless)
+				{
+					sAppTimer timer(g.frame.render);
+					Render();
+				}
+				else if (!config.dumpDraws.empty())
+				{
+					// Recorded and planned like a drawn frame, nothing reaches a driver
+					sAppTimer timer(g.frame.render);
+					GlPacketBegin(0);
+					CodeRender();
+					GlPacketEnd();
+					GlPacketSubmit(0);
+				}
+			}
+
+			if (!config.report.empty())
+				g.frameTimings.push_back(g.frame);
+
+			if (frames == 0)
+				app_log_startup();
+
+			frames++;
+			elapsed += deltaTime;
+			if ((config.frames > 0 && frames >= config.frames) || (config.seconds > 0 && elapsed >= config.seconds))
+				break;
+		}
+
+		MemFrame();
+		if (!g.frameTimings.empty())
+			g.frameTimings.back().allocs = MemFrameAllocs();
+
+		PipelineStop();
+
+		if (!config.report.empty())
+		{
+			cstring scene = g.scenePath.empty() ? FileGetIndex()[g.currentIndex].path : g.scenePath.c_str();
+			if (app_report(config.report.c_str(), scene, g.tickDt))
+				LOGI("Wrote %zu frame timings to %s", g.frameTimings.size(), config.report.c_str());
+			else
+				LOGE("Failed to write report: %s", config.report.c_str());
+		}
+
+		if (!config.trace.empty())
+		{
+			if (ProfSave(config.trace.c_str()))
+				LOGI("Wrote profiler trace to %s", config.trace.c_str());
+			else
+				LOGE("Failed to write trace: %s", config.trace.c_str());
+		}
+
+		if (!config.dumpDraws.empty())
+		{
+			if (GlDumpDraws(config.dumpDraws.c_str()))
+				LOGI("Wrote draw stream to %s", config.dumpDraws.c_str());
+			else
+				LOGE("Failed to write draw stream: %s", config.dumpDraws.c_str());
+		}
+
+		if (!config.scriptStats.empty())
+		{
+			if (CodeStatsSave(config.scriptStats.c_str()))
+				LOGI("Wrote script call statistics to %s", config.scriptStats.c_str());
+			else
+				LOGE("Failed to write script call statistics: %s", config.scriptStats.c_str());
 		}
 
 		LOGD("App shutting down ...");
 		Shutdown();
 		LOGD("App shutdown.");
 
+		LogShutdown();
 		return EXIT_SUCCESS;
 	}
 
+	i32 App::Bake(i32 argc, char** args)
+	{
+		ProfThread("Main");
+
+		sAppConfig config{};
+		if (!Configure(argc, args, config))
+		{
+			LogShutdown();
+			return EXIT_FAILURE;
+		}
+
+		// Always from the loose files, and never through the cache so every output comes from its source
+		config.pack.clear();
+		config.cache.clear();
+		if (config.baked.empty())
+		{
+			LOGE("Nothing to bake into, --baked is empty.");
+			LogShutdown();
+			return EXIT_FAILURE;
+		}
+
+		if (!MemInitialize(config) || !JobInitialize(config) || !FileInitialize(config))
+		{
+			LogShutdown();
+			return EXIT_FAILURE;
+		}
+
+		const f64 start = GetTime();
+		static const std::pair<cstring, bool (*)(cstring)> bakers[] = {
+			{ "png", GlBakeImage }, { "jpg", GlBakeImage }, { "jpeg", GlBakeImage }, { "tga", GlBakeImage }, { "bmp", GlBakeImage },
+			{ "gltf", GlBakeModel }, { "glb", GlBakeModel },
+			{ "ogg", SfxBakeAudio }, { "wav", SfxBakeAudio }, { "mp3", SfxBakeAudio }, { "flac", SfxBakeAudio }
+		};
+
+		list<sAppBakeJob> jobs{};
+		const auto& manifest = FileGetManifest();
+		for (const auto& baker : bakers)
+		{
+			for (const u32 file : FileFindByExt(baker.first))
+			{
+				sAppBakeJob job{};
+				job.path = manifest[file].path;
+				job.bake = baker.second;
+				jobs.push_back(job);
+			}
+		}
+
+		sJobCounter counter{};
+		for (auto& job : jobs)
+			JobSubmit(app_bake, &job, &counter);
+		JobWait(counter);
+
+		const u32 failed = (u32)std::count_if(jobs.begin(), jobs.end(), [](const sAppBakeJob& job) { return job.failed; });
+		LOGI("Baked %zu assets into %s in %.2f s on %u threads, %u outputs written, %u failed",
+			jobs.size(), config.baked.c_str(), GetTime() - start, JobWorkerCount() + 1, FileBakedWrites(), failed);
+
+		JobShutdown();
+		FileShutdown();
+		MemShutdown();
+		LogShutdown();
+		return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	void App::ReloadChanged(const list<sFileInfo>& changed)
+	{
+		PROFILE("ReloadChanged");
+
+		const f64 start = GetTime();
+		const u32 shaders = GlReloadShaders(changed);
+
+		static size_type wren_hash = Hash("wren");
+		bool scripts = false;
+		for (const auto& info : changed)
+			scripts |= info.extHash == wren_hash;
+
+		// Only changed modules and their importers are recompiled, the vm and its bindings are kept
+		if (scripts && !CodeReloadModules(changed))
+		{
+			LOGW("Incremental script reload failed, reloading the scene.");
+			g.reload = true;
+			return;
+		}
+
+		LOGI("Hot reloaded %zu changed files (%u shaders) in %.2f ms", changed.size(), shaders, (GetTime() - start) * 1000.0);
+	}
+
 	void App::Reload(const sAppConfig& config)
 	{
+		PROFILE("Reload");
+
 		g.reload = false;
+		g.tickAccum = 0;
+		g.tickAlpha = 0;
+		g.pipe.optOut = false;
+		SetTickRate(config.tickRate); // A scene's setTickRate doesn't carry over to the next one
 
 		// Clear logs
 		LogClear();
@@ -539,6 +1765,8 @@ namespace GASandbox
 		GuiReload();
 		SfxReload();
 		NetReload();
+		JobReload();
+		FileReload();
 
 		// Application API
 		CodeBindMethod("app", "App", true, "wait(_)",
@@ -555,23 +1783,96 @@ namespace GASandbox
 				CodeSetSlotBool(vm, 0, IsHeadless());
 			});
 
+		CodeBindMethod("app", "App", true, "tickDt",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				CodeSetSlotDouble(vm, 0, TickDt());
+			});
+
+		CodeBindMethod("app", "App", true, "tickAlpha",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				CodeSetSlotDouble(vm, 0, TickAlpha());
+			});
+
+		CodeBindMethod("app", "App", true, "setTickRate(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				SetTickRate(CodeGetSlotDouble(vm, 1));
+			});
+
+		CodeBindMethod("app", "App", true, "pipelined",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 0);
+				CodeSetSlotBool(vm, 0, Pipelined());
+			});
+
+		CodeBindMethod("app", "App", true, "setPipelined(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				SetPipelined(CodeGetSlotBool(vm, 1));
+			});
+
+		CodeBindMethod("app", "App", true, "profBegin(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				if (ProfIsEnabled())
+					ProfScriptBegin(ProfName(CodeGetSlotString(vm, 1)));
+			});
+
+		CodeBindMethod("app", "App", true, "profEnd()",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				if (ProfIsEnabled())
+					ProfScriptEnd();
+			});
+
+		CodeBindMethod("app", "App", true, "memFrameAllocs",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				CodeSetSlotUInt(vm, 0, MemFrameAllocs());
+			});
+
+		CodeBindMethod("app", "App", true, "memBytes",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				CodeSetSlotDouble(vm, 0, (f64)MemTotalBytes());
+			});
+
 		// Load scripts in manifest
+		const size_type sceneHash = g.scenePath.empty() ? 0 : Hash(g.scenePath);
 		const auto& manifest = FileGetManifest();
-		for (const auto& path : manifest)
+		for (const u32 file : FileFindByExt("wren"))
 		{
-			static size_type main_hash = str_hash("main");
-			if (path.nameHash == main_hash)
+			static size_type main_hash = Hash("main");
+			const auto& path = manifest[file];
+			if (path.nameHash == main_hash || path.pathHash == sceneHash)
 				continue;
 
-			static size_type wren_hash = str_hash("wren");
-			if (path.extHash == wren_hash)
-				CodeParseFile(path.name.c_str(), path.path.c_str());
+			CodeParseFile(path.name, path.path);
 		}
 
 		// Main callbacks
-		const auto& index = FileGetIndex();
-		const auto& current = index[g.currentIndex];
-		CodeParseFile(current.name.c_str(), current.path.c_str());
+		if (g.scenePath.empty())
+		{
+			const auto& index = FileGetIndex();
+			const auto& current = index[g.currentIndex];
+			CodeParseFile(current.name, current.path);
+		}
+		else
+		{
+			// Any script can be the scene, it is parsed as the main module
+			CodeParseFile("main", g.scenePath.c_str());
+		}
 
 		CodeReload();
 
@@ -5,8 +5,40 @@ extern "C" {
 #include <wren_vm.h>
 }
 
+#include <imgui.h>
+
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
 namespace GASandbox
 {
+	// Foreign methods are bound through a fixed pool of trampolines while method statistics are enabled,
+	// each slot forwards to the registered method and accumulates calls and time for its signature
+	constexpr u32 CODE_STAT_SLOTS = 256;
+
+	struct sCodeMethodStat
+	{
+		string signature{};
+		fCodeMethod method{ nullptr };
+		u64 calls{ 0 };
+		i64 time{ 0 }; // ns
+		u64 frameCalls{ 0 };
+		i64 frameTime{ 0 };
+		u64 markCalls{ 0 };
+		i64 markTime{ 0 };
+	};
+
+	// Modules parsed from a file, in parse order, so a change can recompile the module and every importer of it
+	struct sCodeModule
+	{
+		string name{};
+		string path{};
+		size_type pathHash{ 0 };
+		list<string> imports{};
+	};
+
 	struct sWrenGlobal
 	{
 		// Script
@@ -14,6 +46,7 @@ namespace GASandbox
 		WrenHandle* mainClass{ nullptr };
 		WrenHandle* initMethod{ nullptr };
 		WrenHandle* updateMethod{ nullptr };
+		WrenHandle* fixedUpdateMethod{ nullptr };
 		WrenHandle* renderMethod{ nullptr };
 		WrenHandle* netcodeMethod{ nullptr };
 		WrenHandle* audioMethod{ nullptr };
@@ -22,9 +55,56 @@ namespace GASandbox
 
 		hashmap<size_type, sCodeClass> classes{};
 		hashmap<size_type, fCodeMethod> methods{};
+		list<sCodeModule> modules{};
+
+		// Method statistics
+		bool statsEnabled{ false };
+		sCodeMethodStat stats[CODE_STAT_SLOTS]{};
+		u32 statCount{ 0 };
+		hashmap<size_type, u32> statSlots{};
+		u64 statFrames{ 0 };
 	};
 	static sWrenGlobal g;
 
+	template <size_type N>
+	static void wren_stat_method(WrenVM* vm)
+	{
+		auto& stat = g.stats[N];
+		const auto start = std::chrono::steady_clock::now();
+		stat.method((sCodeVM*)vm);
+		stat.time += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		stat.calls++;
+	}
+
+	template <size_type... N>
+	static const WrenForeignMethodFn* wren_stat_table(meta::index_sequence<N...>)
+	{
+		static const WrenForeignMethodFn table[] = { &wren_stat_method<N>... };
+		return table;
+	}
+
+	static WrenForeignMethodFn wren_stat_bind(size_type hash, fCodeMethod method, cstring className, bool isStatic, cstring signature)
+	{
+		auto it = g.statSlots.find(hash);
+		if (it == g.statSlots.end())
+		{
+			if (g.statCount >= CODE_STAT_SLOTS)
+			{
+				LOGW("Out of method statistic slots, %s.%s is not tracked.", className, signature);
+				return (WrenForeignMethodFn)method;
+			}
+
+			it = g.statSlots.insert(std::make_pair(hash, g.statCount++)).first;
+		}
+
+		auto& stat = g.stats[it->second];
+		stat.signature = string(isStatic ? "static " : "") + className + "." + signature;
+		stat.method = method;
+
+		static const WrenForeignMethodFn* table = wren_stat_table(meta::make_index_sequence<CODE_STAT_SLOTS>{});
+		return table[it->second];
+	}
+
 	static size_type wren_class_hash(cstring moduleName, cstring className)
 	{
 		return App::Hash(moduleName) ^ App::Hash(className);
@@ -35,6 +115,83 @@ namespace GASandbox
 		return App::Hash(moduleName) ^ App::Hash(className) ^ App::Hash(isStatic ? "s" : "") ^ App::Hash(signature);
 	}
 
+	static bool wren_has_static_method(WrenHandle* classHandle, cstring signature)
+	{
+		if (classHandle == nullptr || !IS_CLASS(classHandle->value))
+			return false;
+
+		const ObjClass* metaclass = AS_CLASS(classHandle->value)->obj.classObj;
+		const i32 symbol = wrenSymbolTableFind(&g.vm->methodNames, signature, strlen(signature));
+		return symbol >= 0 && symbol < metaclass->methods.count && metaclass->methods.data[symbol].type != METHOD_NONE;
+	}
+
+	static void wren_scan_imports(cstring source, size_type size, list<string>& imports)
+	{
+		imports.clear();
+
+		cstring end = source + size;
+		while (source < end)
+		{
+			cstring eol = static_cast<cstring>(std::memchr(source, '\n', end - source));
+			if (eol == nullptr)
+				eol = end;
+
+			cstring start = source;
+			while (start < eol && (*start == ' ' || *start == '\t'))
+				start++;
+
+			if (eol - start >= 7 && std::strncmp(start, "import ", 7) == 0)
+			{
+				cstring open = static_cast<cstring>(std::memchr(start, '"', eol - start));
+				cstring close = open ? static_cast<cstring>(std::memchr(open + 1, '"', eol - open - 1)) : nullptr;
+				if (close != nullptr)
+					imports.emplace_back(open + 1, close);
+			}
+
+			source = eol + 1;
+		}
+	}
+
+	static void wren_remove_module(cstring moduleName)
+	{
+		Value name = wrenNewString(g.vm, moduleName);
+		wrenPushRoot(g.vm, AS_OBJ(name));
+		wrenMapRemoveKey(g.vm, g.vm->modules, name);
+		wrenPopRoot(g.vm);
+	}
+
+	static void wren_main_init()
+	{
+		if (g.mainClass) wrenReleaseHandle(g.vm, g.mainClass);
+		if (g.fixedUpdateMethod) wrenReleaseHandle(g.vm, g.fixedUpdateMethod);
+		g.mainClass = nullptr;
+		g.fixedUpdateMethod = nullptr;
+
+		wrenEnsureSlots(g.vm, 1);
+		wrenGetVariable(g.vm, "main", "Main", 0);
+		g.mainClass = wrenGetSlotHandle(g.vm, 0);
+		wrenSetSlotHandle(g.vm, 0, g.mainClass);
+
+		// Optional, scripts without a fixed step keep running everything from update(_)
+		if (wren_has_static_method(g.mainClass, "fixedUpdate(_)"))
+			g.fixedUpdateMethod = wrenMakeCallHandle(g.vm, "fixedUpdate(_)");
+
+		try
+		{
+			wrenEnsureSlots(g.vm, 1);
+			wrenSetSlotHandle(g.vm, 0, g.mainClass);
+			wrenCall(g.vm, g.initMethod);
+		}
+		catch (const std::exception& e)
+		{
+			LOGE("Script exception: %s", e.what());
+			wrenSetSlotString(g.vm, 0, e.what());
+			wrenAbortFiber(g.vm, 0);
+
+			g.error = true;
+		}
+	}
+
 	static WrenForeignMethodFn wren_bind_method(WrenVM* vm, cstring moduleName, cstring className, bool isStatic, cstring signature)
 	{
 		if (strcmp(moduleName, "random") == 0)
@@ -44,9 +201,13 @@ namespace GASandbox
 
 		const size_type hash = wren_method_hash(moduleName, className, isStatic, signature);
 		const auto it = g.methods.find(hash);
-		if (it != g.methods.end())
-			return (WrenForeignMethodFn)it->second;
-		return nullptr;
+		if (it == g.methods.end())
+			return nullptr;
+
+		if (g.statsEnabled)
+			return wren_stat_bind(hash, it->second, className, isStatic, signature);
+
+		return (WrenForeignMethodFn)it->second;
 	}
 
 	static WrenForeignMethodFn wren_allocate(const size_type classHash)
@@ -115,13 +276,7 @@ namespace GASandbox
 
 	static void* wren_reallocate(void* ptr, size_type newSize, void* _)
 	{
-		if (newSize == 0)
-		{
-			free(ptr);
-			return NULL;
-		}
-
-		return realloc(ptr, newSize);
+		return App::MemRealloc(eMemTag::CODE, ptr, newSize);
 	}
 
 	static cstring wren_resolve_module(WrenVM* vm, cstring importer, cstring name)
@@ -131,6 +286,14 @@ namespace GASandbox
 
 	bool App::CodeInitialize(const sAppConfig& config)
 	{
+		// Methods are bound again by the new vm
+		for (u32 i = 0; i < g.statCount; ++i)
+			g.stats[i] = sCodeMethodStat{};
+		g.statCount = 0;
+		g.statSlots.clear();
+		g.statFrames = 0;
+		g.modules.clear();
+
 		WrenConfiguration wrenConfig;
 		wrenInitConfiguration(&wrenConfig);
 		wrenConfig.writeFn = wren_write;
@@ -156,6 +319,7 @@ namespace GASandbox
 		if (g.mainClass) wrenReleaseHandle(g.vm, g.mainClass);
 		if (g.initMethod) wrenReleaseHandle(g.vm, g.initMethod);
 		if (g.updateMethod) wrenReleaseHandle(g.vm, g.updateMethod);
+		if (g.fixedUpdateMethod) wrenReleaseHandle(g.vm, g.fixedUpdateMethod);
 		if (g.netcodeMethod) wrenReleaseHandle(g.vm, g.netcodeMethod);
 		if (g.audioMethod) wrenReleaseHandle(g.vm, g.audioMethod);
 		if (g.vm) wrenFreeVM(g.vm);
@@ -164,12 +328,15 @@ namespace GASandbox
 		g.mainClass = nullptr;
 		g.initMethod = nullptr;
 		g.updateMethod = nullptr;
+		g.fixedUpdateMethod = nullptr;
 		g.netcodeMethod = nullptr;
 		g.audioMethod = nullptr;
 	}
 
 	void App::CodeCollectGarbage()
 	{
+		PROFILE("CodeCollectGarbage");
+
 		if (!g.error)
 			wrenCollectGarbage(g.vm);
 	}
@@ -189,8 +356,138 @@ namespace GASandbox
 		g.paused = !g.paused;
 	}
 
+	void App::CodeStatsEnable(bool enabled)
+	{
+		if (enabled == g.statsEnabled)
+			return;
+
+		// Foreign methods are only resolved when scripts are compiled
+		g.statsEnabled = enabled;
+		QueueReload();
+	}
+
+	bool App::CodeStatsEnabled()
+	{
+		return g.statsEnabled;
+	}
+
+	void App::CodeStatsFrame()
+	{
+		if (!g.statsEnabled)
+			return;
+
+		for (u32 i = 0; i < g.statCount; ++i)
+		{
+			auto& stat = g.stats[i];
+			stat.frameCalls = stat.calls - stat.markCalls;
+			stat.frameTime = stat.time - stat.markTime;
+			stat.markCalls = stat.calls;
+			stat.markTime = stat.time;
+		}
+		g.statFrames++;
+	}
+
+	bool App::CodeStatsSave(cstring filepath)
+	{
+		FILE* file = std::fopen(filepath, "w");
+		if (file == nullptr)
+			return false;
+
+		list<const sCodeMethodStat*> sorted{};
+		for (u32 i = 0; i < g.statCount; ++i)
+			sorted.push_back(&g.stats[i]);
+		std::sort(sorted.begin(), sorted.end(), [](const sCodeMethodStat* a, const sCodeMethodStat* b) { return a->time > b->time; });
+
+		const f64 frames = (f64)std::max<u64>(g.statFrames, 1);
+		const size_type len = std::strlen(filepath);
+		if (len >= 4 && std::strcmp(filepath + len - 4, ".csv") == 0)
+		{
+			std::fprintf(file, "signature,calls,total_ms,calls_per_frame,ms_per_frame,ns_per_call\n");
+			for (const auto* stat : sorted)
+			{
+				std::fprintf(file, "\"%s\",%llu,%.6f,%.3f,%.6f,%.1f\n", stat->signature.c_str(), (unsigned long long)stat->calls,
+					stat->time / 1e6, stat->calls / frames, stat->time / 1e6 / frames, stat->calls ? (f64)stat->time / stat->calls : 0.0);
+			}
+		}
+		else
+		{
+			std::fprintf(file, "{\n  \"frames\": %llu,\n  \"methods\": [", (unsigned long long)g.statFrames);
+			for (size_type i = 0; i < sorted.size(); ++i)
+			{
+				const auto* stat = sorted[i];
+				std::fprintf(file, "%s\n    { \"signature\": \"%s\", \"calls\": %llu, \"totalMs\": %.6f, \"callsPerFrame\": %.3f, \"msPerFrame\": %.6f, \"nsPerCall\": %.1f }",
+					i ? "," : "", stat->signature.c_str(), (unsigned long long)stat->calls,
+					stat->time / 1e6, stat->calls / frames, stat->time / 1e6 / frames, stat->calls ? (f64)stat->time / stat->calls : 0.0);
+			}
+			std::fprintf(file, "\n  ]\n}\n");
+		}
+
+		std::fclose(file);
+		return true;
+	}
+
+	void App::CodeStatsGuiRender(bool* open)
+	{
+		ImGui::SetNextWindowSize(ImVec2(700, 400), ImGuiCond_FirstUseEver);
+		if (!ImGui::Begin("Script Calls", open, ImGuiWindowFlags_NoSavedSettings))
+		{
+			ImGui::End();
+			return;
+		}
+
+		bool enabled = g.statsEnabled;
+		if (ImGui::Checkbox("Enabled (reloads scripts)", &enabled))
+			CodeStatsEnable(enabled);
+		ImGui::SameLine();
+		if (ImGui::Button("Save"))
+		{
+			if (CodeStatsSave("script_calls.json"))
+				LOGI("Saved script call statistics to script_calls.json");
+			else
+				LOGW("Failed to save script call statistics!");
+		}
+		ImGui::SameLine();
+		ImGui::Text("| %u methods | %llu frames", g.statCount, (unsigned long long)g.statFrames);
+
+		list<const sCodeMethodStat*> sorted{};
+		for (u32 i = 0; i < g.statCount; ++i)
+			sorted.push_back(&g.stats[i]);
+		std::sort(sorted.begin(), sorted.end(), [](const sCodeMethodStat* a, const sCodeMethodStat* b) { return a->frameTime > b->frameTime; });
+
+		if (ImGui::BeginTable("Methods", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY))
+		{
+			ImGui::TableSetupColumn("Signature");
+			ImGui::TableSetupColumn("Calls/frame");
+			ImGui::TableSetupColumn("ms/frame");
+			ImGui::TableSetupColumn("Calls");
+			ImGui::TableSetupColumn("ns/call");
+			ImGui::TableHeadersRow();
+
+			for (const auto* stat : sorted)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(stat->signature.c_str());
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", (unsigned long long)stat->frameCalls);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", stat->frameTime / 1e6);
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", (unsigned long long)stat->calls);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f", stat->calls ? (f64)stat->time / stat->calls : 0.0);
+			}
+
+			ImGui::EndTable();
+		}
+
+		ImGui::End();
+	}
+
 	void App::CodeUpdate(f64 dt)
 	{
+		PROFILE("CodeUpdate");
+
 		if (g.error || g.paused)
 			return;
 
@@ -209,10 +506,40 @@ namespace GASandbox
 
 			g.error = true;
 		}
+
+		ProfScriptClose();
+	}
+
+	void App::CodeFixedUpdate(f64 dt)
+	{
+		PROFILE("CodeFixedUpdate");
+
+		if (g.error || g.paused || g.fixedUpdateMethod == nullptr)
+			return;
+
+		try
+		{
+			wrenEnsureSlots(g.vm, 2);
+			wrenSetSlotHandle(g.vm, 0, g.mainClass);
+			wrenSetSlotDouble(g.vm, 1, dt);
+			wrenCall(g.vm, g.fixedUpdateMethod);
+		}
+		catch (const std::exception& e)
+		{
+			LOGE("Script exception: %s", e.what());
+			wrenSetSlotString(g.vm, 0, e.what());
+			wrenAbortFiber(g.vm, 0);
+
+			g.error = true;
+		}
+
+		ProfScriptClose();
 	}
 
 	void App::CodeRender()
 	{
+		PROFILE("CodeRender");
+
 		if (g.error)
 			return;
 
@@ -230,10 +557,14 @@ namespace GASandbox
 
 			g.error = true;
 		}
+
+		ProfScriptClose();
 	}
 
 	void App::CodeNetcode(bool server, u32 client, eNetEvent event, u16 peer, u32 channel, u32 packet)
 	{
+		PROFILE("CodeNetcode");
+
 		if (g.error || g.paused)
 			return;
 
@@ -287,6 +618,8 @@ namespace GASandbox
 
 	void App::CodeReload()
 	{
+		PROFILE("CodeReload");
+
 		if (g.error)
 		{
 			CodeShutdown();
@@ -299,36 +632,94 @@ namespace GASandbox
 		g.netcodeMethod = wrenMakeCallHandle(g.vm, "netcode(_,_,_,_,_,_)");
 		g.audioMethod = wrenMakeCallHandle(g.vm, "audio(_,_)");
 
-		wrenEnsureSlots(g.vm, 1);
-		wrenGetVariable(g.vm, "main", "Main", 0);
-		g.mainClass = wrenGetSlotHandle(g.vm, 0);
-		wrenSetSlotHandle(g.vm, 0, g.mainClass);
+		wren_main_init();
+	}
 
-		try
+	bool App::CodeReloadModules(const list<sFileInfo>& changed)
+	{
+		PROFILE("CodeReloadModules");
+
+		if (g.vm == nullptr || g.error || g.mainClass == nullptr)
+			return false;
+
+		list<bool> dirty(g.modules.size(), false);
+		bool any = false;
+		for (size_type i = 0; i < g.modules.size(); ++i)
 		{
-			wrenEnsureSlots(g.vm, 1);
-			wrenSetSlotHandle(g.vm, 0, g.mainClass);
-			wrenCall(g.vm, g.initMethod);
+			for (const auto& info : changed)
+			{
+				if (info.pathHash == g.modules[i].pathHash)
+					dirty[i] = any = true;
+			}
 		}
-		catch (const std::exception& e)
+
+		if (!any)
+			return true;
+
+		// Importers hold copies of the imported variables, so they are recompiled as well
+		for (bool grew = true; grew;)
 		{
-			LOGE("Script exception: %s", e.what());
-			wrenSetSlotString(g.vm, 0, e.what());
-			wrenAbortFiber(g.vm, 0);
+			grew = false;
+			for (size_type i = 0; i < g.modules.size(); ++i)
+			{
+				if (dirty[i])
+					continue;
+
+				for (size_type j = 0; j < g.modules.size() && !dirty[i]; ++j)
+				{
+					if (dirty[j] && std::find(g.modules[i].imports.begin(), g.modules[i].imports.end(), g.modules[j].name) != g.modules[i].imports.end())
+						dirty[i] = grew = true;
+				}
+			}
+		}
 
-			g.error = true;
+		// Parse order already has imports before importers
+		bool mainDirty = false;
+		for (size_type i = 0; i < g.modules.size(); ++i)
+		{
+			if (!dirty[i])
+				continue;
+
+			const string name = g.modules[i].name;
+			const string path = g.modules[i].path;
+			wren_remove_module(name.c_str());
+			CodeParseFile(name.c_str(), path.c_str());
+			if (g.error)
+				return false;
+
+			mainDirty |= name == "main";
 		}
+
+		if (mainDirty)
+			wren_main_init();
+
+		return !g.error;
 	}
 
 	// Script
 	void App::CodeParseFile(cstring moduleName, cstring filepath)
 	{
-		auto src = FileLoad(filepath);
-		CodeParseSource(moduleName, src.c_str());
+		// The compiler reads the mapped bytes, they are zero terminated
+		const auto src = FileMap(filepath);
+
+		auto it = std::find_if(g.modules.begin(), g.modules.end(), [moduleName](const sCodeModule& m) { return m.name == moduleName; });
+		if (it == g.modules.end())
+		{
+			g.modules.emplace_back();
+			it = g.modules.end() - 1;
+			it->name = moduleName;
+		}
+		it->path = filepath;
+		it->pathHash = Hash(filepath);
+		wren_scan_imports(src.data, src.size, it->imports);
+
+		CodeParseSource(moduleName, src.data);
 	}
 
 	void App::CodeParseSource(cstring moduleName, cstring source)
 	{
+		PROFILE("CodeParseSource");
+
 		switch (wrenInterpret(g.vm, moduleName, source))
 		{
 		case WREN_RESULT_COMPILE_ERROR:
@@ -440,6 +831,16 @@ namespace GASandbox
 		wrenSetSlotString((WrenVM*)vm, slot, str);
 	}
 
+	void App::CodeSetSlotBytes(sCodeVM vm, i32 slot, cstring bytes, size_type size)
+	{
+		wrenSetSlotBytes((WrenVM*)vm, slot, bytes, size);
+	}
+
+	void App::CodeSetSlotNull(sCodeVM vm, i32 slot)
+	{
+		wrenSetSlotNull((WrenVM*)vm, slot);
+	}
+
 	void* App::CodeSetSlotNewObject(sCodeVM vm, i32 slot, i32 classSlot, size_type size)
 	{
 		return wrenSetSlotNewForeign((WrenVM*)vm, slot, classSlot, size);
@@ -3,48 +3,1127 @@
 #include <ghc/filesystem.hpp>
 namespace fs = ghc::filesystem;
 
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stb_image.h> // Inflate, implemented with the image loader
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h> // Deflate, for baking packs
+
 #include <fstream>
-#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace GASandbox
+{
+	// Asset pack: header, directory sorted by path hash, zero separated paths, then the blobs. Every blob starts 16 byte
+	// aligned and is followed by at least one zero, so stored entries are handed out in place just like mapped files.
+	// Deflated entries are cut in blocks deflated on their own, led by a table of their packed sizes, so a stream only
+	// ever inflates the block it reads.
+	constexpr u32 FILE_PACK_MAGIC = 0x4B504147; // "GAPK"
+	constexpr u32 FILE_PACK_VERSION = 2;
+	constexpr u64 FILE_PACK_ALIGN = 16;
+	constexpr u64 FILE_PACK_BLOCK = 256 * 1024;
+	constexpr u32 FILE_PACK_DEFLATE = 1;
+
+	struct sFilePackHeader
+	{
+		u32 magic{ FILE_PACK_MAGIC };
+		u32 version{ FILE_PACK_VERSION };
+		u32 count{ 0 };
+		u32 pathsSize{ 0 };
+		u64 pathsOffset{ 0 };
+		u64 blobsOffset{ 0 };
+	};
+
+	struct sFilePackEntry
+	{
+		u64 pathHash{ 0 };
+		u64 offset{ 0 };		// From the start of the pack
+		u64 size{ 0 };
+		u64 packedSize{ 0 };	// Stored bytes, the size unless deflated
+		u32 path{ 0 };			// Into the path table
+		u32 flags{ 0 };
+	};
+	static_assert(sizeof(sFilePackHeader) == 32 && sizeof(sFilePackEntry) == 40, "Pack layout changed");
+
+	// Decoded asset cache: one file per key, the payload first so it maps page aligned, then a trailer to validate it
+	constexpr u32 FILE_CACHE_MAGIC = 0x48434147; // "GACH"
+	constexpr u32 FILE_CACHE_VERSION = 1;
+
+	struct sFileCacheTrailer
+	{
+		u32 magic{ FILE_CACHE_MAGIC };
+		u32 version{ FILE_CACHE_VERSION };
+		u64 key{ 0 };
+		u64 size{ 0 };		// Payload bytes
+		u64 reserved{ 0 };
+	};
+
+	// Baked assets written offline by GASandboxBake: one file per path and settings, laid out like the cache with a trailer
+	// that also records the source it was baked from, so an edited source falls back to the loader's own decode. Files the
+	// source pulls in (glTF buffers) sit between the payload and the trailer: size, mtime and zero terminated path each.
+	constexpr u32 FILE_BAKED_MAGIC = 0x4B424147; // "GABK"
+	constexpr u32 FILE_BAKED_VERSION = 2;
+
+	struct sFileBakedTrailer
+	{
+		u32 magic{ FILE_BAKED_MAGIC };
+		u32 version{ FILE_BAKED_VERSION };
+		u64 key{ 0 };
+		u64 size{ 0 };			// Payload bytes
+		u64 sourceSize{ 0 };
+		i64 sourceTime{ 0 };
+		u64 dependsSize{ 0 };	// Dependency bytes after the payload
+	};
+
+	// Scan results persisted in the cache folder: header, directories, their file and subdirectory paths as offsets into
+	// the string table, then the string table. A directory whose mtime still matches is not listed again at startup.
+	constexpr u32 FILE_MANIFEST_MAGIC = 0x464D4147; // "GAMF"
+	constexpr u32 FILE_MANIFEST_VERSION = 1;
+
+	struct sFileManifestHeader
+	{
+		u32 magic{ FILE_MANIFEST_MAGIC };
+		u32 version{ FILE_MANIFEST_VERSION };
+		u32 dirCount{ 0 };
+		u32 refCount{ 0 };
+		u32 stringsSize{ 0 };
+		u32 reserved{ 0 };
+	};
+
+	struct sFileManifestDir
+	{
+		i64 writeTime{ 0 };
+		u32 path{ 0 };		// Into the string table
+		u32 refs{ 0 };		// First of its files then subdirectories in the refs
+		u32 fileCount{ 0 };
+		u32 subdirCount{ 0 };
+	};
+	static_assert(sizeof(sFileManifestHeader) == 24 && sizeof(sFileManifestDir) == 24, "Manifest layout changed");
+
+	struct sFileDir
+	{
+		cstring path{ "" };
+		i64 writeTime{ 0 };
+		list<u32> files{};		// Into the manifest
+		list<u32> subdirs{};	// Into the directories
+	};
+
+	// Interned strings are never moved, blocks are only released at shutdown
+	constexpr size_type FILE_STRING_BLOCK = 64 * 1024;
+
+	// Sequential reader: while the caller works on one chunk the next one is read into the other buffer on the job
+	// system. Reads are chained on the counters so the file is always read in order. Stored pack entries are sliced in
+	// place, deflated ones are read like files but inflate a block at a time.
+	struct sFileStream;
+
+	struct sFileStreamJob
+	{
+		sFileStream* stream{ nullptr };
+		u32 buffer{ 0 };
+	};
+
+	struct sFileStream
+	{
+		FILE* file{ nullptr };
+		sFileView view{};
+		size_type size{ 0 };
+		size_type chunk{ 0 };
+		size_type offset{ 0 };		// Into the view
+		const sFilePackEntry* entry{ nullptr }; // Deflated pack entry
+		char* block{ nullptr };
+		size_type blockSize{ 0 };
+		size_type blockRead{ 0 };
+		u32 blockNext{ 0 };
+		u64 packed{ 0 };			// Next block, from the start of the blob
+		char* buffers[2]{};
+		size_type filled[2]{};
+		sJobCounter counters[2]{};
+		sFileStreamJob jobs[2]{};
+		u32 next{ 0 };				// Buffer returned by the next read
+		bool held{ false };			// The reader still has the other buffer
+		bool script{ false };		// Closed when the scripts reload
+	};
+
+	struct sFileSave
+	{
+		string path{};
+		size_type pathHash{ 0 };
+		string data{};
+	};
+
+	struct sFileGlobal
+	{
+		list<sFileInfo> index{};
+		list<sFileInfo> manifest{};
+
+		// Manifest lookups by hash, indices into the manifest
+		hashmap<size_type, u32> byPath{};
+		hashmap<size_type, list<u32>> byName{};
+		hashmap<size_type, list<u32>> byExt{};
+		hashmap<size_type, u32> byDir{};
+		list<sFileDir> dirs{};
+
+		list<std::unique_ptr<char[]>> strings{};
+		hashmap<size_type, cstring> interned{};
+		size_type stringsUsed{ 0 };
+		size_type stringsCapacity{ 0 };
+
+		// Mapped for the whole run when present
+		sFileView pack{};
+		const sFilePackEntry* packEntries{ nullptr };
+		cstring packPaths{ nullptr };
+		u32 packCount{ 0 };
+
+		// Files are stat'ed as they are listed so the first poll already sees edits
+		bool watch{ false };
+
+		// Lookups and stores come from job threads
+		string cacheDir{};
+		std::atomic<u32> cacheHits{ 0 };
+		std::atomic<u32> cacheMisses{ 0 };
+		std::atomic<u32> cacheTemp{ 0 };
+		string bakedDir{};
+		std::atomic<u32> bakedWrites{ 0 };
+
+		// Write behind saves, one pending save per path and the newest data wins. Written saves keep their buffers for reuse.
+		std::thread saveThread{};
+		std::mutex saveMutex{};
+		std::condition_variable saveWake{};
+		std::condition_variable saveDone{};
+		list<sFileSave> saves{};
+		list<sFileSave> saveSpare{};
+		bool saveBusy{ false };
+		bool saveQuit{ false };
+
+		// Handles are the slot plus one
+		std::mutex streamMutex{};
+		list<sFileStream*> streams{};
+	};
+	static sFileGlobal g;
+
+	static u64 file_align(u64 offset)
+	{
+		return (offset + FILE_PACK_ALIGN - 1) & ~(FILE_PACK_ALIGN - 1);
+	}
+
+	static i64 file_write_time(cstring filepath)
+	{
+		std::error_code ec;
+		const auto time = fs::last_write_time(fs::path{ App::FilePath(filepath) }, ec);
+		return ec ? 0 : (i64)time.time_since_epoch().count();
+	}
+
+	// Written next to the target then renamed over it, a crash leaves either the old or the new file
+	static bool file_write(cstring filepath, cstring data, size_type size)
+	{
+		const string path = App::FilePath(filepath);
+		const string temp = path + ".tmp";
+		FILE* file = std::fopen(temp.c_str(), "wb");
+		if (file == nullptr)
+		{
+			LOGW("Failed to save file: %s", filepath);
+			return false;
+		}
+
+		std::fwrite(data, 1, size, file);
+		bool failed = std::fflush(file) != 0 || std::ferror(file) != 0;
+#ifdef _WIN32
+		failed |= _commit(_fileno(file)) != 0;
+#else
+		failed |= fsync(fileno(file)) != 0;
+#endif
+		std::fclose(file);
+
+		std::error_code ec;
+		if (!failed)
+			fs::rename(fs::path{ temp }, fs::path{ path }, ec);
+		if (failed || ec)
+		{
+			fs::remove(fs::path{ temp }, ec);
+			LOGW("Failed to save file: %s", filepath);
+			return false;
+		}
+
+		return true;
+	}
+
+	static u32 file_pack_blocks(const sFilePackEntry& entry)
+	{
+		return (u32)((entry.size + FILE_PACK_BLOCK - 1) / FILE_PACK_BLOCK);
+	}
+
+	// Inflates one block of a deflated entry, `packed` is where it starts in the blob and moves to the next one
+	static size_type file_pack_inflate(const sFilePackEntry& entry, u32 block, u64& packed, char* out)
+	{
+		const auto* sizes = reinterpret_cast<const u32*>(g.pack.data + entry.offset);
+		const size_type size = (size_type)std::min(FILE_PACK_BLOCK, entry.size - (u64)block * FILE_PACK_BLOCK);
+		if (packed + sizes[block] > entry.packedSize
+			|| stbi_zlib_decode_buffer(out, (int)size, g.pack.data + entry.offset + packed, (int)sizes[block]) != (int)size)
+		{
+			LOGW("Corrupt packed file: %s", g.packPaths + entry.path);
+			return 0;
+		}
+
+		packed += sizes[block];
+		return size;
+	}
+
+	static void file_stream_read(void* data)
+	{
+		const auto* job = static_cast<const sFileStreamJob*>(data);
+		auto& stream = *job->stream;
+		char* buffer = stream.buffers[job->buffer];
+		if (stream.file != nullptr)
+		{
+			stream.filled[job->buffer] = std::fread(buffer, 1, stream.chunk, stream.file);
+			return;
+		}
+
+		size_type filled = 0;
+		while (filled < stream.chunk)
+		{
+			if (stream.blockRead == stream.blockSize)
+			{
+				if (stream.blockNext == file_pack_blocks(*stream.entry))
+					break;
+
+				stream.blockRead = 0;
+				stream.blockSize = file_pack_inflate(*stream.entry, stream.blockNext++, stream.packed, stream.block);
+				if (stream.blockSize == 0)
+				{
+					stream.blockNext = file_pack_blocks(*stream.entry); // Corrupt, ends the stream
+					break;
+				}
+			}
+
+			const size_type size = std::min(stream.chunk - filled, stream.blockSize - stream.blockRead);
+			std::memcpy(buffer + filled, stream.block + stream.blockRead, size);
+			stream.blockRead += size;
+			filled += size;
+		}
+		stream.filled[job->buffer] = filled;
+	}
+
+	static sFileStream* file_stream(u32 handle)
+	{
+		std::lock_guard<std::mutex> lock(g.streamMutex);
+		return handle > 0 && handle <= g.streams.size() ? g.streams[handle - 1] : nullptr;
+	}
+
+	static void file_writer()
+	{
+		App::ProfThread("File Writer");
+
+		list<sFileSave> writing{};
+		std::unique_lock<std::mutex> lock(g.saveMutex);
+		for (;;)
+		{
+			g.saveWake.wait(lock, [] { return !g.saves.empty() || g.saveQuit; });
+			if (g.saves.empty())
+				break; // Quitting, everything queued is written
+
+			writing.swap(g.saves);
+			g.saveBusy = true;
+			lock.unlock();
+
+			for (const auto& save : writing)
+			{
+				PROFILE("FileWrite");
+				file_write(save.path.c_str(), save.data.data(), save.data.size());
+			}
+
+			lock.lock();
+			for (auto& save : writing)
+				g.saveSpare.emplace_back(std::move(save));
+			writing.clear();
+			g.saveBusy = false;
+			g.saveDone.notify_all();
+		}
+	}
+
+	// Reads the whole file into a zero terminated heap copy. Loose files are read rather than mapped: an editor
+	// truncating one while it is mapped would fault the reader on the pages past the new end.
+	static bool file_read(cstring path, sFileView& view)
+	{
+		FILE* file = std::fopen(path, "rb");
+		if (file == nullptr)
+			return false;
+
+		std::error_code ec;
+		const size_type size = (size_type)fs::file_size(fs::path{ path }, ec);
+		if (ec)
+		{
+			std::fclose(file);
+			return false;
+		}
+
+		char* copy = static_cast<char*>(App::MemAlloc(eMemTag::APP, size + 1));
+		const size_type read = std::fread(copy, 1, size, file);
+		std::fclose(file);
+
+		// Shorter when the file is rewritten while it is read, the next change check reads it again
+		copy[read] = '\0';
+		view.data = copy;
+		view.size = read;
+		view.copy = copy;
+		return true;
+	}
+
+	// Maps the whole file read only, the rest of the last page reads as zeros
+	static bool file_map(cstring path, sFileView& view)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(file, &size))
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		view.size = (size_type)size.QuadPart;
+		if (view.size > 0)
+		{
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+			if (mapping)
+				CloseHandle(mapping);
+
+			view.data = static_cast<cstring>(data);
+			view.mapped = data != nullptr;
+		}
+		CloseHandle(file);
+#else
+		const int file = open(path, O_RDONLY);
+		if (file < 0)
+			return false;
+
+		struct stat info{};
+		if (fstat(file, &info) != 0)
+		{
+			close(file);
+			return false;
+		}
+
+		view.size = (size_type)info.st_size;
+		if (view.size > 0)
+		{
+			void* data = mmap(nullptr, view.size, PROT_READ, MAP_PRIVATE, file, 0);
+			view.data = data != MAP_FAILED ? static_cast<cstring>(data) : nullptr;
+			view.mapped = data != MAP_FAILED;
+		}
+		close(file);
+#endif
+		return view.size == 0 || view.mapped;
+	}
+
+	static void file_unmap(sFileView& view)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(view.data);
+#else
+		munmap(const_cast<char*>(view.data), view.size);
+#endif
+		view.mapped = false;
+	}
+
+	static bool file_open_pack(cstring filepath)
+	{
+		sFileView pack{};
+		if (!file_map(App::FilePath(filepath), pack) || !pack.mapped)
+		{
+			LOGW("Asset pack not found, reading the Assets folder: %s", filepath);
+			return false;
+		}
+
+		const auto* header = reinterpret_cast<const sFilePackHeader*>(pack.data);
+		if (pack.size < sizeof(sFilePackHeader) || header->magic != FILE_PACK_MAGIC || header->version != FILE_PACK_VERSION
+			|| sizeof(sFilePackHeader) + (u64)header->count * sizeof(sFilePackEntry) > header->pathsOffset
+			|| header->pathsOffset + header->pathsSize > pack.size)
+		{
+			LOGW("Invalid asset pack: %s", filepath);
+			return false;
+		}
+
+		const auto* entries = reinterpret_cast<const sFilePackEntry*>(pack.data + sizeof(sFilePackHeader));
+		for (u32 i = 0; i < header->count; ++i)
+		{
+			// Blobs are followed by a zero, the paths are zero terminated
+			if (entries[i].offset + entries[i].packedSize >= pack.size || entries[i].path >= header->pathsSize
+				|| ((entries[i].flags & FILE_PACK_DEFLATE) != 0 && entries[i].packedSize < file_pack_blocks(entries[i]) * sizeof(u32)))
+			{
+				LOGW("Invalid asset pack entry %u: %s", i, filepath);
+				return false;
+			}
+		}
+
+		g.packEntries = entries;
+		g.packPaths = pack.data + header->pathsOffset;
+		g.packCount = header->count;
+		g.pack = std::move(pack);
+		return true;
+	}
+
+	static const sFilePackEntry* file_pack_find(size_type pathHash)
+	{
+		const auto* end = g.packEntries + g.packCount;
+		const auto* it = std::lower_bound(g.packEntries, end, (u64)pathHash, [](const sFilePackEntry& entry, u64 hash) { return entry.pathHash < hash; });
+		return it != end && it->pathHash == pathHash ? it : nullptr;
+	}
+
+	static sFileView file_pack_view(const sFilePackEntry& entry)
+	{
+		sFileView view{};
+		view.data = "";
+
+		cstring blob = g.pack.data + entry.offset;
+		if ((entry.flags & FILE_PACK_DEFLATE) == 0)
+		{
+			view.data = blob;
+			view.size = (size_type)entry.size;
+			return view;
+		}
+
+		char* copy = static_cast<char*>(App::MemAlloc(eMemTag::APP, (size_type)entry.size + 1));
+		u64 packed = file_pack_blocks(entry) * sizeof(u32);
+		for (u32 i = 0; i < file_pack_blocks(entry); ++i)
+		{
+			if (file_pack_inflate(entry, i, packed, copy + (size_type)i * FILE_PACK_BLOCK) == 0)
+			{
+				App::MemFree(copy);
+				return view;
+			}
+		}
+
+		copy[entry.size] = '\0';
+		view.data = copy;
+		view.size = (size_type)entry.size;
+		view.copy = copy;
+		return view;
+	}
+
+	static bool file_pack_deflate(const sFileInfo& info)
+	{
+		// Already compressed formats only lose time
+		static const size_type stored[] = { App::Hash("png"), App::Hash("jpg"), App::Hash("jpeg"), App::Hash("ogg"), App::Hash("mp3"), App::Hash("flac") };
+		return std::find(std::begin(stored), std::end(stored), info.extHash) == std::end(stored);
+	}
+
+	static string file_cache_path(size_type key)
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+		return App::FilePath(g.cacheDir.c_str()) + string(name);
+	}
+
+	static void file_cache_prune(size_type limit)
+	{
+		struct sCacheFile
+		{
+			fs::path path{};
+			fs::file_time_type time{};
+			u64 size{ 0 };
+		};
+
+		std::error_code ec;
+		list<sCacheFile> files{};
+		u64 total = 0;
+		for (const auto& entry : fs::directory_iterator(fs::path{ App::FilePath(g.cacheDir.c_str()) }, ec))
+		{
+			if (!entry.is_regular_file(ec))
+				continue;
+
+			sCacheFile file{};
+			file.path = entry.path();
+			file.time = entry.last_write_time(ec);
+			file.size = (u64)entry.file_size(ec);
+			total += file.size;
+			files.push_back(file);
+		}
+
+		if (total <= limit)
+			return;
+
+		// Least recently used first, hits refresh the write time, down to three quarters so it doesn't prune every run
+		std::sort(files.begin(), files.end(), [](const sCacheFile& a, const sCacheFile& b) { return a.time < b.time; });
+		size_type removed = 0;
+		for (const auto& file : files)
+		{
+			if (total <= limit - limit / 4)
+				break;
+			if (fs::remove(file.path, ec))
+			{
+				total -= file.size;
+				removed++;
+			}
+		}
+		LOGD("Pruned %zu asset cache files", removed);
+	}
+
+	static size_type file_baked_key(cstring filepath, cstring settings)
+	{
+		return App::Hash(filepath) ^ (App::Hash(settings) * 0x9E3779B97F4A7C15ull);
+	}
+
+	static string file_baked_path(size_type key)
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+		return App::FilePath(g.bakedDir.c_str()) + string(name);
+	}
+
+	// Missing sources (a pack without the folder) always match, the baked file is all there is
+	static bool file_baked_source_matches(cstring filepath, u64 sourceSize, i64 sourceTime)
+	{
+		std::error_code ec;
+		const u64 size = (u64)fs::file_size(fs::path{ App::FilePath(filepath) }, ec);
+		if (ec)
+			return true;
+		return sourceSize == size && sourceTime == file_write_time(filepath);
+	}
+
+	static bool file_baked_matches(cstring filepath, const sFileBakedTrailer& trailer, cstring depends)
+	{
+		if (!file_baked_source_matches(filepath, trailer.sourceSize, trailer.sourceTime))
+			return false;
+
+		cstring end = depends + trailer.dependsSize;
+		while (depends < end)
+		{
+			u64 size = 0;
+			i64 time = 0;
+			cstring path = depends + sizeof(size) + sizeof(time);
+			cstring zero = path < end ? static_cast<cstring>(std::memchr(path, '\0', end - path)) : nullptr;
+			if (zero == nullptr)
+				return false;
+
+			std::memcpy(&size, depends, sizeof(size));
+			std::memcpy(&time, depends + sizeof(size), sizeof(time));
+			if (!file_baked_source_matches(path, size, time))
+				return false;
+			depends = zero + 1;
+		}
+		return true;
+	}
+
+	static cstring file_last_slash(cstring path, size_type size)
+	{
+		for (cstring pos = path + size; pos > path; --pos)
+		{
+			if (pos[-1] == '/' || pos[-1] == '\\')
+				return pos - 1;
+		}
+		return nullptr;
+	}
+
+	// Main thread only, the same string is only ever stored once
+	static cstring file_intern(cstring str, size_type size, size_type hash)
+	{
+		const auto it = g.interned.find(hash);
+		if (it != g.interned.end() && std::strncmp(it->second, str, size) == 0 && it->second[size] == '\0')
+			return it->second;
+
+		if (g.stringsCapacity - g.stringsUsed < size + 1)
+		{
+			g.stringsCapacity = std::max(FILE_STRING_BLOCK, size + 1);
+			g.strings.emplace_back(new char[g.stringsCapacity]);
+			g.stringsUsed = 0;
+		}
+
+		char* copy = g.strings.back().get() + g.stringsUsed;
+		std::memcpy(copy, str, size);
+		copy[size] = '\0';
+		g.stringsUsed += size + 1;
+
+		if (it == g.interned.end()) // A colliding string is still copied, just not shared
+			g.interned.emplace(hash, copy);
+		return copy;
+	}
+
+	// Finds or adds the bucket of a directory, parents included
+	static u32 file_dir(cstring path, size_type size)
+	{
+		const size_type hash = App::Hash(path, size);
+		const auto it = g.byDir.find(hash);
+		if (it != g.byDir.end())
+			return it->second;
+
+		const u32 dir = (u32)g.dirs.size();
+		g.dirs.emplace_back();
+		g.dirs.back().path = file_intern(path, size, hash);
+		g.byDir.emplace(hash, dir);
+
+		cstring slash = file_last_slash(path, size);
+		if (slash != nullptr)
+		{
+			const u32 parent = file_dir(path, slash - path);
+			g.dirs[parent].subdirs.push_back(dir);
+		}
+		return dir;
+	}
+
+	static void file_add(cstring filepath)
+	{
+		const u32 file = (u32)g.manifest.size();
+		g.manifest.emplace_back(App::FileGetInfo(filepath));
+		auto& info = g.manifest.back();
+		if (g.watch && g.packEntries == nullptr)
+		{
+			// Seeded here so the first save that leaves the content as it was isn't reported as a change
+			info.writeTime = file_write_time(info.path);
+			const auto content = App::FileMap(info.path);
+			info.contentHash = App::Hash(content.data, content.size);
+		}
+
+		g.byPath.emplace(info.pathHash, file);
+		g.byName[info.nameHash].push_back(file);
+		g.byExt[info.extHash].push_back(file);
+
+		cstring slash = file_last_slash(info.path, std::strlen(info.path));
+		if (slash != nullptr)
+			g.dirs[file_dir(info.path, slash - info.path)].files.push_back(file);
+	}
+
+	static string file_manifest_path()
+	{
+		return App::FilePath(g.cacheDir.c_str()) + string("/manifest.bin");
+	}
+
+	static bool file_manifest_valid(const sFileView& view)
+	{
+		if (view.size < sizeof(sFileManifestHeader))
+			return false;
+
+		const auto* header = reinterpret_cast<const sFileManifestHeader*>(view.data);
+		if (header->magic != FILE_MANIFEST_MAGIC || header->version != FILE_MANIFEST_VERSION || header->stringsSize == 0
+			|| sizeof(sFileManifestHeader) + (u64)header->dirCount * sizeof(sFileManifestDir) + (u64)header->refCount * sizeof(u32) + header->stringsSize != view.size)
+			return false;
+
+		const auto* dirs = reinterpret_cast<const sFileManifestDir*>(header + 1);
+		const auto* refs = reinterpret_cast<const u32*>(dirs + header->dirCount);
+		cstring strings = reinterpret_cast<cstring>(refs + header->refCount);
+		if (strings[header->stringsSize - 1] != '\0')
+			return false;
+
+		for (u32 i = 0; i < header->dirCount; ++i)
+		{
+			if (dirs[i].path >= header->stringsSize || (u64)dirs[i].refs + dirs[i].fileCount + dirs[i].subdirCount > header->refCount)
+				return false;
+		}
+		for (u32 i = 0; i < header->refCount; ++i)
+		{
+			if (refs[i] >= header->stringsSize)
+				return false;
+		}
+		return true;
+	}
+
+	// Walks the Assets folder, a directory whose mtime matches the last scan reuses its listing. Returns how many were listed.
+	static u32 file_scan(const sFileView& last)
+	{
+		hashmap<size_type, const sFileManifestDir*> lastDirs{};
+		const u32* refs = nullptr;
+		cstring strings = nullptr;
+		if (file_manifest_valid(last))
+		{
+			const auto* header = reinterpret_cast<const sFileManifestHeader*>(last.data);
+			const auto* dirs = reinterpret_cast<const sFileManifestDir*>(header + 1);
+			refs = reinterpret_cast<const u32*>(dirs + header->dirCount);
+			strings = reinterpret_cast<cstring>(refs + header->refCount);
+			for (u32 i = 0; i < header->dirCount; ++i)
+				lastDirs.emplace(App::Hash(strings + dirs[i].path), dirs + i);
+		}
+
+		u32 listed = 0;
+		list<string> pending{ "Assets" };
+		while (!pending.empty())
+		{
+			const string dirpath = std::move(pending.back());
+			pending.pop_back();
+
+			// Removed since the last scan, its parent changed too and no longer lists it
+			const i64 writeTime = file_write_time(dirpath.c_str());
+			if (writeTime == 0)
+				continue;
+
+			g.dirs[file_dir(dirpath.c_str(), dirpath.size())].writeTime = writeTime;
+
+			const auto it = lastDirs.find(App::Hash(dirpath.c_str(), dirpath.size()));
+			if (it != lastDirs.end() && it->second->writeTime == writeTime)
+			{
+				const u32* ref = refs + it->second->refs;
+				for (u32 i = 0; i < it->second->fileCount; ++i)
+					file_add(strings + *ref++);
+				for (u32 i = 0; i < it->second->subdirCount; ++i)
+					pending.emplace_back(strings + *ref++);
+				continue;
+			}
+
+			listed++;
+			std::error_code ec;
+			for (fs::directory_iterator entry{ fs::path{ App::FilePath(dirpath.c_str()) }, ec }, end{}; !ec && entry != end; entry.increment(ec))
+			{
+				const string path = dirpath + "/" + entry->path().filename().generic_string();
+				if (entry->is_directory(ec))
+					pending.push_back(path);
+				else if (entry->is_regular_file(ec))
+					file_add(path.c_str());
+			}
+		}
+
+		return listed;
+	}
 
-namespace GASandbox
-{
-	struct sFileGlobal
+	static void file_write_manifest()
 	{
-		list<sFileInfo> index{};
-		list<sFileInfo> manifest{};
-	};
-	static sFileGlobal g;
+		sFileManifestHeader header{};
+		list<sFileManifestDir> dirs(g.dirs.size());
+		list<u32> refs{};
+		string strings{};
+
+		for (size_type i = 0; i < g.dirs.size(); ++i)
+		{
+			dirs[i].writeTime = g.dirs[i].writeTime;
+			dirs[i].path = (u32)strings.size();
+			strings.append(g.dirs[i].path, std::strlen(g.dirs[i].path) + 1);
+		}
+
+		for (size_type i = 0; i < g.dirs.size(); ++i)
+		{
+			dirs[i].refs = (u32)refs.size();
+			dirs[i].fileCount = (u32)g.dirs[i].files.size();
+			dirs[i].subdirCount = (u32)g.dirs[i].subdirs.size();
+			for (const u32 file : g.dirs[i].files)
+			{
+				refs.push_back((u32)strings.size());
+				strings.append(g.manifest[file].path, std::strlen(g.manifest[file].path) + 1);
+			}
+			for (const u32 subdir : g.dirs[i].subdirs)
+				refs.push_back(dirs[subdir].path);
+		}
+
+		header.dirCount = (u32)dirs.size();
+		header.refCount = (u32)refs.size();
+		header.stringsSize = (u32)strings.size();
+
+		const string path = file_manifest_path();
+		const string temp = path + ".tmp";
+		FILE* file = std::fopen(temp.c_str(), "wb");
+		if (file == nullptr)
+			return;
+
+		std::fwrite(&header, sizeof(header), 1, file);
+		std::fwrite(dirs.data(), sizeof(sFileManifestDir), dirs.size(), file);
+		std::fwrite(refs.data(), sizeof(u32), refs.size(), file);
+		std::fwrite(strings.data(), 1, strings.size(), file);
+		const bool failed = std::ferror(file) != 0;
+		std::fclose(file);
+
+		std::error_code ec;
+		if (!failed)
+			fs::rename(fs::path{ temp }, fs::path{ path }, ec);
+		if (failed || ec)
+			fs::remove(fs::path{ temp }, ec);
+	}
 
 	bool App::FileInitialize(const sAppConfig& config)
 	{
-		string indexSrc = FileLoad("Assets/index.txt");
-		std::istringstream stream(indexSrc);
-		string line;
+		PROFILE("FileInitialize");
+
+		g.watch = !config.headless && config.watchInterval > 0;
+		g.saveQuit = false;
+		g.saveThread = std::thread(file_writer);
 
-		while (std::getline(stream, line))
+		g.cacheDir = config.cache;
+		if (!g.cacheDir.empty())
 		{
-			if (!line.empty()) // Avoid empty lines
+			std::error_code ec;
+			fs::create_directories(fs::path{ FilePath(g.cacheDir.c_str()) }, ec);
+			if (ec)
 			{
-				g.index.push_back(FileGetInfo(line.c_str()));
+				LOGW("Asset cache disabled, failed to create: %s", g.cacheDir.c_str());
+				g.cacheDir.clear();
 			}
+			else
+				file_cache_prune(config.cacheLimit);
+		}
+
+		// Only read at runtime, the first baked output creates the folder
+		g.bakedDir = config.baked;
+
+		// A pack replaces the Assets folder, one open and no directory walk. Only read when asked for, a leftover
+		// pack would otherwise shadow edited loose files.
+		if (!config.pack.empty() && file_open_pack(config.pack.c_str()))
+		{
+			g.manifest.reserve(g.packCount);
+			for (u32 i = 0; i < g.packCount; ++i)
+				file_add(g.packPaths + g.packEntries[i].path);
+			LOGI("Reading %u assets from %s, hot reload is off", g.packCount, config.pack.c_str());
 		}
 
-		fs::path assetPath{ FilePath("Assets") };
-		for (const auto& entry : fs::recursive_directory_iterator(assetPath))
+		const auto indexSrc = FileMap("Assets/index.txt");
+		cstring end = indexSrc.data + indexSrc.size;
+		string line;
+		for (cstring pos = indexSrc.data; pos < end;)
 		{
-			if (fs::is_regular_file(entry))
+			cstring eol = static_cast<cstring>(std::memchr(pos, '\n', end - pos));
+			if (eol == nullptr)
+				eol = end;
+
+			line.assign(pos, eol - pos > 0 && eol[-1] == '\r' ? eol - 1 : eol);
+			if (!line.empty()) // Avoid empty lines
 			{
-				fs::path relativePath = fs::relative(entry.path(), assetPath);
-				auto path = "Assets/" + relativePath.generic_string();
-				g.manifest.emplace_back(FileGetInfo(path.c_str()));
+				g.index.push_back(FileGetInfo(line.c_str()));
 			}
+			pos = eol + 1;
 		}
 
+		if (g.packEntries != nullptr)
+			return true;
+
+		// Only directories are stat'ed unless watching, then files get their mtime as they are added
+		sFileView last{};
+		if (!g.cacheDir.empty())
+			file_map(file_manifest_path().c_str(), last);
+
+		const u32 listed = file_scan(last);
+		FileUnmap(last);
+		if (listed > 0 && !g.cacheDir.empty())
+			file_write_manifest();
+
+		LOGD("Found %zu assets, listed %u of %zu directories", g.manifest.size(), listed, g.dirs.size());
 		return true;
 	}
 
 	void App::FileShutdown()
 	{
+		// The writer drains the queue before it exits, later saves are written on the caller
+		{
+			std::lock_guard<std::mutex> lock(g.saveMutex);
+			g.saveQuit = true;
+		}
+		g.saveWake.notify_all();
+		if (g.saveThread.joinable())
+			g.saveThread.join();
+		g.saveThread = std::thread();
+		g.saveSpare.clear();
+
+		for (u32 i = 0; i < (u32)g.streams.size(); ++i)
+			FileStreamClose(i + 1);
+		g.streams.clear();
+
+		const u32 hits = g.cacheHits.exchange(0);
+		const u32 misses = g.cacheMisses.exchange(0);
+		if (hits + misses > 0)
+			LOGI("Asset cache: %u hits, %u misses (%.1f%% hit rate)", hits, misses, 100.0 * hits / (hits + misses));
+
+		g.index.clear();
+		g.manifest.clear();
+		g.byPath.clear();
+		g.byName.clear();
+		g.byExt.clear();
+		g.byDir.clear();
+		g.dirs.clear();
+
+		g.interned.clear();
+		g.strings.clear();
+		g.stringsUsed = 0;
+		g.stringsCapacity = 0;
+
+		FileUnmap(g.pack);
+		g.packEntries = nullptr;
+		g.packPaths = nullptr;
+		g.packCount = 0;
+	}
+
+	void App::FileReload()
+	{
+		// Streams opened by the last vm
+		for (u32 i = 0; i < (u32)g.streams.size(); ++i)
+		{
+			const auto* stream = file_stream(i + 1);
+			if (stream != nullptr && stream->script)
+				FileStreamClose(i + 1);
+		}
+
+		CodeBindMethod("app", "App", true, "fileSave(_,_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 3);
+				cstring text = CodeGetSlotString(vm, 2);
+				FileSave(CodeGetSlotString(vm, 1), text, std::strlen(text));
+			});
+
+		CodeBindMethod("app", "App", true, "fileStreamOpen(_,_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 3);
+				const u32 stream = FileStreamOpen(CodeGetSlotString(vm, 1), (size_type)CodeGetSlotDouble(vm, 2));
+				if (stream != 0)
+					file_stream(stream)->script = true;
+				CodeSetSlotUInt(vm, 0, stream);
+			});
+
+		CodeBindMethod("app", "App", true, "fileStreamRead(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 2);
+				cstring data = nullptr;
+				size_type size = 0;
+				if (FileStreamRead(CodeGetSlotUInt(vm, 1), data, size))
+					CodeSetSlotBytes(vm, 0, data, size);
+				else
+					CodeSetSlotNull(vm, 0);
+			});
+
+		CodeBindMethod("app", "App", true, "fileStreamSize(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 2);
+				CodeSetSlotDouble(vm, 0, (f64)FileStreamSize(CodeGetSlotUInt(vm, 1)));
+			});
+
+		CodeBindMethod("app", "App", true, "fileStreamClose(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 2);
+				FileStreamClose(CodeGetSlotUInt(vm, 1));
+			});
+	}
+
+	bool App::FilePack(cstring filepath)
+	{
+		PROFILE("FilePack");
+
+		list<const sFileInfo*> files{};
+		for (const auto& info : g.manifest)
+			files.push_back(&info);
+		std::sort(files.begin(), files.end(), [](const sFileInfo* a, const sFileInfo* b) { return a->pathHash < b->pathHash; });
+
+		sFilePackHeader header{};
+		header.count = (u32)files.size();
+
+		list<sFilePackEntry> entries(files.size());
+		string paths{};
+		for (size_type i = 0; i < files.size(); ++i)
+		{
+			if (i > 0 && files[i]->pathHash == files[i - 1]->pathHash)
+			{
+				LOGE("Asset path hash collision: %s and %s", files[i - 1]->path, files[i]->path);
+				return false;
+			}
+
+			entries[i].pathHash = files[i]->pathHash;
+			entries[i].path = (u32)paths.size();
+			paths.append(files[i]->path, std::strlen(files[i]->path) + 1);
+		}
+
+		header.pathsOffset = sizeof(sFilePackHeader) + entries.size() * sizeof(sFilePackEntry);
+		header.pathsSize = (u32)paths.size();
+		header.blobsOffset = file_align(header.pathsOffset + header.pathsSize);
+
+		FILE* file = std::fopen(filepath, "wb");
+		if (file == nullptr)
+		{
+			LOGE("Failed to create asset pack: %s", filepath);
+			return false;
+		}
+
+		// The directory is written last, once the blob offsets are known
+		static const char zeros[FILE_PACK_ALIGN]{};
+		std::fwrite(&header, sizeof(header), 1, file);
+		std::fwrite(entries.data(), sizeof(sFilePackEntry), entries.size(), file);
+		std::fwrite(paths.data(), 1, paths.size(), file);
+		std::fwrite(zeros, 1, (size_type)(header.blobsOffset - header.pathsOffset - header.pathsSize), file);
+
+		u64 offset = header.blobsOffset;
+		u64 total = 0;
+		string deflated{};
+		for (size_type i = 0; i < files.size(); ++i)
+		{
+			auto& entry = entries[i];
+			const auto content = FileMap(files[i]->path);
+			entry.offset = offset;
+			entry.size = content.size;
+			entry.packedSize = content.size;
+
+			cstring blob = content.data;
+			if (content.size >= 64 && file_pack_deflate(*files[i]))
+			{
+				// Block sizes first, then the blocks
+				const u32 blocks = file_pack_blocks(entry);
+				deflated.assign(blocks * sizeof(u32), '\0');
+				for (u32 b = 0; b < blocks && deflated.size() < content.size; ++b)
+				{
+					const size_type start = (size_type)b * FILE_PACK_BLOCK;
+					i32 blockSize = 0;
+					unsigned char* block = stbi_zlib_compress((unsigned char*)content.data + start, (i32)std::min<u64>(FILE_PACK_BLOCK, content.size - start), &blockSize, 8);
+					if (block == nullptr)
+					{
+						deflated.clear();
+						break;
+					}
+
+					reinterpret_cast<u32*>(&deflated[0])[b] = (u32)blockSize;
+					deflated.append(reinterpret_cast<cstring>(block), (size_type)blockSize);
+					std::free(block);
+				}
+
+				if (!deflated.empty() && deflated.size() < content.size - content.size / 8)
+				{
+					blob = deflated.data();
+					entry.packedSize = deflated.size();
+					entry.flags |= FILE_PACK_DEFLATE;
+				}
+			}
+
+			// At least one zero after every blob
+			const u64 next = file_align(offset + entry.packedSize + 1);
+			std::fwrite(blob, 1, (size_type)entry.packedSize, file);
+			std::fwrite(zeros, 1, (size_type)(next - offset - entry.packedSize), file);
+
+			total += entry.size;
+			offset = next;
+		}
+
+		std::fseek(file, sizeof(sFilePackHeader), SEEK_SET);
+		std::fwrite(entries.data(), sizeof(sFilePackEntry), entries.size(), file);
+
+		const bool failed = std::ferror(file) != 0;
+		std::fclose(file);
+		if (failed)
+		{
+			LOGE("Failed to write asset pack: %s", filepath);
+			return false;
+		}
+
+		LOGI("Packed %zu assets (%llu bytes) into %s (%llu bytes)", files.size(), (unsigned long long)total, filepath, (unsigned long long)offset);
+		return true;
 	}
 
 	const list<sFileInfo>& App::FileGetIndex()
@@ -57,29 +1136,80 @@ namespace GASandbox
 		return g.manifest;
 	}
 
+	const sFileInfo* App::FileFind(cstring filepath)
+	{
+		const auto it = g.byPath.find(Hash(filepath));
+		return it != g.byPath.end() ? &g.manifest[it->second] : nullptr;
+	}
+
+	const list<u32>& App::FileFindByName(cstring name)
+	{
+		static const list<u32> none{};
+		const auto it = g.byName.find(Hash(name));
+		return it != g.byName.end() ? it->second : none;
+	}
+
+	const list<u32>& App::FileFindByExt(cstring ext)
+	{
+		static const list<u32> none{};
+		const auto it = g.byExt.find(Hash(ext));
+		return it != g.byExt.end() ? it->second : none;
+	}
+
+	const list<u32>& App::FileFindInDir(cstring dirpath)
+	{
+		static const list<u32> none{};
+		const auto it = g.byDir.find(Hash(dirpath));
+		return it != g.byDir.end() ? g.dirs[it->second].files : none;
+	}
+
+	void App::FilePollChanges(list<sFileInfo>& changed)
+	{
+		PROFILE("FilePollChanges");
+
+		changed.clear();
+		if (g.packEntries != nullptr)
+			return; // Packs don't change under a running app
+
+		// Cheap mtime check first, editors often touch files without changing them so the content decides. Every poll
+		// still stats every listed file, the cost grows with the Assets folder and not with what was edited.
+		for (auto& info : g.manifest)
+		{
+			const i64 writeTime = file_write_time(info.path);
+			if (writeTime == info.writeTime)
+				continue;
+
+			info.writeTime = writeTime;
+			const auto content = FileMap(info.path);
+			const size_type contentHash = Hash(content.data, content.size);
+			if (contentHash == info.contentHash)
+				continue;
+
+			info.contentHash = contentHash;
+			changed.push_back(info);
+		}
+	}
+
 	sFileInfo App::FileGetInfo(cstring filepath)
 	{
 		sFileInfo info;
-		info.path = filepath;
+		const size_type size = std::strlen(filepath);
 
-		// Find last '/' or '\' (for both Windows and Unix-style paths)
-		size_type lastSlash = info.path.find_last_of("/\\");
-		size_type lastDot = info.path.find_last_of('.');
+		// Find last '/' or '\' (for both Windows and Unix-style paths), then the last '.' of the file name
+		cstring lastSlash = file_last_slash(filepath, size);
+		cstring name = lastSlash != nullptr ? lastSlash + 1 : filepath;
+		cstring ext = std::strrchr(name, '.');
+		const size_type nameSize = ext != nullptr ? ext - name : filepath + size - name;
+		const size_type extSize = ext != nullptr ? filepath + size - ext - 1 : 0;
 
-		// Extract filename and extension
-		if (lastSlash != string::npos)
-			info.name = info.path.substr(lastSlash + 1, (lastDot != string::npos ? lastDot - lastSlash - 1 : string::npos));
-		else
-			info.name = info.path.substr(0, lastDot); // No folder, just the name
-
-		if (lastDot != string::npos && lastDot > lastSlash)
-			info.ext = info.path.substr(lastDot + 1);
+		// Hash values, the strings are interned so lookups don't allocate
+		info.pathHash = Hash(filepath, size);
+		info.nameHash = Hash(name, nameSize);
+		info.extHash = Hash(ext != nullptr ? ext + 1 : "", extSize);
 
-		// Hash values
-		static std::hash<string> g_hash;
-		info.pathHash = g_hash(info.path);
-		info.nameHash = g_hash(info.name);
-		info.extHash = g_hash(info.ext);
+		info.path = file_intern(filepath, size, info.pathHash);
+		info.name = file_intern(name, nameSize, info.nameHash);
+		info.ext = file_intern(ext != nullptr ? ext + 1 : "", extSize, info.extHash);
 
 		return info;
 	}
@@ -95,34 +1225,421 @@ namespace GASandbox
 #endif
 	}
 
-	string App::FileLoad(cstring filepath)
+	sFileView App::FileMap(cstring filepath)
 	{
-		cstring path = FilePath(filepath);
-		std::ifstream file(path);
-		if (!file.is_open())
+		PROFILE("FileMap");
+
+		if (g.packEntries != nullptr)
+		{
+			const auto* entry = file_pack_find(Hash(filepath));
+			if (entry != nullptr)
+				return file_pack_view(*entry);
+		}
+
+		sFileView view{};
+		if (!file_read(FilePath(filepath), view))
 		{
 			LOGW("Failed to open file: %s", filepath);
-			return "";
+			view.data = "";
+			view.size = 0;
+			return view;
 		}
 
-		std::stringstream buffer;
-		buffer << file.rdbuf();
-		file.close();
+		return view;
+	}
+
+	void App::FileUnmap(sFileView& view)
+	{
+		if (view.mapped)
+			file_unmap(view);
+		else if (view.copy)
+			MemFree(view.copy);
 
-		return buffer.str();
+		view.data = nullptr;
+		view.size = 0;
+		view.mapped = false;
+		view.copy = nullptr;
 	}
 
-	void App::FileSave(cstring filepath, const string& src)
+	size_type App::FileCacheKey(const sFileView& content, cstring settings)
+	{
+		// The settings name the import options and the loader's format version, changing either misses
+		return Hash(content.data, content.size) ^ (Hash(settings) * 0x9E3779B97F4A7C15ull);
+	}
+
+	sFileView App::FileCacheLoad(size_type key)
 	{
-		cstring path = FilePath(filepath);
-		std::ofstream file(path);
-		if (!file.is_open())
+		PROFILE("FileCacheLoad");
+
+		sFileView view{};
+		view.data = "";
+		if (g.cacheDir.empty())
+			return view;
+
+		const string path = file_cache_path(key);
+		sFileView blob{};
+		if (file_map(path.c_str(), blob) && blob.mapped && blob.size >= sizeof(sFileCacheTrailer))
 		{
-			LOGW("Failed to save file: %s", filepath);
+			sFileCacheTrailer trailer{};
+			std::memcpy(&trailer, blob.data + blob.size - sizeof(trailer), sizeof(trailer));
+			if (trailer.magic == FILE_CACHE_MAGIC && trailer.version == FILE_CACHE_VERSION && trailer.key == key
+				&& trailer.size == blob.size - sizeof(trailer))
+			{
+				std::error_code ec;
+				fs::last_write_time(fs::path{ path }, fs::file_time_type::clock::now(), ec);
+				g.cacheHits.fetch_add(1, std::memory_order_relaxed);
+				return blob;
+			}
+		}
+
+		g.cacheMisses.fetch_add(1, std::memory_order_relaxed);
+		return view;
+	}
+
+	void App::FileCacheStore(size_type key, const void* data, size_type size)
+	{
+		PROFILE("FileCacheStore");
+
+		if (g.cacheDir.empty())
+			return;
+
+		// Written aside and renamed over, readers never see half a blob
+		const string path = file_cache_path(key);
+		const string temp = path + "." + std::to_string(g.cacheTemp.fetch_add(1, std::memory_order_relaxed)) + ".tmp";
+		FILE* file = std::fopen(temp.c_str(), "wb");
+		if (file == nullptr)
 			return;
+
+		sFileCacheTrailer trailer{};
+		trailer.key = key;
+		trailer.size = size;
+		std::fwrite(data, 1, size, file);
+		std::fwrite(&trailer, sizeof(trailer), 1, file);
+		const bool failed = std::ferror(file) != 0;
+		std::fclose(file);
+
+		std::error_code ec;
+		if (!failed)
+			fs::rename(fs::path{ temp }, fs::path{ path }, ec);
+		if (failed || ec)
+			fs::remove(fs::path{ temp }, ec);
+	}
+
+	void App::FileCacheReject(size_type key)
+	{
+		// Overwritten by the loader's next store
+		g.cacheHits.fetch_sub(1, std::memory_order_relaxed);
+		g.cacheMisses.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	sFileView App::FileBakedLoad(cstring filepath, cstring settings)
+	{
+		PROFILE("FileBakedLoad");
+
+		sFileView view{};
+		view.data = "";
+		if (g.bakedDir.empty())
+			return view;
+
+		const size_type key = file_baked_key(filepath, settings);
+		sFileView blob{};
+		if (file_map(file_baked_path(key).c_str(), blob) && blob.mapped && blob.size >= sizeof(sFileBakedTrailer))
+		{
+			sFileBakedTrailer trailer{};
+			std::memcpy(&trailer, blob.data + blob.size - sizeof(trailer), sizeof(trailer));
+			if (trailer.magic == FILE_BAKED_MAGIC && trailer.version == FILE_BAKED_VERSION && trailer.key == key
+				&& trailer.size <= blob.size - sizeof(trailer) && trailer.dependsSize == blob.size - sizeof(trailer) - trailer.size
+				&& file_baked_matches(filepath, trailer, blob.data + trailer.size))
+				return blob;
+		}
+
+		return view;
+	}
+
+	bool App::FileBakedFresh(cstring filepath, cstring settings)
+	{
+		if (g.bakedDir.empty())
+			return false;
+
+		// Only the trailer and the dependencies are read, the bake skips fresh outputs without mapping them
+		const size_type key = file_baked_key(filepath, settings);
+		FILE* file = std::fopen(file_baked_path(key).c_str(), "rb");
+		if (file == nullptr)
+			return false;
+
+		sFileBakedTrailer trailer{};
+		string depends{};
+		bool read = std::fseek(file, -(long)sizeof(trailer), SEEK_END) == 0 && std::fread(&trailer, sizeof(trailer), 1, file) == 1
+			&& trailer.magic == FILE_BAKED_MAGIC && trailer.version == FILE_BAKED_VERSION && trailer.key == key
+			&& trailer.dependsSize + sizeof(trailer) <= (u64)std::ftell(file);
+		if (read && trailer.dependsSize > 0)
+		{
+			depends.resize((size_type)trailer.dependsSize);
+			read = std::fseek(file, -(long)(sizeof(trailer) + trailer.dependsSize), SEEK_END) == 0
+				&& std::fread(&depends[0], 1, depends.size(), file) == depends.size();
+		}
+		std::fclose(file);
+		return read && file_baked_matches(filepath, trailer, depends.data());
+	}
+
+	bool App::FileBakedStore(cstring filepath, cstring settings, const void* data, size_type size, const list<string>& depends)
+	{
+		PROFILE("FileBakedStore");
+
+		if (g.bakedDir.empty())
+			return false;
+
+		std::error_code ec;
+		const u64 sourceSize = (u64)fs::file_size(fs::path{ FilePath(filepath) }, ec);
+		if (ec)
+		{
+			LOGW("Failed to bake, missing source: %s", filepath);
+			return false;
+		}
+
+		string records{};
+		for (const auto& depend : depends)
+		{
+			const u64 dependSize = (u64)fs::file_size(fs::path{ FilePath(depend.c_str()) }, ec);
+			if (ec)
+			{
+				LOGW("Failed to bake %s, missing dependency: %s", filepath, depend.c_str());
+				return false;
+			}
+
+			const i64 dependTime = file_write_time(depend.c_str());
+			records.append(reinterpret_cast<cstring>(&dependSize), sizeof(dependSize));
+			records.append(reinterpret_cast<cstring>(&dependTime), sizeof(dependTime));
+			records.append(depend.c_str(), depend.size() + 1);
+		}
+
+		const size_type key = file_baked_key(filepath, settings);
+		const string path = file_baked_path(key);
+		const string temp = path + "." + std::to_string(g.cacheTemp.fetch_add(1, std::memory_order_relaxed)) + ".tmp";
+		FILE* file = std::fopen(temp.c_str(), "wb");
+		if (file == nullptr)
+		{
+			// First output of the bake
+			fs::create_directories(fs::path{ FilePath(g.bakedDir.c_str()) }, ec);
+			file = std::fopen(temp.c_str(), "wb");
+		}
+		if (file == nullptr)
+		{
+			LOGW("Failed to write baked file: %s", path.c_str());
+			return false;
+		}
+
+		sFileBakedTrailer trailer{};
+		trailer.key = key;
+		trailer.size = size;
+		trailer.sourceSize = sourceSize;
+		trailer.sourceTime = file_write_time(filepath);
+		trailer.dependsSize = records.size();
+		std::fwrite(data, 1, size, file);
+		std::fwrite(records.data(), 1, records.size(), file);
+		std::fwrite(&trailer, sizeof(trailer), 1, file);
+		const bool failed = std::ferror(file) != 0;
+		std::fclose(file);
+
+		if (!failed)
+			fs::rename(fs::path{ temp }, fs::path{ path }, ec);
+		if (failed || ec)
+		{
+			fs::remove(fs::path{ temp }, ec);
+			LOGW("Failed to write baked file: %s", path.c_str());
+			return false;
+		}
+
+		g.bakedWrites.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	u32 App::FileBakedWrites()
+	{
+		return g.bakedWrites.load(std::memory_order_relaxed);
+	}
+
+	u32 App::FileCacheHits()
+	{
+		return g.cacheHits.load(std::memory_order_relaxed);
+	}
+
+	u32 App::FileCacheMisses()
+	{
+		return g.cacheMisses.load(std::memory_order_relaxed);
+	}
+
+	string App::FileLoad(cstring filepath)
+	{
+		const auto view = FileMap(filepath);
+		return view.str();
+	}
+
+	void App::FileSave(cstring filepath, const string& src)
+	{
+		FileSave(filepath, src.data(), src.size());
+	}
+
+	void App::FileSave(cstring filepath, cstring data, size_type size)
+	{
+		PROFILE("FileSave");
+
+		const size_type pathHash = Hash(filepath);
+		{
+			std::lock_guard<std::mutex> lock(g.saveMutex);
+			if (g.saveThread.joinable())
+			{
+				// Coalesced with a save of the same path still waiting, only the copy is paid here
+				auto it = std::find_if(g.saves.begin(), g.saves.end(), [pathHash](const sFileSave& save) { return save.pathHash == pathHash; });
+				if (it == g.saves.end())
+				{
+					if (g.saveSpare.empty())
+						g.saves.emplace_back();
+					else
+					{
+						g.saves.emplace_back(std::move(g.saveSpare.back()));
+						g.saveSpare.pop_back();
+					}
+
+					it = g.saves.end() - 1;
+					it->path.assign(filepath);
+					it->pathHash = pathHash;
+				}
+
+				it->data.assign(data, size);
+				g.saveWake.notify_one();
+				return;
+			}
+		}
+
+		file_write(filepath, data, size);
+	}
+
+	void App::FileFlush()
+	{
+		PROFILE("FileFlush");
+
+		std::unique_lock<std::mutex> lock(g.saveMutex);
+		g.saveDone.wait(lock, [] { return g.saves.empty() && !g.saveBusy; });
+	}
+
+	u32 App::FileStreamOpen(cstring filepath, size_type chunkSize)
+	{
+		PROFILE("FileStreamOpen");
+
+		auto* stream = new sFileStream();
+		stream->chunk = chunkSize > 0 ? chunkSize : 1 << 20;
+
+		const auto* entry = g.packEntries != nullptr ? file_pack_find(Hash(filepath)) : nullptr;
+		if (entry != nullptr && (entry->flags & FILE_PACK_DEFLATE) == 0)
+		{
+			stream->view = file_pack_view(*entry);
+			stream->size = stream->view.size;
+		}
+		else
+		{
+			if (entry != nullptr)
+			{
+				stream->entry = entry;
+				stream->size = (size_type)entry->size;
+				stream->packed = file_pack_blocks(*entry) * sizeof(u32);
+				stream->block = static_cast<char*>(MemAlloc(eMemTag::APP, (size_type)FILE_PACK_BLOCK));
+			}
+			else
+			{
+				stream->file = std::fopen(FilePath(filepath), "rb");
+				if (stream->file == nullptr)
+				{
+					LOGW("Failed to open file: %s", filepath);
+					delete stream;
+					return 0;
+				}
+
+				std::error_code ec;
+				stream->size = (size_type)fs::file_size(fs::path{ FilePath(filepath) }, ec);
+			}
+
+			// Both buffers start filling right away, the second after the first
+			for (u32 i = 0; i < 2; ++i)
+			{
+				stream->buffers[i] = static_cast<char*>(MemAlloc(eMemTag::APP, stream->chunk));
+				stream->jobs[i].stream = stream;
+				stream->jobs[i].buffer = i;
+				JobSubmit(file_stream_read, &stream->jobs[i], &stream->counters[i], i > 0 ? &stream->counters[i - 1] : nullptr);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(g.streamMutex);
+		auto it = std::find(g.streams.begin(), g.streams.end(), nullptr);
+		if (it == g.streams.end())
+			it = g.streams.insert(it, nullptr);
+		*it = stream;
+		return (u32)(it - g.streams.begin()) + 1;
+	}
+
+	bool App::FileStreamRead(u32 handle, cstring& data, size_type& size)
+	{
+		PROFILE("FileStreamRead");
+
+		data = nullptr;
+		size = 0;
+		auto* stream = file_stream(handle);
+		if (stream == nullptr)
+			return false;
+
+		if (stream->buffers[0] == nullptr)
+		{
+			size = std::min(stream->chunk, stream->view.size - stream->offset);
+			data = stream->view.data + stream->offset;
+			stream->offset += size;
+			return size > 0;
 		}
 
-		file << src;
-		file.close();
+		// The reader is done with the other buffer, it refills once the chunk in flight is read
+		const u32 current = stream->next;
+		const u32 other = current ^ 1;
+		if (stream->held)
+			JobSubmit(file_stream_read, &stream->jobs[other], &stream->counters[other], &stream->counters[current]);
+
+		JobWait(stream->counters[current]);
+		stream->held = true;
+		stream->next = other;
+
+		data = stream->buffers[current];
+		size = stream->filled[current];
+		return size > 0;
+	}
+
+	size_type App::FileStreamSize(u32 handle)
+	{
+		const auto* stream = file_stream(handle);
+		return stream != nullptr ? stream->size : 0;
+	}
+
+	void App::FileStreamClose(u32 handle)
+	{
+		sFileStream* stream = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(g.streamMutex);
+			if (handle == 0 || handle > g.streams.size())
+				return;
+
+			std::swap(stream, g.streams[handle - 1]);
+		}
+
+		if (stream == nullptr)
+			return;
+
+		if (stream->buffers[0] != nullptr)
+		{
+			JobWait(stream->counters[0]);
+			JobWait(stream->counters[1]);
+			if (stream->file != nullptr)
+				std::fclose(stream->file);
+			MemFree(stream->buffers[0]);
+			MemFree(stream->buffers[1]);
+			MemFree(stream->block);
+		}
+		delete stream;
 	}
 }
\ No newline at end of file
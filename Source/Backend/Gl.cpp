@@ -1,24 +1,35 @@
 #include <App.hpp>
+#include "GlRing.hpp"
 
 #include <glad/glad.h>
 #include <backends/imgui_impl_opengl3.h>
 
+// Decoded images count as graphics memory
+#define STBI_MALLOC(size) GASandbox::App::MemAlloc(GASandbox::eMemTag::GRAPHICS, size)
+#define STBI_REALLOC(ptr, size) GASandbox::App::MemRealloc(GASandbox::eMemTag::GRAPHICS, ptr, size)
+#define STBI_FREE(ptr) GASandbox::App::MemFree(ptr)
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 #define CGLTF_IMPLEMENTATION
 #include <cgltf.h>
 
-#include <sstream>
 #include <cstring>
 #include <stdexcept>
+#include <algorithm>
+#include <initializer_list>
+#include <thread>
 
 namespace GASandbox
 {
+	struct sGlImageLoad;
+
 	struct sGlImage
 	{
 		i32 w{ 0 }, h{ 0 }, c{ 0 };
 		u8* data{ nullptr };
+		u32 levels{ 1 };	// Baked images carry their mip chain after the first level, each half the size down to 1x1
+		sGlImageLoad* load{ nullptr }; // Decode still owned by a job
 
 		sGlImage() = default;
 		sGlImage(i32 w, i32 h, i32 c, u8* data)
@@ -26,6 +37,33 @@ namespace GASandbox
 		{}
 	};
 
+	// Decoded image in the asset cache and the baked folder, the texels of every level follow
+	struct sGlImageBlob
+	{
+		i32 w{ 0 }, h{ 0 }, c{ 0 };
+		u32 levels{ 0 };	// 0 in the cache, which only stores the first level
+	};
+
+	// Images decode on the job system, the handle is joined the first time the image is used
+	struct sGlImageLoad
+	{
+		string path{};
+		bool flipY{ false };
+		sGlImage image{};
+		sJobCounter counter{};
+	};
+
+	// Texture named up front and sampled as incomplete (black) until its image has decoded and been uploaded
+	struct sGlUpload
+	{
+		GLuint texture{ 0 };
+		u32 image{ 0 };
+		eGlTextureFormat format{ eGlTextureFormat::RGBA8 };
+		bool genMipmaps{ false };
+	};
+
+	struct sGlModelLoad;
+
 	struct sGlAnim
 	{
 		string name{};
@@ -44,10 +82,16 @@ namespace GASandbox
 		COUNT
 	};
 
+	constexpr u32 GL_MESH_ATTR_SIZE[(u32)sGlMeshAttr::COUNT] = { 3, 3, 2, 4, 4 }; // Floats per element
+
+	// Ranges into the model data. Extracted meshes store each attribute packed, baked ones interleave them: the range
+	// starts at the first vertex's element and the next vertex is stride floats further.
 	struct sGlMesh
 	{
 		u64 attributes[(u32)sGlMeshAttr::COUNT]{ 0 };
 		u64 indices{ 0 };
+		u32 stride{ 0 };	// Floats per vertex, 0 when packed
+		u32 reserved{ 0 };
 	};
 
 	struct sGlNode
@@ -74,30 +118,252 @@ namespace GASandbox
 			: pos(pos), col(col), idx(idx), v(v)
 		{}
 	};
+	static_assert(sizeof(sGlVertex) == 16 * sizeof(u32), "The full vertex format expects the 16 glAddVertex fields packed");
+
+	// A vertex format registered once, batches pick one at GlBegin and are streamed and drawn with its layout.
+	// Attributes cover whole 32 bit words so scripts fill a vertex one number per word, a float or packed integers.
+	constexpr u32 GL_FORMAT_MAX_WORDS = 32;
+
+	struct sGlVertexFormat
+	{
+		list<sGlVertexAttrib> attribs{};
+		size_type hash{ 0 };
+		u32 stride{ 0 };	// Bytes, a multiple of 4
+		u32 floats{ 0 };	// Mask of the words holding a float
+		GLuint vao{ 0 };	// Created on the first draw, reads the vertex ring
+	};
+
+	// Vertices owned by a script `VertexData` object, the object only holds a pointer to them
+	struct sGlVertexData
+	{
+		tagged_list<u8, eMemTag::GRAPHICS> bytes{};
+		u32 format{ (u32)eGlVertexFormat::FULL };
+	};
+
+	// Pipelined frames: the simulation thread records the draw stream and the gui draw data into a packet,
+	// the render thread replays it one frame later. Packets are double buffered and never touched by both at once.
+	// Serial frames record into the first packet and submit it at the end of the same frame.
+	enum struct eGlCmd : u32
+	{
+		VIEWPORT, SCISSOR, CLEAR, SHADER, BEGIN, END, UNIFORM, TEX2D,
+		FLOAT, VEC2, VEC3, VEC4,
+		MAT2X2, MAT2X3, MAT2X4, MAT3X2, MAT3X3, MAT3X4, MAT4X2, MAT4X3, MAT4X4,
+		DESTROY_SHADER, DESTROY_TEXTURE
+	};
+
+	struct sGlCmd
+	{
+		eGlCmd type{ eGlCmd::VIEWPORT };
+		u32 u[4]{};
+		f64 d{ 0 };
+		f32 f[16]{};
+	};
+
+	struct sGlPacket
+	{
+		list<sGlCmd> cmds{};
+		tagged_list<u8, eMemTag::GRAPHICS> vertices{}; // Each batch packed in its own format
+		string names{}; // Uniform names, zero separated
+		u32 begin{ 0 }; // First vertex byte of the current GlBegin
+		u32 format{ (u32)eGlVertexFormat::FULL }; // Of the current GlBegin
+		bool sort{ false }; // Scene opted in to reordering opaque batches
+
+		ImDrawData gui{};
+		list<ImDrawList*> guiLists{}; // Kept across frames, their buffers only grow
+	};
+
+	// Every frame is recorded into a packet, serial frames too. At submit adjacent batches with the same state are
+	// drawn as one and state is only set when it changes. Batches keep script order unless the scene opts in with
+	// App.glSetSortDraws(true): then runs of opaque depth tested batches between two barriers (clear, viewport, scissor,
+	// texture and uniform commands) are sorted by key first. Coplanar batches (2D at z=0) would resolve differently under
+	// GL_LESS once reordered, so sorting is only safe for scenes whose opaque batches never overlap at equal depth.
+	struct sGlDrawState
+	{
+		u32 shader{ 0 };
+		u32 mode{ 0 };
+		f32 pointSize{ 1 };
+		f32 lineWidth{ 1 };
+		u8 alpha{ 0 };
+		u8 ztest{ 0 };
+		u32 format{ (u32)eGlVertexFormat::FULL }; // Bound with the draw, not part of the applied state
+	};
+
+	struct sGlDraw
+	{
+		u64 key{ 0 };		// Run, shader, blend, depth, topology, format, sizes from the high bits down
+		u32 cmd{ 0 };		// END of the first batch, the command itself for a barrier
+		u32 batches{ 0 };	// Batches drawn as one, 0 for a barrier
+		u32 first{ 0 };		// Byte into the packet vertices or the merge scratch, the uniform handle of a barrier
+		u32 count{ 0 };		// Vertices
+		bool gathered{ false };	// Merged batches that weren't contiguous, copied to the merge scratch
+		bool bind{ false };		// Barrier setting a plain uniform, its program is bound first
+		sGlDrawState state{};
+	};
+
+	struct sGlDrawStats
+	{
+		u64 frames{ 0 };
+		u64 commands{ 0 };
+		u64 batches{ 0 };		// GlBegin/GlEnd pairs recorded
+		u64 draws{ 0 };			// Left after merging
+		u64 stateChanges{ 0 };	// Shader, blend, depth, point size and line width changes applied
+	};
+
+	// A ring's buffer and fences, its bookkeeping is in GlRing.hpp. Vertices and uniform block snapshots each get one.
+	struct sGlRing : sGlRingHead
+	{
+		GLenum target{ GL_ARRAY_BUFFER };
+		GLuint buffer{ 0 };
+		u8* data{ nullptr };	// Mapped for the whole run with buffer storage, otherwise each write maps its range
+		GLsync fences[GL_RING_SEGMENTS]{};
+		u32 stalls{ 0 };		// Waits that found the GPU still reading
+	};
+
+	struct sGlShaderFile
+	{
+		GLuint program{ 0 };
+		string path{};
+		list<size_type> files{}; // Path hashes of the shader file and everything it includes
+	};
+
+	struct sGlShaderInclude
+	{
+		size_type offset{ 0 };	// Into the text of the including unit
+		size_type pathHash{ 0 };
+		string path{};
+	};
+
+	// A shader file parsed once: its text without the #include lines and where each include goes. Units are cached
+	// until their file changes, a program expands them again from the cache.
+	struct sGlShaderUnit
+	{
+		string text{};
+		list<sGlShaderInclude> includes{};
+		bool found{ true };
+		bool balanced{ true };	// Every #if has its #endif
+	};
+
+	// One expansion: a unit is emitted once per program, the first include wins
+	struct sGlShaderSource
+	{
+		string text{};
+		list<size_type> files{};	// Path hashes of the shader file and everything it includes, in order
+		list<size_type> stack{};	// Units being expanded, to report cycles
+		bool valid{ true };
+	};
+
+	// Active uniforms of every program, reflected once per link. Handles index this table and survive relinks of
+	// their program, the last value sent is kept so setting it again costs nothing.
+	struct sGlUniform
+	{
+		GLuint program{ 0 };
+		GLint location{ -1 };	// -1 inside a block or when no longer active
+		u32 block{ 0 };			// Shared block holding it, 0 for a plain uniform
+		u32 offset{ 0 };		// Into the block data
+		u32 matrixStride{ 0 };
+		bool rowMajor{ false };
+		bool set{ false };		// The driver holds the value below
+		eGlCmd type{ eGlCmd::FLOAT };
+		f32 value[16]{};
+	};
+
+	// Uniform blocks are shared by name and size: every program declaring one reads the same binding, a member set
+	// through any of them is written here and the block is copied to the block ring once before the next draw.
+	struct sGlBlock
+	{
+		size_type nameHash{ 0 };
+		u32 size{ 0 };
+		u32 offset{ 0 };	// Of the last snapshot, into the upload it was part of
+		tagged_list<u8, eMemTag::GRAPHICS> data{};	// What the next draw reads
+		tagged_list<u8, eMemTag::GRAPHICS> plan{};	// Stepped through while a packet is planned
+		bool dirty{ false };
+	};
 
 	struct sGlGlobal
 	{
+		bool context{ false }; // False when headless, every driver call is skipped
 		GLuint shader{ 0 };
-		GLuint vao{ 0 };
-		GLuint vbo{ 0 };
+		sGlRing ring{};
+
+		list<sGlVertexFormat> formats{};			// Never released, equal descriptors share a handle
+		hashmap<size_type, u32> formatHandles{};
+		u32 format{ (u32)eGlVertexFormat::FULL };	// Of the immediate batch
+		bool sortDraws{ false };	// Set by the recording thread, copied into every packet it begins
+
+		u32 uniform{ 0 };	// Selected outside recorded frames
 
-		cstring uniformName{ nullptr };
+		list<sGlUniform> uniforms{};
+		hashmap<size_type, u32> uniformHandles{};	// Program and name hash to handle
+		list<sGlBlock> blocks{};
+		bool blocksDirty{ false };
+		sGlRing blockRing{};	// Snapshots of the blocks, bound by range
+		u32 blockAlign{ 256 };	// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+		tagged_list<u8, eMemTag::GRAPHICS> blockUpload{};	// The snapshots of one upload, written to the ring at once
 
 		list<GLuint> shaders{};
+		list<sGlShaderFile> shaderFiles{};
+		hashmap<size_type, sGlShaderUnit> shaderUnits{};
 		list<sGlImage> images{};
-		list<f32> g_modelData{}; // Float buffer for all model data
+		tagged_list<f32, eMemTag::GRAPHICS> g_modelData{}; // Float buffer for all model data
 		list<sGlMesh> g_meshes{};
 		list<sGlAnim> g_anims{};
 		list<sGlNode> g_nodes{};
 		list<u32> g_models{};
 		list<GLuint> textures{};
-		list<sGlVertex> vertices{};
+		list<u8> texturesUploaded{};	// Indexed by texture name, set once its pixels are in
+		tagged_list<u8, eMemTag::GRAPHICS> vertices{};
+
+		// Async loads finished on the main thread, oldest first
+		list<sGlUpload> uploads{};
+		list<sGlModelLoad*> modelLoads{};
+
+		sGlPacket packets[2]{};
+		std::thread::id thread{};	// Owns the context, records on it run resource calls at once
+
+		// Submission plan of the last packet and what the sorting saved so far
+		list<sGlDraw> draws{};
+		tagged_list<u8, eMemTag::GRAPHICS> merged{};
+		list<u64> drawSizes{};
+		sGlDrawStats drawStats{};
+		u32 drawPacket{ 0 };
 	};
 	static sGlGlobal g{};
+	static thread_local sGlPacket* gl_record = nullptr;
+
+	static sGlImage* gl_get_image(u32 image);
+	static void gl_packet_free_gui(sGlPacket& packet);
+	static void gl_upload_texture(GLuint texture, const sGlImage& img, eGlTextureFormat format, bool genMipmaps);
+	static void gl_ring_create(sGlRing& ring, u32 size);
+	static void gltf_drop_loads();
 
 	static u32 gl_extract_index(u64 encoded) { return (u32)(encoded >> 32); }
 	static u32 gl_extract_count(u64 encoded) { return (u32)(encoded & 0xFFFFFFFF); }
 	static u64 gl_encode_range(u32 index, u32 count) { return ((u64)index << 32) | count; }
+	static bool gl_context() { return g.context; }
+
+	static sGlCmd& gl_record_cmd(eGlCmd type)
+	{
+		gl_record->cmds.emplace_back();
+		auto& cmd = gl_record->cmds.back();
+		cmd.type = type;
+		return cmd;
+	}
+
+	static void gl_record_floats(eGlCmd type, std::initializer_list<f32> values)
+	{
+		auto& cmd = gl_record_cmd(type);
+		std::copy(values.begin(), values.end(), cmd.f);
+	}
+
+	// Resources are created on the render thread only, pipelined scripts load them from init()
+	static bool gl_recording(cstring func)
+	{
+		if (gl_record == nullptr || std::this_thread::get_id() == g.thread)
+			return false;
+
+		LOGW("%s is not available while the frame is pipelined, call it from init() or opt out with App.setPipelined(false).", func);
+		return true;
+	}
 
 	template <typename T>
 	T& gl_get(list<T>& vec, u32 handle)
@@ -113,6 +379,71 @@ namespace GASandbox
 		return vec[handle - 1];
 	}
 
+	// Vertices go to the batch being recorded or to the immediate one, in the format it was begun with
+	static tagged_list<u8, eMemTag::GRAPHICS>& gl_batch(u32& format)
+	{
+		format = gl_record ? gl_record->format : g.format;
+		return gl_record ? gl_record->vertices : g.vertices;
+	}
+
+	static bool gl_batch_format(u32 format, u32 expected, cstring func)
+	{
+		if (format == expected)
+			return true;
+
+		LOGW("%s needs a batch begun with vertex format %u, the current one has %u.", func, expected, format);
+		return false;
+	}
+
+	static void gl_append(tagged_list<u8, eMemTag::GRAPHICS>& batch, const void* data, size_type size)
+	{
+		const auto* bytes = static_cast<const u8*>(data);
+		batch.insert(batch.end(), bytes, bytes + size);
+	}
+
+	// Appends the vertices packed in a script list, each vertex is the first `stride` words of the format.
+	// Missing words are zero, except w of the full format which is one: a stride of 5 is x, y, z, w and color.
+	static void gl_read_vertices(sCodeVM* vm, i32 listSlot, u32 stride, i32 elementSlot, tagged_list<u8, eMemTag::GRAPHICS>& vertices, u32 format)
+	{
+		const auto& f = gl_get(g.formats, format);
+		if (stride == 0 || stride > f.stride / 4)
+		{
+			LOGW("Vertex stride must be between 1 and %u words for vertex format %u, got %u.", f.stride / 4, format, stride);
+			return;
+		}
+
+		const u32 count = (u32)App::CodeGetListCount(vm, listSlot) / stride;
+		const size_type first = vertices.size();
+		vertices.resize(first + (size_type)count * f.stride);
+
+		u32 fields[GL_FORMAT_MAX_WORDS];
+		i32 element = 0;
+		for (u32 n = 0; n < count; ++n)
+		{
+			std::memset(fields, 0, f.stride);
+			if (format == (u32)eGlVertexFormat::FULL)
+			{
+				const f32 w = 1.0f;
+				std::memcpy(&fields[3], &w, sizeof(f32));
+			}
+
+			for (u32 i = 0; i < stride; ++i, ++element)
+			{
+				App::CodeGetListElement(vm, listSlot, element, elementSlot);
+				if ((f.floats & (1u << i)) == 0)
+				{
+					fields[i] = App::CodeGetSlotUInt(vm, elementSlot);
+					continue;
+				}
+
+				const f32 value = App::CodeGetSlotFloat(vm, elementSlot);
+				std::memcpy(&fields[i], &value, sizeof(f32));
+			}
+
+			std::memcpy(&vertices[first + (size_type)n * f.stride], fields, f.stride);
+		}
+	}
+
 	#ifdef _DEBUG
 	static cstring opengl_source(GLenum source)
 	{
@@ -200,51 +531,256 @@ namespace GASandbox
 		}
 	#endif
 
-		glGenVertexArrays(1, &g.vao);
-		glGenBuffers(1, &g.vbo);
-
-		glBindVertexArray(g.vao);
-		glBindBuffer(GL_ARRAY_BUFFER, g.vbo);
-
-		const GLsizei stride = 64;
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (GLvoid*)(16));
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (GLvoid*)(20));
-		glEnableVertexAttribArray(3);
-		glVertexAttribIPointer(3, 4, GL_UNSIGNED_BYTE, stride, (GLvoid*)(24));
-		glEnableVertexAttribArray(4);
-		glVertexAttribIPointer(4, 4, GL_UNSIGNED_BYTE, stride, (GLvoid*)(28));
-		glEnableVertexAttribArray(5);
-		glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(32));
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(48));
+		gl_ring_create(g.ring, GL_RING_SIZE);
+
+		GLint align = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+		g.blockAlign = (u32)std::max(align, 16);
+		g.blockRing.target = GL_UNIFORM_BUFFER;
+		gl_ring_create(g.blockRing, GL_BLOCK_RING_SIZE);
+
+		g.thread = std::this_thread::get_id();
+		g.context = true;
+		return true;
+	}
+
+	struct sGlVertexType
+	{
+		GLenum type;
+		u32 size;
+	};
+
+	static const sGlVertexType GL_VERTEX_TYPES[] = {
+		{ GL_FLOAT, 4 }, { GL_UNSIGNED_BYTE, 1 }, { GL_BYTE, 1 }, { GL_UNSIGNED_SHORT, 2 }, { GL_SHORT, 2 }, { GL_UNSIGNED_INT, 4 }, { GL_INT, 4 }
+	};
+
+	// Points the format's vertex array at the buffer, attributes it doesn't have read their default (0, 0, 0, 1)
+	static void opengl_vertex_layout(sGlVertexFormat& format, GLuint buffer)
+	{
+		if (format.vao == 0)
+			glGenVertexArrays(1, &format.vao);
+
+		glBindVertexArray(format.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+		const GLsizei stride = (GLsizei)format.stride;
+		for (const auto& attrib : format.attribs)
+		{
+			const GLenum type = GL_VERTEX_TYPES[(u32)attrib.type].type;
+			const GLvoid* offset = (const GLvoid*)(size_type)attrib.offset;
+			glEnableVertexAttribArray(attrib.location);
+			if (attrib.type == eGlVertexType::FLOAT || attrib.normalized)
+				glVertexAttribPointer(attrib.location, (GLint)attrib.components, type, attrib.normalized ? GL_TRUE : GL_FALSE, stride, offset);
+			else
+				glVertexAttribIPointer(attrib.location, (GLint)attrib.components, type, stride, offset);
+		}
 
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glBindVertexArray(0);
+	}
 
-		return true;
+	static void gl_ring_create(sGlRing& ring, u32 size)
+	{
+		ring.size = size;
+		ring.head = 0;
+		ring.segment = 0;
+
+		glGenBuffers(1, &ring.buffer);
+		glBindBuffer(ring.target, ring.buffer);
+		if (GLAD_GL_ARB_buffer_storage)
+		{
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(ring.target, ring.size, nullptr, flags);
+			ring.data = static_cast<u8*>(glMapBufferRange(ring.target, 0, ring.size, flags));
+		}
+		else
+			glBufferData(ring.target, ring.size, nullptr, GL_STREAM_DRAW);
+		glBindBuffer(ring.target, 0);
+
+		// A new vertex ring replaces the buffer every format reads, the blocks are bound again by their next upload
+		if (ring.target == GL_ARRAY_BUFFER)
+		{
+			for (auto& format : g.formats)
+			{
+				if (format.vao != 0)
+					opengl_vertex_layout(format, ring.buffer);
+			}
+		}
+		LOGD("%s ring of %u KB, %s", ring.target == GL_ARRAY_BUFFER ? "Vertex" : "Uniform block", ring.size >> 10,
+			ring.data ? "persistently mapped" : "mapped per write");
+	}
+
+	static void gl_ring_destroy(sGlRing& ring)
+	{
+		for (auto& fence : ring.fences)
+		{
+			if (fence)
+				glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		if (ring.data)
+		{
+			glBindBuffer(ring.target, ring.buffer);
+			glUnmapBuffer(ring.target);
+			glBindBuffer(ring.target, 0);
+			ring.data = nullptr;
+		}
+		glDeleteBuffers(1, &ring.buffer);
+		ring.buffer = 0;
+	}
+
+	static void gl_ring_fence(sGlRing& ring, u32 segments)
+	{
+		for (u32 s = 0; s < GL_RING_SEGMENTS; ++s)
+		{
+			if ((segments & (1u << s)) == 0)
+				continue;
+			if (ring.fences[s])
+				glDeleteSync(ring.fences[s]);
+			ring.fences[s] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+	}
+
+	static void gl_ring_wait(sGlRing& ring, u32 segments)
+	{
+		for (u32 s = 0; s < GL_RING_SEGMENTS; ++s)
+		{
+			GLsync fence = ring.fences[s];
+			if ((segments & (1u << s)) == 0 || fence == nullptr)
+				continue;
+
+			GLenum status = glClientWaitSync(fence, 0, 0);
+			if (status == GL_TIMEOUT_EXPIRED)
+			{
+				PROFILE("GlRingStall");
+				ring.stalls++;
+				do
+					status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+				while (status == GL_TIMEOUT_EXPIRED);
+			}
+			glDeleteSync(fence);
+			ring.fences[s] = nullptr;
+		}
+	}
+
+	// Copies a batch into the ring, returns its offset, a multiple of the stride
+	static u32 gl_ring_write(sGlRing& ring, const u8* data, u32 bytes, u32 stride)
+	{
+		// A batch is kept to half the ring so it never waits on itself, bigger ones get a new ring
+		if (bytes + stride > ring.size / 2)
+		{
+			u32 size = ring.size;
+			while (bytes + stride > size / 2)
+				size *= 2;
+			gl_ring_destroy(ring);
+			gl_ring_create(ring, size);
+		}
+
+		const u32 offset = gl_ring_reserve(ring, bytes, stride);
+		gl_ring_fence(ring, ring.leave);
+		gl_ring_wait(ring, ring.wait);
+
+		if (ring.data)
+			std::memcpy(ring.data + offset, data, bytes);
+		else
+		{
+			glBindBuffer(ring.target, ring.buffer);
+			void* range = glMapBufferRange(ring.target, offset, bytes, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+			if (range)
+			{
+				std::memcpy(range, data, bytes);
+				glUnmapBuffer(ring.target);
+			}
+			glBindBuffer(ring.target, 0);
+		}
+
+		return offset;
 	}
 
 	void App::GlShutdown()
 	{
 		GlReload();
 
+		for (auto& packet : g.packets)
+			gl_packet_free_gui(packet);
+
+		LOGD("Vertex ring streamed %.1f MB, %u wraps, %u stalls", g.ring.bytes / (1024.0 * 1024.0), g.ring.wraps, g.ring.stalls);
+		LOGD("Uniform block ring streamed %.1f MB, %u wraps, %u stalls", g.blockRing.bytes / (1024.0 * 1024.0), g.blockRing.wraps, g.blockRing.stalls);
+		LOGD("Draw sorting merged %llu batches into %llu draws with %llu state changes", (unsigned long long)g.drawStats.batches,
+			(unsigned long long)g.drawStats.draws, (unsigned long long)g.drawStats.stateChanges);
+
+		g.blocks.clear();
+
 		glDeleteProgram(g.shader);
-		glDeleteBuffers(1, &g.vbo);
-		glDeleteVertexArrays(1, &g.vao);
+		gl_ring_destroy(g.ring);
+		gl_ring_destroy(g.blockRing);
+		for (auto& format : g.formats)
+		{
+			if (format.vao != 0)
+				glDeleteVertexArrays(1, &format.vao);
+			format.vao = 0;
+		}
+
+		g.context = false;
+	}
+
+	static sGlVertexAttrib gl_attrib(u32 location, u32 components, eGlVertexType type, bool normalized, u32 offset)
+	{
+		sGlVertexAttrib attrib{};
+		attrib.location = location;
+		attrib.components = components;
+		attrib.type = type;
+		attrib.normalized = normalized;
+		attrib.offset = offset;
+		return attrib;
+	}
+
+	// The built in formats take the first handles, in eGlVertexFormat order
+	static void gl_create_formats()
+	{
+		const sGlVertexAttrib full[] = {
+			gl_attrib(0, 4, eGlVertexType::FLOAT, false, 0),	// Position
+			gl_attrib(1, 4, eGlVertexType::U8, true, 16),		// Colors
+			gl_attrib(2, 4, eGlVertexType::U8, true, 20),
+			gl_attrib(3, 4, eGlVertexType::U8, false, 24),		// Indices
+			gl_attrib(4, 4, eGlVertexType::U8, false, 28),
+			gl_attrib(5, 4, eGlVertexType::FLOAT, false, 32),	// Extra, a mat2x4
+			gl_attrib(6, 4, eGlVertexType::FLOAT, false, 48),
+		};
+		const sGlVertexAttrib xyc[] = { gl_attrib(0, 2, eGlVertexType::FLOAT, false, 0), gl_attrib(1, 4, eGlVertexType::U8, true, 8) };
+		const sGlVertexAttrib xyzc[] = { gl_attrib(0, 3, eGlVertexType::FLOAT, false, 0), gl_attrib(1, 4, eGlVertexType::U8, true, 12) };
+
+		App::GlCreateVertexFormat(full, ARRAY_SIZE(full));
+		App::GlCreateVertexFormat(xyc, ARRAY_SIZE(xyc));
+		App::GlCreateVertexFormat(xyzc, ARRAY_SIZE(xyzc));
+		assert(g.formats.size() == (u32)eGlVertexFormat::XYZC);
 	}
 
 	void App::GlReload()
 	{
+		g.sortDraws = false;
+		g.uploads.clear();
+		gltf_drop_loads();
+
+		// Formats outlive reloads, their handles stay valid in scripts that run init() again
+		if (g.formats.empty())
+			gl_create_formats();
+
 		for (const auto shader : g.shaders)
 			GlDestroyShader(shader);
 		g.shaders.clear();
+		g.uniforms.clear();
+		g.uniformHandles.clear();
+		g.uniform = 0;
+		g.shaderFiles.clear();
+		g.shaderUnits.clear();
 
-		for (const auto& image : g.images)
-			if (image.data) stbi_image_free(image.data);
+		for (u32 i = 0; i < g.images.size(); ++i)
+		{
+			auto* image = gl_get_image(i + 1);
+			if (image->data) stbi_image_free(image->data);
+		}
 		g.images.clear();
 
 		for (const auto texture : g.textures)
@@ -283,6 +819,13 @@ namespace GASandbox
 				GlClear(v[0], v[1], v[2], v[3], CodeGetSlotDouble(vm, 7), CodeGetSlotInt(vm, 7), (eGlClearFlags)CodeGetSlotUInt(vm, 7));
 			});
 
+		CodeBindMethod("app", "App", true, "glSetSortDraws(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 2);
+				GlSetSortDraws(CodeGetSlotBool(vm, 1));
+			});
+
 		CodeBindMethod("app", "App", true, "glLoadShader(_)",
 			[](sCodeVM* vm)
 			{
@@ -363,6 +906,13 @@ namespace GASandbox
 				CodeSetSlotInt(vm, 0, GlImageChannels(image));
 			});
 
+		CodeBindMethod("app", "App", true, "glImageReady(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				CodeSetSlotBool(vm, 0, GlImageReady(CodeGetSlotUInt(vm, 1)));
+			});
+
 		CodeBindMethod("app", "App", true, "glLoadModel(_)",
 			[](sCodeVM* vm)
 			{
@@ -371,6 +921,21 @@ namespace GASandbox
 				CodeSetSlotUInt(vm, 0, model);
 			});
 
+		CodeBindMethod("app", "App", true, "glLoadModelAsync(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				auto model = GlLoadModelAsync(CodeGetSlotString(vm, 1));
+				CodeSetSlotUInt(vm, 0, model);
+			});
+
+		CodeBindMethod("app", "App", true, "glModelReady(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				CodeSetSlotBool(vm, 0, GlModelReady(CodeGetSlotUInt(vm, 1)));
+			});
+
 		CodeBindMethod("app", "App", true, "glDestroyModel(_)",
 			[](sCodeVM* vm)
 			{
@@ -420,93 +985,251 @@ namespace GASandbox
 					v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
 			});
 
-		CodeBindMethod("app", "App", true, "glCreateTexture(_,_,_,_,_,_,_)",
+		CodeBindMethod("app", "App", true, "glAddVertexXYC(_,_,_)",
 			[](sCodeVM* vm)
 			{
-				CodeEnsureSlots(vm, 7);
-				SCRIPT_ARGS_ARR(v, 0, 6, u32, UInt);
-				auto texture = GlCreateTexture(v[0], (eGlTextureFormat)v[1], (eGlTextureFilter)v[2], (eGlTextureFilter)v[3], (eGlTextureWrap)v[4], (eGlTextureWrap)v[5], CodeGetSlotBool(vm, 7));
-				CodeSetSlotUInt(vm, 0, texture);
+				CodeEnsureSlots(vm, 3);
+				GlAddVertexXYC(CodeGetSlotFloat(vm, 1), CodeGetSlotFloat(vm, 2), CodeGetSlotUInt(vm, 3));
 			});
 
-		CodeBindMethod("app", "App", true, "glDestroyTexture(_)",
+		CodeBindMethod("app", "App", true, "glAddVertexXYZC(_,_,_,_)",
 			[](sCodeVM* vm)
 			{
-				CodeEnsureSlots(vm, 1);
-				auto texture = CodeGetSlotUInt(vm, 1);
-				GlDestroyTexture(texture);
+				CodeEnsureSlots(vm, 4);
+				GlAddVertexXYZC(CodeGetSlotFloat(vm, 1), CodeGetSlotFloat(vm, 2), CodeGetSlotFloat(vm, 3), CodeGetSlotUInt(vm, 4));
 			});
 
-		CodeBindMethod("app", "App", true, "glBegin(_,_,_,_)",
+		CodeBindMethod("app", "App", true, "glAddVertices(_,_)",
 			[](sCodeVM* vm)
 			{
 				CodeEnsureSlots(vm, 4);
-				GlBegin(CodeGetSlotBool(vm, 1), CodeGetSlotBool(vm, 2), CodeGetSlotFloat(vm, 3), CodeGetSlotFloat(vm, 4));
+				u32 format = 0;
+				auto& batch = gl_batch(format);
+				gl_read_vertices(vm, 1, CodeGetSlotUInt(vm, 2), 3, batch, format);
 			});
 
-		CodeBindMethod("app", "App", true, "glEnd(_,_,_)",
+		// Only reached through App.glAddVertices(data), which checks that the argument is a VertexData
+		CodeBindMethod("app", "App", true, "glAddVertexData_(_)",
 			[](sCodeVM* vm)
 			{
-				CodeEnsureSlots(vm, 3);
-				GlEnd(CodeGetSlotBool(vm, 1), CodeGetSlotUInt(vm, 2), CodeGetSlotUInt(vm, 3));
+				CodeEnsureSlots(vm, 2);
+				const auto* data = *static_cast<sGlVertexData**>(CodeGetSlotObject(vm, 1));
+				u32 format = 0;
+				auto& batch = gl_batch(format);
+				if (gl_batch_format(format, data->format, "glAddVertices"))
+					gl_append(batch, data->bytes.data(), data->bytes.size());
 			});
 
-		CodeBindMethod("app", "App", true, "glSetUniform(_)",
+		CodeBindMethod("app", "App", true, "glCreateVertexFormat(_)",
 			[](sCodeVM* vm)
 			{
-				CodeEnsureSlots(vm, 1);
-				cstring value = CodeGetSlotString(vm, 1);
-				GlSetUniform(value);
-			});
+				// A list of [location, components, type, normalized, offset], without an offset the attribute
+				// follows the previous one
+				CodeEnsureSlots(vm, 4);
+				thread_local list<sGlVertexAttrib> attribs;
+				attribs.resize((size_type)CodeGetListCount(vm, 1));
+				u32 offset = 0;
+				for (i32 i = 0; i < (i32)attribs.size(); ++i)
+				{
+					CodeGetListElement(vm, 1, i, 2);
+					const i32 fields = CodeGetListCount(vm, 2);
+					u32 v[5]{ 0, 4, 0, 0, offset };
+					for (i32 f = 0; f < fields && f < 5; ++f)
+					{
+						CodeGetListElement(vm, 2, f, 3);
+						v[f] = f == 3 ? (u32)CodeGetSlotBool(vm, 3) : CodeGetSlotUInt(vm, 3);
+					}
 
-		CodeBindMethod("app", "App", true, "glSetTex2D(_,_)",
-			[](sCodeVM* vm)
-			{
-				CodeEnsureSlots(vm, 2);
-				GlSetTex2D(CodeGetSlotUInt(vm, 1), CodeGetSlotUInt(vm, 2));
+					auto& attrib = attribs[i];
+					attrib = gl_attrib(v[0], v[1], (eGlVertexType)v[2], v[3] != 0, v[4]);
+					const u32 type = std::min(v[2], (u32)ARRAY_SIZE(GL_VERTEX_TYPES) - 1);
+					offset = attrib.offset + attrib.components * GL_VERTEX_TYPES[type].size;
+				}
+				CodeSetSlotUInt(vm, 0, GlCreateVertexFormat(attribs.data(), (u32)attribs.size()));
 			});
 
-		CodeBindMethod("app", "App", true, "glSetFloat(_)",
+		CodeBindClass("app", "VertexData", {
 			[](sCodeVM* vm)
 			{
-				CodeEnsureSlots(vm, 1);
-				f32 value = CodeGetSlotFloat(vm, 1);
-				GlSetFloat(value);
-			});
+				auto** data = static_cast<sGlVertexData**>(CodeSetSlotNewObject(vm, 0, 0, sizeof(sGlVertexData*)));
+				*data = new sGlVertexData();
+			},
+			[](void* data)
+			{
+				delete *static_cast<sGlVertexData**>(data);
+			} });
 
-		CodeBindMethod("app", "App", true, "glSetVec2f(_,_)",
+		CodeBindMethod("app", "VertexData", false, "add(_,_)",
 			[](sCodeVM* vm)
 			{
-				CodeEnsureSlots(vm, 2);
-				SCRIPT_ARGS_ARR(v, 0, 2, f32, Float);
-				GlSetVec2F(v[0], v[1]);
+				CodeEnsureSlots(vm, 4);
+				auto* data = *static_cast<sGlVertexData**>(CodeGetSlotObject(vm, 0));
+				gl_read_vertices(vm, 1, CodeGetSlotUInt(vm, 2), 3, data->bytes, data->format);
 			});
 
-		CodeBindMethod("app", "App", true, "glSetVec3f(_,_,_)",
+		CodeBindMethod("app", "VertexData", false, "count",
 			[](sCodeVM* vm)
 			{
-				CodeEnsureSlots(vm, 3);
-				SCRIPT_ARGS_ARR(v, 0, 3, f32, Float);
-				GlSetVec3F(v[0], v[1], v[2]);
+				const auto* data = *static_cast<sGlVertexData**>(CodeGetSlotObject(vm, 0));
+				CodeSetSlotUInt(vm, 0, (u32)(data->bytes.size() / gl_get(g.formats, data->format).stride));
 			});
 
-		CodeBindMethod("app", "App", true, "glSetVec4f(_,_,_,_)",
+		CodeBindMethod("app", "VertexData", false, "clear()",
 			[](sCodeVM* vm)
 			{
-				CodeEnsureSlots(vm, 4);
-				SCRIPT_ARGS_ARR(v, 0, 4, f32, Float);
-				GlSetVec4F(v[0], v[1], v[2], v[3]);
+				auto* data = *static_cast<sGlVertexData**>(CodeGetSlotObject(vm, 0));
+				data->bytes.clear();
 			});
 
-		CodeBindMethod("app", "App", true, "glSetMat2x2f(_,_,_,_)",
+		CodeBindMethod("app", "VertexData", false, "format",
 			[](sCodeVM* vm)
 			{
-				CodeEnsureSlots(vm, 4);
-				SCRIPT_ARGS_ARR(v, 0, 4, f32, Float);
-				GlSetMat2x2F(v[0], v[1], v[2], v[3]);
+				const auto* data = *static_cast<sGlVertexData**>(CodeGetSlotObject(vm, 0));
+				CodeSetSlotUInt(vm, 0, data->format);
 			});
 
-		CodeBindMethod("app", "App", true, "glSetMat2x3f(_,_,_,_,_,_)",
+		CodeBindMethod("app", "VertexData", false, "format=(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 2);
+				auto* data = *static_cast<sGlVertexData**>(CodeGetSlotObject(vm, 0));
+				const u32 format = CodeGetSlotUInt(vm, 1);
+				if (format == 0 || format > g.formats.size())
+				{
+					LOGW("Unknown vertex format %u.", format);
+					return;
+				}
+
+				// The vertices are packed for the old format
+				data->bytes.clear();
+				data->format = format;
+			});
+
+		CodeBindMethod("app", "App", true, "glCreateTexture(_,_,_,_,_,_,_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 7);
+				SCRIPT_ARGS_ARR(v, 0, 6, u32, UInt);
+				auto texture = GlCreateTexture(v[0], (eGlTextureFormat)v[1], (eGlTextureFilter)v[2], (eGlTextureFilter)v[3], (eGlTextureWrap)v[4], (eGlTextureWrap)v[5], CodeGetSlotBool(vm, 7));
+				CodeSetSlotUInt(vm, 0, texture);
+			});
+
+		CodeBindMethod("app", "App", true, "glCreateTextureAsync(_,_,_,_,_,_,_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 7);
+				SCRIPT_ARGS_ARR(v, 0, 6, u32, UInt);
+				auto texture = GlCreateTextureAsync(v[0], (eGlTextureFormat)v[1], (eGlTextureFilter)v[2], (eGlTextureFilter)v[3], (eGlTextureWrap)v[4], (eGlTextureWrap)v[5], CodeGetSlotBool(vm, 7));
+				CodeSetSlotUInt(vm, 0, texture);
+			});
+
+		CodeBindMethod("app", "App", true, "glTextureReady(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				CodeSetSlotBool(vm, 0, GlTextureReady(CodeGetSlotUInt(vm, 1)));
+			});
+
+		CodeBindMethod("app", "App", true, "glDestroyTexture(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				auto texture = CodeGetSlotUInt(vm, 1);
+				GlDestroyTexture(texture);
+			});
+
+		CodeBindMethod("app", "App", true, "glBegin(_,_,_,_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 4);
+				GlBegin(CodeGetSlotBool(vm, 1), CodeGetSlotBool(vm, 2), CodeGetSlotFloat(vm, 3), CodeGetSlotFloat(vm, 4));
+			});
+
+		CodeBindMethod("app", "App", true, "glBegin(_,_,_,_,_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 5);
+				GlBegin(CodeGetSlotBool(vm, 1), CodeGetSlotBool(vm, 2), CodeGetSlotFloat(vm, 3), CodeGetSlotFloat(vm, 4), CodeGetSlotUInt(vm, 5));
+			});
+
+		CodeBindMethod("app", "App", true, "glEnd(_,_,_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 3);
+				GlEnd(CodeGetSlotBool(vm, 1), CodeGetSlotUInt(vm, 2), CodeGetSlotUInt(vm, 3));
+			});
+
+		CodeBindMethod("app", "App", true, "glSetUniform(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				cstring value = CodeGetSlotString(vm, 1);
+				GlSetUniform(value);
+			});
+
+		CodeBindMethod("app", "App", true, "glGetUniform(_,_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 2);
+				auto uniform = GlGetUniform(CodeGetSlotUInt(vm, 1), CodeGetSlotString(vm, 2));
+				CodeSetSlotUInt(vm, 0, uniform);
+			});
+
+		CodeBindMethod("app", "App", true, "glSetUniformId(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				GlSetUniformId(CodeGetSlotUInt(vm, 1));
+			});
+
+		CodeBindMethod("app", "App", true, "glSetTex2D(_,_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 2);
+				GlSetTex2D(CodeGetSlotUInt(vm, 1), CodeGetSlotUInt(vm, 2));
+			});
+
+		CodeBindMethod("app", "App", true, "glSetFloat(_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 1);
+				f32 value = CodeGetSlotFloat(vm, 1);
+				GlSetFloat(value);
+			});
+
+		CodeBindMethod("app", "App", true, "glSetVec2f(_,_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 2);
+				SCRIPT_ARGS_ARR(v, 0, 2, f32, Float);
+				GlSetVec2F(v[0], v[1]);
+			});
+
+		CodeBindMethod("app", "App", true, "glSetVec3f(_,_,_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 3);
+				SCRIPT_ARGS_ARR(v, 0, 3, f32, Float);
+				GlSetVec3F(v[0], v[1], v[2]);
+			});
+
+		CodeBindMethod("app", "App", true, "glSetVec4f(_,_,_,_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 4);
+				SCRIPT_ARGS_ARR(v, 0, 4, f32, Float);
+				GlSetVec4F(v[0], v[1], v[2], v[3]);
+			});
+
+		CodeBindMethod("app", "App", true, "glSetMat2x2f(_,_,_,_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 4);
+				SCRIPT_ARGS_ARR(v, 0, 4, f32, Float);
+				GlSetMat2x2F(v[0], v[1], v[2], v[3]);
+			});
+
+		CodeBindMethod("app", "App", true, "glSetMat2x3f(_,_,_,_,_,_)",
 			[](sCodeVM* vm)
 			{
 				CodeEnsureSlots(vm, 6);
@@ -588,6 +1311,8 @@ namespace GASandbox
 
 	void App::GuiGlRender()
 	{
+		PROFILE("GuiGlRender");
+
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
@@ -598,219 +1323,1453 @@ namespace GASandbox
 		}
 	}
 
-	static GLuint opengl_load_shader(cstring vsrc, cstring fsrc)
-	{
-		// Compile vertex shader
-		GLuint vshader = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vshader, 1, &vsrc, NULL);
-		glCompileShader(vshader);
+	// Columns and rows of the value each set command carries, column after column like glUniformMatrix
+	static const u8 GL_UNIFORM_SHAPE[][2] = {
+		{ 1, 1 }, { 1, 2 }, { 1, 3 }, { 1, 4 },
+		{ 2, 2 }, { 2, 3 }, { 2, 4 }, { 3, 2 }, { 3, 3 }, { 3, 4 }, { 4, 2 }, { 4, 3 }, { 4, 4 }
+	};
 
-		i32 success = 0;
-		char log[1024];
-		glGetShaderiv(vshader, GL_COMPILE_STATUS, &success);
-		if (!success)
-		{
-			glGetShaderInfoLog(vshader, 1024, NULL, log);
-			LOGE("Failed to compile vertex shader: %s", log);
-		}
+	static size_type gl_uniform_key(GLuint program, size_type nameHash)
+	{
+		return nameHash ^ ((size_type)program * 0x9E3779B97F4A7C15ull);
+	}
 
-		// Compile fragment shader
-		GLuint fshader(glCreateShader(GL_FRAGMENT_SHADER));
-		glShaderSource(fshader, 1, &fsrc, NULL);
-		glCompileShader(fshader);
+	static u32 gl_find_uniform(GLuint program, size_type nameHash)
+	{
+		const auto it = g.uniformHandles.find(gl_uniform_key(program, nameHash));
+		return it == g.uniformHandles.end() ? 0 : it->second;
+	}
 
-		glGetShaderiv(fshader, GL_COMPILE_STATUS, &success);
-		if (!success)
-		{
-			glGetShaderInfoLog(fshader, 1024, NULL, log);
-			LOGE("Failed to compile fragment shader: %s", log);
-		}
+	// Keeps the value of a plain uniform, returns false when the driver already holds it
+	static bool gl_uniform_changed(sGlUniform& uniform, eGlCmd type, const f32* v)
+	{
+		const size_type bytes = type == eGlCmd::TEX2D ? sizeof(f32) :
+			(size_type)GL_UNIFORM_SHAPE[(u32)type - (u32)eGlCmd::FLOAT][0] * GL_UNIFORM_SHAPE[(u32)type - (u32)eGlCmd::FLOAT][1] * sizeof(f32);
+		if (uniform.set && uniform.type == type && std::memcmp(uniform.value, v, bytes) == 0)
+			return false;
 
-		// Link vertex and fragment shader together
-		GLuint program = glCreateProgram();
-		glAttachShader(program, vshader);
-		glAttachShader(program, fshader);
-		glLinkProgram(program);
+		uniform.set = true;
+		uniform.type = type;
+		std::memcpy(uniform.value, v, bytes);
+		return true;
+	}
 
-		glGetProgramiv(program, GL_LINK_STATUS, &success);
-		if (!success)
+	// Writes a value into block data with its std140 layout, returns whether any of it changed
+	static bool gl_block_write(u8* data, u32 size, const sGlUniform& uniform, eGlCmd type, const f32* v)
+	{
+		const auto& shape = GL_UNIFORM_SHAPE[(u32)type - (u32)eGlCmd::FLOAT];
+		bool changed = false;
+		for (u32 c = 0; c < shape[0]; ++c)
 		{
-			glGetProgramInfoLog(program, 1024, NULL, log);
-			LOGE("Failed to link shader program: %s", log);
+			for (u32 r = 0; r < shape[1]; ++r)
+			{
+				const u32 at = uniform.offset + (uniform.rowMajor ? r * uniform.matrixStride + c * 4 : c * uniform.matrixStride + r * 4);
+				if (at + sizeof(f32) > size)
+					continue;
+
+				const f32 value = v[c * shape[1] + r];
+				if (std::memcmp(data + at, &value, sizeof(f32)) != 0)
+				{
+					std::memcpy(data + at, &value, sizeof(f32));
+					changed = true;
+				}
+			}
 		}
+		return changed;
+	}
 
-		glValidateProgram(program);
-		glGetProgramiv(program, GL_VALIDATE_STATUS, &success);
-		if (!success)
+	static void opengl_set_uniform(GLint location, eGlCmd type, const f32* v)
+	{
+		switch (type)
 		{
-			glGetProgramInfoLog(program, 1024, NULL, log);
-			LOGE("Shader validation error: %s", log);
+		case eGlCmd::FLOAT: glUniform1f(location, v[0]); break;
+		case eGlCmd::VEC2: glUniform2fv(location, 1, v); break;
+		case eGlCmd::VEC3: glUniform3fv(location, 1, v); break;
+		case eGlCmd::VEC4: glUniform4fv(location, 1, v); break;
+		case eGlCmd::MAT2X2: glUniformMatrix2fv(location, 1, GL_FALSE, v); break;
+		case eGlCmd::MAT2X3: glUniformMatrix2x3fv(location, 1, GL_FALSE, v); break;
+		case eGlCmd::MAT2X4: glUniformMatrix2x4fv(location, 1, GL_FALSE, v); break;
+		case eGlCmd::MAT3X2: glUniformMatrix3x2fv(location, 1, GL_FALSE, v); break;
+		case eGlCmd::MAT3X3: glUniformMatrix3fv(location, 1, GL_FALSE, v); break;
+		case eGlCmd::MAT3X4: glUniformMatrix3x4fv(location, 1, GL_FALSE, v); break;
+		case eGlCmd::MAT4X2: glUniformMatrix4x2fv(location, 1, GL_FALSE, v); break;
+		case eGlCmd::MAT4X3: glUniformMatrix4x3fv(location, 1, GL_FALSE, v); break;
+		case eGlCmd::MAT4X4: glUniformMatrix4fv(location, 1, GL_FALSE, v); break;
+		default: break;
 		}
+	}
 
-		// Delete shaders objects
-		glDeleteShader(vshader);
-		glDeleteShader(fshader);
-
-		if (!success)
+	// Sends a value the caller already found changed, plain uniforms need their program bound
+	static void gl_uniform_send(const sGlUniform& uniform, eGlCmd type, const f32* v)
+	{
+		if (uniform.block == 0)
 		{
-			glDeleteProgram(program);
-			return 0;
+			if (uniform.location >= 0)
+				opengl_set_uniform(uniform.location, type, v);
+			return;
 		}
 
-		g.shaders.emplace_back(program);
-		return program;
+		auto& block = g.blocks[uniform.block - 1];
+		if (gl_block_write(block.data.data(), block.size, uniform, type, v))
+			block.dirty = g.blocksDirty = true;
 	}
 
-	static string shader_process_includes(const string& source)
+	// Dirty blocks are copied to the block ring as one batch and bound by range, so the driver never has to wait for
+	// or shadow a buffer an earlier draw still reads. Clean blocks stay bound to their last snapshot, an upload that
+	// wraps or grows the ring copies every block since it will write over or release those snapshots.
+	static void gl_upload_blocks()
 	{
-		std::stringstream processed;
-		std::istringstream input(source);
-		string line;
-		static string includePath;
+		if (!g.blocksDirty)
+			return;
 
-		while (std::getline(input, line))
+		g.blocksDirty = false;
+		auto& ring = g.blockRing;
+		const u32 align = g.blockAlign;
+		u32 dirty = 0, all = 0;
+		for (const auto& block : g.blocks)
 		{
-			// Check for #include "filename"
-			if (line.rfind("#include", 0) == 0)
-			{
-				size_type start = line.find('"');
-				size_type end = line.rfind('"');
-				if (start != string::npos && end != string::npos && start < end)
-				{
-					size_type len = end - start - 1;
+			const u32 bytes = (block.size + align - 1) / align * align;
+			dirty += block.dirty ? bytes : 0;
+			all += bytes;
+		}
+		const u32 head = (ring.head + align - 1) / align * align;
+		const bool every = head + dirty > ring.size || dirty + align > ring.size / 2;
 
-					// Ensure buffer is large enough
-					includePath.resize(len);
-					std::memcpy(&includePath[0], line.c_str() + start + 1, len);
-					includePath[len] = '\0'; // Null-terminate manually
+		auto& upload = g.blockUpload;
+		upload.resize(every ? all : dirty);
+		u32 at = 0;
+		for (auto& block : g.blocks)
+		{
+			if (!every && !block.dirty)
+				continue;
 
-					string includedSource = App::FileLoad(includePath.c_str());
-					processed << shader_process_includes(includedSource) << "\n";
-					continue; // Skip writing the #include line itself
-				}
-			}
-			processed << line << "\n";
+			block.offset = at;
+			std::memcpy(upload.data() + at, block.data.data(), block.size);
+			at += (block.size + align - 1) / align * align;
 		}
-		return processed.str();
-	}
 
-	u32 App::GlLoadShader(cstring filepath)
-	{
-		auto src = shader_process_includes(FileLoad(filepath));
-		auto vsrc = "#version 330 core\n#define VERT\n" + src;
-		auto fsrc = "#version 330 core\n#define FRAG\n" + src;
-		auto shader = opengl_load_shader(vsrc.c_str(), fsrc.c_str());
-		if (shader == 0)
-			LOGW("Failed to load shader from file: %s", filepath);
-		return shader;
-	}
+		const u32 offset = gl_ring_write(ring, upload.data(), at, align);
+		for (u32 i = 0; i < (u32)g.blocks.size(); ++i)
+		{
+			auto& block = g.blocks[i];
+			if (!every && !block.dirty)
+				continue;
 
-	u32 App::GlCreateShader(cstring source)
-	{
-		auto src = shader_process_includes(source);
-		auto vsrc = "#version 330 core\n#define VERT\n" + src;
-		auto fsrc = "#version 330 core\n#define FRAG\n" + src;
-		auto shader = opengl_load_shader(vsrc.c_str(), fsrc.c_str());
-		if (shader == 0)
-			LOGW("Failed to create shader from source.");
-		return shader;
+			glBindBufferRange(GL_UNIFORM_BUFFER, i, ring.buffer, offset + block.offset, block.size);
+			block.dirty = false;
+		}
 	}
 
-	void App::GlDestroyShader(u32 shader)
+	// Uniform values outside a recorded frame go to the selected uniform at once
+	static void gl_set_value(eGlCmd type, std::initializer_list<f32> values)
 	{
-		glDeleteProgram(shader);
-	}
+		if (gl_record)
+		{
+			gl_record_floats(type, values);
+			return;
+		}
 
-	void App::GlSetShader(u32 shader)
-	{
-		g.shader = shader;
-		glUseProgram(g.shader);
-	}
+		if (!gl_context() || g.uniform == 0)
+			return;
 
-	static sGlImage* gl_get_image(u32 image)
-	{
-		if (image == 0 || image > g.images.size())
+		f32 v[16]{};
+		std::copy(values.begin(), values.end(), v);
+		auto& uniform = g.uniforms[g.uniform - 1];
+		if (uniform.block != 0)
 		{
-			LOGW("Invalid image handle!");
-			return nullptr;
+			gl_uniform_send(uniform, type, v);
+			return;
 		}
 
-		return &g.images[static_cast<size_type>(image) - 1];
+		if (!gl_uniform_changed(uniform, type, v))
+			return;
+
+		if (uniform.program != g.shader)
+			glUseProgram(uniform.program);
+		gl_uniform_send(uniform, type, v);
+		if (uniform.program != g.shader)
+			glUseProgram(g.shader);
 	}
 
-	u32 App::GlLoadImage(cstring filepath, bool flipY)
+	static void gl_draw(const u8* vertices, size_type count, u32 mode, u32 format)
 	{
-		cstring path = FilePath(filepath);
+		if (count == 0)
+			return;
 
-		sGlImage img{};
-		stbi_set_flip_vertically_on_load(flipY);
-		img.data = stbi_load(path, &img.w, &img.h, &img.c, 0);
-		if (!img.data)
+		gl_upload_blocks();
+
+		auto& f = gl_get(g.formats, format);
+		const GLint first = (GLint)(gl_ring_write(g.ring, vertices, (u32)(count * f.stride), f.stride) / f.stride);
+		if (f.vao == 0)
+			opengl_vertex_layout(f, g.ring.buffer);
+
+		glBindVertexArray(f.vao);
+		for (u32 bit = 1; bit <= (u32)eGlTopology::TRIANGLE_FAN; bit <<= 1)
 		{
-			LOGW("Failed to load image: %s", path);
-			return -1;
+			if (mode & bit)
+			{
+				u32 i = 0, b = bit;
+				while (b > 1 && ++i) b >>= 1;
+				glDrawArrays(GL_POINTS + i, first, (GLsizei)count);
+			}
 		}
+		glBindVertexArray(0);
 
-		g.images.emplace_back(img);
-		return (u32)(g.images.size());
+		// Block ring segments the last upload moved past are fenced once, this draw is the last that reads them
+		gl_ring_fence(g.ring, g.ring.retire);
+		gl_ring_fence(g.blockRing, g.blockRing.retire);
+		g.blockRing.retire = 0;
 	}
 
-	u32 App::GlCreateImage(i32 w, i32 h, i32 c, u8* data)
+	static void gl_packet_clear_gui(sGlPacket& packet)
 	{
-		sGlImage img{ w, h, c, data };
-
-		g.images.emplace_back(img);
-		return (u32)(g.images.size());
+		packet.gui.Valid = false;
+		packet.gui.CmdListsCount = 0;
+		packet.gui.CmdLists.resize(0);
 	}
 
-	void App::GlDestroyImage(u32 image)
+	static void gl_packet_free_gui(sGlPacket& packet)
 	{
-		auto img = gl_get_image(image);
-		if (img == nullptr) return;
-		stbi_image_free(img->data);
-		*img = sGlImage{};
+		for (auto* drawList : packet.guiLists)
+			IM_DELETE(drawList);
+		packet.guiLists.clear();
+		packet.gui.Clear();
 	}
 
-	i32 App::GlImageWidth(u32 image)
+	template <typename T>
+	static void gl_copy_vector(ImVector<T>& dst, const ImVector<T>& src)
 	{
-		auto img = gl_get_image(image);
-		if (img == nullptr) return 0;
-		return img->w;
+		// ImVector assignment frees first, resizing keeps the capacity
+		dst.resize(src.Size);
+		if (src.Size > 0)
+			std::memcpy(dst.Data, src.Data, (size_type)src.Size * sizeof(T));
 	}
 
-	i32 App::GlImageHeight(u32 image)
+	void App::GlPacketBegin(u32 packet)
 	{
-		auto img = gl_get_image(image);
-		if (img == nullptr) return 0;
-		return img->h;
-	}
+		auto& p = g.packets[packet & 1];
+		p.cmds.clear();
+		p.vertices.clear();
+		p.names.clear();
+		p.begin = 0;
+		p.format = (u32)eGlVertexFormat::FULL;
+		p.sort = g.sortDraws;
+		gl_packet_clear_gui(p);
 
-	i32 App::GlImageChannels(u32 image)
-	{
-		auto img = gl_get_image(image);
-		if (img == nullptr) return 0;
-		return img->c;
+		gl_record = &p;
 	}
 
-	u8* App::GlImageData(u32 image)
+	void App::GlPacketEnd()
 	{
-		auto img = gl_get_image(image);
-		if (img == nullptr) return nullptr;
-		return img->data;
+		gl_record = nullptr;
 	}
 
-	static void gltf_free(cgltf_data* data)
+	// Ends the gui frame built while the packet recorded. Draw lists belong to the gui context that the next frame
+	// rebuilds, the packet keeps its own copy so submitting it never touches the context.
+	void App::GlPacketGui(u32 packet)
 	{
-		if (data != nullptr)
+		PROFILE("GlPacketGui");
+
+		auto& p = g.packets[packet & 1];
+		ImGui::Render();
+		const ImDrawData* data = ImGui::GetDrawData();
+		if (data == nullptr || !data->Valid)
+			return;
+
+		p.gui.Valid = data->Valid;
+		p.gui.CmdListsCount = data->CmdListsCount;
+		p.gui.TotalIdxCount = data->TotalIdxCount;
+		p.gui.TotalVtxCount = data->TotalVtxCount;
+		p.gui.DisplayPos = data->DisplayPos;
+		p.gui.DisplaySize = data->DisplaySize;
+		p.gui.FramebufferScale = data->FramebufferScale;
+		p.gui.OwnerViewport = data->OwnerViewport;
+		p.gui.CmdLists.resize(data->CmdLists.Size);
+		for (i32 i = 0; i < data->CmdLists.Size; ++i)
+		{
+			const ImDrawList* src = data->CmdLists[i];
+			if (i >= (i32)p.guiLists.size())
+				p.guiLists.push_back(IM_NEW(ImDrawList)(src->_Data));
+
+			ImDrawList* dst = p.guiLists[i];
+			gl_copy_vector(dst->CmdBuffer, src->CmdBuffer);
+			gl_copy_vector(dst->IdxBuffer, src->IdxBuffer);
+			gl_copy_vector(dst->VtxBuffer, src->VtxBuffer);
+			dst->Flags = src->Flags;
+			p.gui.CmdLists[i] = dst;
+		}
+	}
+
+	static sGlDrawState gl_state_unknown()
+	{
+		sGlDrawState state{};
+		state.shader = ~0u;
+		state.pointSize = -1;
+		state.lineWidth = -1;
+		state.alpha = 0xFF;
+		state.ztest = 0xFF;
+		return state;
+	}
+
+	// Sets what differs from the applied state, returns how many changes that took
+	static u32 gl_apply_state(sGlDrawState& applied, const sGlDrawState& next, bool execute)
+	{
+		u32 changes = 0;
+		if (applied.shader != next.shader)
+		{
+			applied.shader = next.shader;
+			changes++;
+			if (execute)
+			{
+				g.shader = next.shader;
+				glUseProgram(next.shader);
+			}
+		}
+
+		if (applied.alpha != next.alpha)
+		{
+			applied.alpha = next.alpha;
+			changes++;
+			if (execute && next.alpha)
+			{
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				glBlendEquation(GL_FUNC_ADD);
+			}
+			else if (execute)
+			{
+				glDisable(GL_BLEND);
+			}
+		}
+
+		if (applied.ztest != next.ztest)
+		{
+			applied.ztest = next.ztest;
+			changes++;
+			if (execute && next.ztest)
+				glEnable(GL_DEPTH_TEST);
+			else if (execute)
+				glDisable(GL_DEPTH_TEST);
+		}
+
+		if (applied.pointSize != next.pointSize)
+		{
+			applied.pointSize = next.pointSize;
+			changes++;
+			if (execute)
+				glPointSize(next.pointSize);
+		}
+
+		if (applied.lineWidth != next.lineWidth)
+		{
+			applied.lineWidth = next.lineWidth;
+			changes++;
+			if (execute)
+				glLineWidth(next.lineWidth);
+		}
+
+		return changes;
+	}
+
+	// Batches drawn as one call: same state, list topologies only, and the first one ending on a whole primitive
+	static bool gl_draw_merges(const sGlDraw& a, const sGlDraw& b)
+	{
+		const u32 lists = (u32)eGlTopology::POINTS | (u32)eGlTopology::LINES | (u32)eGlTopology::TRIANGLES;
+		const auto& s = a.state;
+		const auto& t = b.state;
+		if (a.batches == 0 || b.batches == 0 || (s.mode & ~lists) != 0)
+			return false;
+
+		if (s.shader != t.shader || s.mode != t.mode || s.alpha != t.alpha || s.ztest != t.ztest ||
+			s.pointSize != t.pointSize || s.lineWidth != t.lineWidth || s.format != t.format)
+			return false;
+
+		if ((s.mode & (u32)eGlTopology::LINES) && a.count % 2 != 0)
+			return false;
+		if ((s.mode & (u32)eGlTopology::TRIANGLES) && a.count % 3 != 0)
+			return false;
+
+		return true;
+	}
+
+	// Sorts the batches recorded since the last barrier and merges the neighbours that allow it
+	static void gl_plan_flush(const sGlPacket& p, size_type begin)
+	{
+		auto& draws = g.draws;
+		std::stable_sort(draws.begin() + begin, draws.end(), [](const sGlDraw& a, const sGlDraw& b) { return a.key < b.key; });
+
+		size_type out = begin;
+		for (size_type i = begin; i < draws.size(); ++i)
+		{
+			const sGlDraw draw = draws[i];
+			if (out == begin || !gl_draw_merges(draws[out - 1], draw))
+			{
+				draws[out++] = draw;
+				continue;
+			}
+
+			// Contiguous batches are drawn in place, the others are copied behind each other once
+			auto& last = draws[out - 1];
+			const u32 stride = gl_get(g.formats, last.state.format).stride;
+			if (!last.gathered && last.first + last.count * stride != draw.first)
+			{
+				const size_type at = g.merged.size();
+				g.merged.insert(g.merged.end(), p.vertices.begin() + last.first, p.vertices.begin() + last.first + last.count * stride);
+				last.first = (u32)at;
+				last.gathered = true;
+			}
+			if (last.gathered)
+				g.merged.insert(g.merged.end(), p.vertices.begin() + draw.first, p.vertices.begin() + draw.first + draw.count * stride);
+
+			last.count += draw.count;
+			last.batches += draw.batches;
+		}
+
+		draws.resize(out);
+		g.drawSizes.clear();
+	}
+
+	// Builds the submission of a packet without touching the driver, so headless runs plan the same draws
+	static void gl_plan_packet(const sGlPacket& p)
+	{
+		PROFILE("GlPlanPacket");
+
+		g.draws.clear();
+		g.merged.clear();
+		g.drawSizes.clear();
+
+		// Blocks are stepped through on a copy, the submission writes them again in stream order
+		for (auto& block : g.blocks)
+			block.plan = block.data;
+
+		sGlDrawState state{};
+		state.shader = g.shader;
+		const sGlCmd* select = nullptr;
+		u32 run = 0;
+		bool sorting = false;
+		size_type pending = 0;
+		for (u32 i = 0; i < (u32)p.cmds.size(); ++i)
+		{
+			const auto& cmd = p.cmds[i];
+			switch (cmd.type)
+			{
+			case eGlCmd::SHADER:
+				state.shader = cmd.u[0];
+				break;
+			case eGlCmd::BEGIN:
+				state.alpha = cmd.u[0] != 0;
+				state.ztest = cmd.u[1] != 0;
+				state.pointSize = cmd.f[0];
+				state.lineWidth = cmd.f[1];
+				state.format = cmd.u[2];
+				break;
+			case eGlCmd::UNIFORM:
+				select = &cmd;
+				break;
+			case eGlCmd::END:
+			{
+				g.drawStats.batches++;
+				if (cmd.u[3] == cmd.u[2] || cmd.u[1] == 0)
+					break;
+
+				// A blended or untested batch is a run of its own, consecutive opaque ones share one when sorting
+				const bool sortable = p.sort && !state.alpha && state.ztest;
+				if (!sortable || !sorting)
+					run++;
+				sorting = sortable;
+
+				u64 sizes = 0;
+				std::memcpy(&sizes, &state.pointSize, sizeof(f32));
+				std::memcpy(reinterpret_cast<u8*>(&sizes) + sizeof(f32), &state.lineWidth, sizeof(f32));
+				const auto it = std::find(g.drawSizes.begin(), g.drawSizes.end(), sizes);
+				const u64 size = (u64)(it - g.drawSizes.begin());
+				if (it == g.drawSizes.end())
+					g.drawSizes.push_back(sizes);
+
+				g.draws.emplace_back();
+				auto& draw = g.draws.back();
+				draw.cmd = i;
+				draw.batches = 1;
+				draw.first = cmd.u[2];
+				draw.count = (cmd.u[3] - cmd.u[2]) / gl_get(g.formats, state.format).stride;
+				draw.state = state;
+				draw.state.mode = cmd.u[1];
+				draw.key = ((u64)(run & 0xFFFFFF) << 40) | ((u64)(state.shader & 0xFFFF) << 24) | ((u64)state.alpha << 23) |
+					((u64)state.ztest << 22) | ((u64)((cmd.u[1] >> 1) & 0x7F) << 15) | ((u64)(state.format & 0xF) << 11) | (size & 0x7FF);
+				break;
+			}
+			default:
+			{
+				// Values the driver already holds are dropped and don't split the batches around them. Without a
+				// context nothing is reflected, every value stays a barrier.
+				u32 uniform = 0;
+				if (cmd.type >= eGlCmd::TEX2D && cmd.type <= eGlCmd::MAT4X4 && select != nullptr)
+					uniform = select->u[1] != 0 ? select->u[0] : gl_find_uniform(state.shader, (size_type)(((u64)select->u[2] << 32) | select->u[3]));
+				if (cmd.type > eGlCmd::TEX2D && cmd.type <= eGlCmd::MAT4X4 && gl_context())
+				{
+					if (uniform == 0 || uniform > g.uniforms.size())
+						break;
+
+					auto& u = g.uniforms[uniform - 1];
+					auto* block = u.block != 0 ? &g.blocks[u.block - 1] : nullptr;
+					if (block ? !gl_block_write(block->plan.data(), block->size, u, cmd.type, cmd.f) : !gl_uniform_changed(u, cmd.type, cmd.f))
+						break;
+				}
+
+				gl_plan_flush(p, pending);
+				run = 0;
+				sorting = false;
+
+				g.draws.emplace_back();
+				auto& barrier = g.draws.back();
+				barrier.cmd = i;
+				barrier.first = uniform <= g.uniforms.size() ? uniform : 0;
+				barrier.bind = barrier.first != 0 && g.uniforms[barrier.first - 1].location >= 0;
+				barrier.state.shader = barrier.bind ? g.uniforms[barrier.first - 1].program : state.shader;
+				pending = g.draws.size();
+				break;
+			}
+			}
+		}
+		gl_plan_flush(p, pending);
+
+		auto& stats = g.drawStats;
+		stats.frames++;
+		stats.commands += p.cmds.size();
+
+		// Counted the way the submission applies them, a uniform barrier only needs its program bound
+		sGlDrawState applied = gl_state_unknown();
+		for (const auto& draw : g.draws)
+		{
+			if (draw.batches > 0)
+			{
+				stats.draws++;
+				stats.stateChanges += gl_apply_state(applied, draw.state, false);
+			}
+			else if (draw.bind)
+			{
+				sGlDrawState program = applied;
+				program.shader = draw.state.shader;
+				stats.stateChanges += gl_apply_state(applied, program, false);
+			}
+		}
+	}
+
+	void App::GlPacketSubmit(u32 packet)
+	{
+		PROFILE("GlPacketSubmit");
+
+		auto& p = g.packets[packet & 1];
+		gl_plan_packet(p);
+		g.drawPacket = packet & 1;
+
+		if (!gl_context())
+			return;
+
+		sGlDrawState applied = gl_state_unknown();
+		for (const auto& draw : g.draws)
+		{
+			if (draw.batches > 0)
+			{
+				gl_apply_state(applied, draw.state, true);
+				gl_draw((draw.gathered ? g.merged.data() : p.vertices.data()) + draw.first, draw.count, draw.state.mode, draw.state.format);
+				continue;
+			}
+
+			const auto& cmd = p.cmds[draw.cmd];
+			if (draw.bind)
+			{
+				sGlDrawState program = applied;
+				program.shader = draw.state.shader;
+				gl_apply_state(applied, program, true);
+			}
+
+			switch (cmd.type)
+			{
+			case eGlCmd::VIEWPORT: GlViewport((i32)cmd.u[0], (i32)cmd.u[1], cmd.u[2], cmd.u[3]); break;
+			case eGlCmd::SCISSOR: GlScissor((i32)cmd.u[0], (i32)cmd.u[1], cmd.u[2], cmd.u[3]); break;
+			case eGlCmd::CLEAR: GlClear(cmd.f[0], cmd.f[1], cmd.f[2], cmd.f[3], cmd.d, (i32)cmd.u[0], (eGlClearFlags)cmd.u[1]); break;
+			case eGlCmd::TEX2D:
+			{
+				glActiveTexture(GL_TEXTURE0 + cmd.u[0]);
+				glBindTexture(GL_TEXTURE_2D, cmd.u[1]);
+
+				const f32 unit = (f32)cmd.u[0];
+				if (draw.bind && gl_uniform_changed(g.uniforms[draw.first - 1], eGlCmd::TEX2D, &unit))
+					glUniform1i(g.uniforms[draw.first - 1].location, (GLint)cmd.u[0]);
+				break;
+			}
+			case eGlCmd::DESTROY_SHADER: GlDestroyShader(cmd.u[0]); break;
+			case eGlCmd::DESTROY_TEXTURE: GlDestroyTexture(cmd.u[0]); break;
+			default:
+				if (draw.first != 0)
+					gl_uniform_send(g.uniforms[draw.first - 1], cmd.type, cmd.f);
+				break;
+			}
+		}
+
+		if (p.gui.Valid)
+			ImGui_ImplOpenGL3_RenderDrawData(&p.gui);
+
+		GLenum err;
+		while ((err = glGetError()) != GL_NO_ERROR)
+		{
+			LOGE("OpenGL Error: 0x%X", err);
+		}
+	}
+
+	bool App::GlDumpDraws(cstring filepath)
+	{
+		static const cstring names[] = {
+			"VIEWPORT", "SCISSOR", "CLEAR", "SHADER", "BEGIN", "END", "UNIFORM", "TEX2D",
+			"FLOAT", "VEC2", "VEC3", "VEC4",
+			"MAT2X2", "MAT2X3", "MAT2X4", "MAT3X2", "MAT3X3", "MAT3X4", "MAT4X2", "MAT4X3", "MAT4X4",
+			"DESTROY_SHADER", "DESTROY_TEXTURE"
+		};
+
+		FILE* file = std::fopen(filepath, "w");
+		if (file == nullptr)
+			return false;
+
+		const auto& s = g.drawStats;
+		std::fprintf(file, "frames %llu, commands %llu, batches %llu, draws %llu, state changes %llu\n",
+			(unsigned long long)s.frames, (unsigned long long)s.commands, (unsigned long long)s.batches,
+			(unsigned long long)s.draws, (unsigned long long)s.stateChanges);
+
+		// The last submitted frame, as recorded and then as drawn
+		const auto& p = g.packets[g.drawPacket];
+		std::fprintf(file, "\n# recorded: %zu commands, %zu vertex bytes\n", p.cmds.size(), p.vertices.size());
+		for (u32 i = 0; s.frames > 0 && i < (u32)p.cmds.size(); ++i)
+		{
+			const auto& cmd = p.cmds[i];
+			std::fprintf(file, "%u %s", i, names[(u32)cmd.type]);
+			switch (cmd.type)
+			{
+			case eGlCmd::VIEWPORT:
+			case eGlCmd::SCISSOR: std::fprintf(file, " %d %d %u %u", (i32)cmd.u[0], (i32)cmd.u[1], cmd.u[2], cmd.u[3]); break;
+			case eGlCmd::CLEAR: std::fprintf(file, " flags 0x%x", cmd.u[1]); break;
+			case eGlCmd::SHADER:
+			case eGlCmd::DESTROY_SHADER:
+			case eGlCmd::DESTROY_TEXTURE: std::fprintf(file, " %u", cmd.u[0]); break;
+			case eGlCmd::BEGIN: std::fprintf(file, " alpha %u ztest %u point %g line %g format %u", cmd.u[0], cmd.u[1], cmd.f[0], cmd.f[1], cmd.u[2]); break;
+			case eGlCmd::END: std::fprintf(file, " mode 0x%02x bytes %u..%u", cmd.u[1], cmd.u[2], cmd.u[3]); break;
+			case eGlCmd::UNIFORM:
+				if (cmd.u[1] != 0)
+					std::fprintf(file, " id %u", cmd.u[0]);
+				else
+					std::fprintf(file, " %s", p.names.c_str() + cmd.u[0]);
+				break;
+			case eGlCmd::TEX2D: std::fprintf(file, " unit %u texture %u", cmd.u[0], cmd.u[1]); break;
+			default: break;
+			}
+			std::fprintf(file, "\n");
+		}
+
+		size_type draws = 0;
+		for (const auto& draw : g.draws)
+			draws += draw.batches > 0;
+
+		std::fprintf(file, "\n# submitted: %zu draws\n", draws);
+		for (const auto& draw : g.draws)
+		{
+			const auto& st = draw.state;
+			if (draw.batches == 0)
+				std::fprintf(file, "%u %s\n", draw.cmd, names[(u32)p.cmds[draw.cmd].type]);
+			else
+				std::fprintf(file, "%u DRAW key %016llx shader %u alpha %u ztest %u mode 0x%02x point %g line %g format %u vertices %u batches %u\n",
+					draw.cmd, (unsigned long long)draw.key, st.shader, st.alpha, st.ztest, st.mode, st.pointSize, st.lineWidth, st.format, draw.count, draw.batches);
+		}
+
+		std::fclose(file);
+		return true;
+	}
+
+	static GLuint opengl_compile_shader(GLenum type, cstring src)
+	{
+		// Both stages share the one expanded source, only the prefix differs
+		cstring sources[2]{ type == GL_VERTEX_SHADER ? "#version 330 core\n#define VERT\n" : "#version 330 core\n#define FRAG\n", src };
+
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 2, sources, NULL);
+		glCompileShader(shader);
+
+		i32 success = 0;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			char log[1024];
+			glGetShaderInfoLog(shader, 1024, NULL, log);
+			LOGE("Failed to compile %s shader: %s", type == GL_VERTEX_SHADER ? "vertex" : "fragment", log);
+			glDeleteShader(shader);
+			return 0;
+		}
+
+		return shader;
+	}
+
+	static bool opengl_compile_stages(cstring src, GLuint stages[2])
+	{
+		stages[0] = opengl_compile_shader(GL_VERTEX_SHADER, src);
+		stages[1] = opengl_compile_shader(GL_FRAGMENT_SHADER, src);
+		if (stages[0] != 0 && stages[1] != 0)
+			return true;
+
+		if (stages[0]) glDeleteShader(stages[0]);
+		if (stages[1]) glDeleteShader(stages[1]);
+		return false;
+	}
+
+	// Links compiled stages into the program, the stages stay alive so they can be linked again
+	static bool opengl_link_stages(GLuint program, const GLuint stages[2])
+	{
+		// Relinking an existing program replaces its stages, the program id stays the same
+		GLuint attached[2]{};
+		GLsizei count = 0;
+		glGetAttachedShaders(program, 2, &count, attached);
+		for (GLsizei i = 0; i < count; ++i)
+			glDetachShader(program, attached[i]);
+
+		// Link vertex and fragment shader together
+		glAttachShader(program, stages[0]);
+		glAttachShader(program, stages[1]);
+		glLinkProgram(program);
+
+		i32 success = 0;
+		char log[1024];
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glGetProgramInfoLog(program, 1024, NULL, log);
+			LOGE("Failed to link shader program: %s", log);
+			return false;
+		}
+
+		glValidateProgram(program);
+		glGetProgramiv(program, GL_VALIDATE_STATUS, &success);
+		if (!success)
+		{
+			glGetProgramInfoLog(program, 1024, NULL, log);
+			LOGE("Shader validation error: %s", log);
+			return false;
+		}
+
+		return true;
+	}
+
+	static bool opengl_link_program(GLuint program, cstring src)
+	{
+		GLuint stages[2]{};
+		if (!opengl_compile_stages(src, stages))
+			return false;
+
+		const bool linked = opengl_link_stages(program, stages);
+
+		// Delete shaders objects, they are freed once detached from the program
+		glDeleteShader(stages[0]);
+		glDeleteShader(stages[1]);
+		return linked;
+	}
+
+	static u32 gl_shared_block(cstring name, u32 size)
+	{
+		const size_type nameHash = App::Hash(name);
+		for (u32 i = 0; i < (u32)g.blocks.size(); ++i)
+		{
+			if (g.blocks[i].nameHash == nameHash && g.blocks[i].size == size)
+				return i + 1;
+		}
+
+		GLint bindings = 0;
+		glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &bindings);
+		if ((GLint)g.blocks.size() >= bindings)
+		{
+			LOGW("Out of uniform buffer bindings, block %s is left unbound.", name);
+			return 0;
+		}
+
+		for (const auto& block : g.blocks)
+		{
+			if (block.nameHash == nameHash)
+				LOGW("Uniform block %s is declared with another size, it gets a buffer of its own.", name);
+		}
+
+		// The binding point is the block's position and never changes
+		g.blocks.emplace_back();
+		auto& block = g.blocks.back();
+		block.nameHash = nameHash;
+		block.size = size;
+		block.data.resize(size);
+		block.plan.resize(size);
+		block.dirty = g.blocksDirty = true; // Bound by the first upload, zeroed until then
+		return (u32)g.blocks.size();
+	}
+
+	static u32 gl_uniform_entry(GLuint program, const string& name)
+	{
+		const size_type key = gl_uniform_key(program, App::Hash(name.c_str()));
+		const auto it = g.uniformHandles.find(key);
+		if (it != g.uniformHandles.end())
+			return it->second;
+
+		g.uniforms.emplace_back();
+		g.uniforms.back().program = program;
+		g.uniformHandles[key] = (u32)g.uniforms.size();
+		return (u32)g.uniforms.size();
+	}
+
+	// Reflects the active uniforms of a linked program, a relink keeps the handles of the names still active
+	static void opengl_reflect_uniforms(GLuint program)
+	{
+		for (auto& uniform : g.uniforms)
+		{
+			if (uniform.program != program)
+				continue;
+
+			uniform.location = -1;
+			uniform.block = 0;
+			uniform.set = false;
+		}
+
+		char name[256];
+		GLint blocks = 0;
+		glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+		list<u32> shared((size_type)std::max(blocks, 0));
+		for (GLint i = 0; i < blocks; ++i)
+		{
+			GLint size = 0;
+			glGetActiveUniformBlockName(program, (GLuint)i, sizeof(name), nullptr, name);
+			glGetActiveUniformBlockiv(program, (GLuint)i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+			shared[i] = gl_shared_block(name, (u32)size);
+			if (shared[i] != 0)
+				glUniformBlockBinding(program, (GLuint)i, shared[i] - 1);
+		}
+
+		GLint count = 0;
+		glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+		for (GLuint i = 0; i < (GLuint)count; ++i)
+		{
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(program, i, sizeof(name), nullptr, &size, &type, name);
+
+			GLint block = -1, offset = 0, arrayStride = 0, matrixStride = 0, rowMajor = 0;
+			glGetActiveUniformsiv(program, 1, &i, GL_UNIFORM_BLOCK_INDEX, &block);
+			glGetActiveUniformsiv(program, 1, &i, GL_UNIFORM_OFFSET, &offset);
+			glGetActiveUniformsiv(program, 1, &i, GL_UNIFORM_ARRAY_STRIDE, &arrayStride);
+			glGetActiveUniformsiv(program, 1, &i, GL_UNIFORM_MATRIX_STRIDE, &matrixStride);
+			glGetActiveUniformsiv(program, 1, &i, GL_UNIFORM_IS_ROW_MAJOR, &rowMajor);
+
+			// Arrays are reported once as "name[0]", every element gets a handle and the bare name is the first
+			string base = name;
+			const bool array = base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0;
+			if (array)
+				base.resize(base.size() - 3);
+
+			for (GLint e = 0; e < std::max(size, 1); ++e)
+			{
+				const string element = array ? base + "[" + std::to_string(e) + "]" : base;
+				auto& uniform = g.uniforms[gl_uniform_entry(program, element) - 1];
+				if (block < 0)
+				{
+					uniform.location = glGetUniformLocation(program, element.c_str());
+				}
+				else if (shared[block] != 0)
+				{
+					uniform.block = shared[block];
+					uniform.offset = (u32)(offset + e * arrayStride);
+					uniform.matrixStride = (u32)matrixStride;
+					uniform.rowMajor = rowMajor != 0;
+				}
+			}
+
+			if (array)
+				g.uniformHandles[gl_uniform_key(program, App::Hash(base.c_str()))] = gl_uniform_entry(program, base + "[0]");
+		}
+	}
+
+	static void gl_forget_uniforms(GLuint program)
+	{
+		for (auto it = g.uniformHandles.begin(); it != g.uniformHandles.end();)
+			it = g.uniforms[it->second - 1].program == program ? g.uniformHandles.erase(it) : std::next(it);
+
+		for (auto& uniform : g.uniforms)
+		{
+			if (uniform.program != program)
+				continue;
+
+			uniform = sGlUniform{};
+		}
+	}
+
+	static GLuint opengl_load_shader(cstring src)
+	{
+		GLuint program = glCreateProgram();
+		if (!opengl_link_program(program, src))
+		{
+			glDeleteProgram(program);
+			return 0;
+		}
+
+		opengl_reflect_uniforms(program);
+		g.shaders.emplace_back(program);
+		return program;
+	}
+
+	static bool shader_directive(cstring line, cstring end, cstring name)
+	{
+		while (line < end && (*line == ' ' || *line == '\t'))
+			line++;
+		if (line == end || *line != '#')
+			return false;
+
+		line++;
+		while (line < end && (*line == ' ' || *line == '\t'))
+			line++;
+
+		const size_type len = std::strlen(name);
+		return (size_type)(end - line) >= len && std::strncmp(line, name, len) == 0;
+	}
+
+	// Splits the #include "file" lines out of the source, lines are read straight from the mapped bytes
+	static void shader_parse(cstring source, size_type size, sGlShaderUnit& unit)
+	{
+		unit.text.reserve(size + 1);
+
+		i32 depth = 0;
+		cstring end = source + size;
+		while (source < end)
+		{
+			cstring eol = static_cast<cstring>(std::memchr(source, '\n', end - source));
+			if (eol == nullptr)
+				eol = end;
+
+			const size_type len = eol - source;
+			if (shader_directive(source, eol, "include"))
+			{
+				cstring open = static_cast<cstring>(std::memchr(source, '"', len));
+				cstring close = eol - 1;
+				while (close > source && *close != '"')
+					close--;
+
+				if (open != nullptr && open < close)
+				{
+					sGlShaderInclude include{};
+					include.offset = unit.text.size();
+					include.path.assign(open + 1, close);
+					include.pathHash = App::Hash(include.path);
+					unit.includes.emplace_back(std::move(include));
+					unit.text += '\n'; // Keeps the line count of the file
+					source = eol + 1;
+					continue;
+				}
+			}
+			else if (shader_directive(source, eol, "if")) // #if, #ifdef and #ifndef
+				depth++;
+			else if (shader_directive(source, eol, "endif"))
+				unit.balanced &= --depth >= 0;
+
+			unit.text.append(source, len);
+			unit.text += '\n';
+			source = eol + 1;
+		}
+
+		unit.balanced &= depth == 0;
+	}
+
+	static const sGlShaderUnit& shader_unit(cstring filepath, size_type pathHash)
+	{
+		const auto it = g.shaderUnits.find(pathHash);
+		if (it != g.shaderUnits.end())
+			return it->second;
+
+		auto& unit = g.shaderUnits[pathHash];
+		const auto view = App::FileMap(filepath);
+		unit.found = view.size > 0 || App::FileFind(filepath) != nullptr;
+		shader_parse(view.data, view.size, unit);
+		return unit;
+	}
+
+	static void shader_expand(const sGlShaderUnit& unit, cstring filepath, sGlShaderSource& src)
+	{
+		if (!unit.found)
+		{
+			LOGE("Shader file not found: %s", filepath);
+			src.valid = false;
+		}
+		if (!unit.balanced)
+		{
+			LOGE("Unbalanced #if / #endif in shader: %s", filepath);
+			src.valid = false;
+		}
+
+		size_type offset = 0;
+		for (const auto& include : unit.includes)
+		{
+			src.text.append(unit.text, offset, include.offset - offset);
+			offset = include.offset;
+
+			if (std::find(src.stack.begin(), src.stack.end(), include.pathHash) != src.stack.end())
+			{
+				LOGE("Shader include cycle: %s includes %s", filepath, include.path.c_str());
+				src.valid = false;
+				continue;
+			}
+			if (std::find(src.files.begin(), src.files.end(), include.pathHash) != src.files.end())
+				continue; // Already emitted
+
+			// The unit reference stays valid, the cache only grows during an expansion
+			src.files.push_back(include.pathHash);
+			src.stack.push_back(include.pathHash);
+			shader_expand(shader_unit(include.path.c_str(), include.pathHash), include.path.c_str(), src);
+			src.stack.pop_back();
+		}
+		src.text.append(unit.text, offset, string::npos);
+	}
+
+	static bool shader_load_source(cstring filepath, sGlShaderSource& src)
+	{
+		const size_type pathHash = App::Hash(filepath);
+		src.files.push_back(pathHash);
+		src.stack.push_back(pathHash);
+		shader_expand(shader_unit(filepath, pathHash), filepath, src);
+		return src.valid;
+	}
+
+	u32 App::GlLoadShader(cstring filepath)
+	{
+		PROFILE("GlLoadShader");
+
+		if (!gl_context() || gl_recording("glLoadShader"))
+			return 0;
+
+		sGlShaderSource src{};
+		auto shader = shader_load_source(filepath, src) ? opengl_load_shader(src.text.c_str()) : 0;
+		if (shader == 0)
+		{
+			LOGW("Failed to load shader from file: %s", filepath);
+			return shader;
+		}
+
+		sGlShaderFile file{};
+		file.program = shader;
+		file.path = filepath;
+		file.files = std::move(src.files);
+		g.shaderFiles.emplace_back(std::move(file));
+		return shader;
+	}
+
+	u32 App::GlCreateShader(cstring source)
+	{
+		PROFILE("GlCreateShader");
+
+		if (!gl_context() || gl_recording("glCreateShader"))
+			return 0;
+
+		// Inline source isn't cached, the files it includes are
+		sGlShaderUnit unit{};
+		shader_parse(source, std::strlen(source), unit);
+
+		sGlShaderSource src{};
+		shader_expand(unit, "<source>", src);
+		auto shader = src.valid ? opengl_load_shader(src.text.c_str()) : 0;
+		if (shader == 0)
+			LOGW("Failed to create shader from source.");
+		return shader;
+	}
+
+	void App::GlDestroyShader(u32 shader)
+	{
+		if (gl_record)
+		{
+			gl_record_cmd(eGlCmd::DESTROY_SHADER).u[0] = shader;
+			return;
+		}
+
+		if (!gl_context())
+			return;
+
+		glDeleteProgram(shader);
+		gl_forget_uniforms(shader);
+
+		auto it = std::remove_if(g.shaderFiles.begin(), g.shaderFiles.end(), [shader](const sGlShaderFile& file) { return file.program == shader; });
+		g.shaderFiles.erase(it, g.shaderFiles.end());
+	}
+
+	u32 App::GlReloadShaders(const list<sFileInfo>& changed)
+	{
+		PROFILE("GlReloadShaders");
+
+		if (!gl_context())
+			return 0;
+
+		// Edited files are parsed again, the units they include stay cached
+		for (const auto& info : changed)
+			g.shaderUnits.erase(info.pathHash);
+
+		u32 count = 0;
+		for (auto& file : g.shaderFiles)
+		{
+			bool dirty = false;
+			for (const auto& info : changed)
+				dirty |= std::find(file.files.begin(), file.files.end(), info.pathHash) != file.files.end();
+			if (!dirty)
+				continue;
+
+			// Compiled once and linked into a scratch program first, a broken edit keeps the running program untouched.
+			// Scripts hold the program id, so the validated stages are then linked into it in place.
+			sGlShaderSource src{};
+			GLuint stages[2]{};
+			bool valid = shader_load_source(file.path.c_str(), src) && opengl_compile_stages(src.text.c_str(), stages);
+			if (valid)
+			{
+				GLuint scratch = glCreateProgram();
+				valid = opengl_link_stages(scratch, stages) && opengl_link_stages(file.program, stages);
+				glDeleteProgram(scratch);
+				glDeleteShader(stages[0]);
+				glDeleteShader(stages[1]);
+			}
+
+			// An include added by the edit is watched from now on, even when the program failed to link
+			file.files = std::move(src.files);
+			if (!valid)
+			{
+				LOGW("Failed to reload shader from file: %s", file.path.c_str());
+				continue;
+			}
+			opengl_reflect_uniforms(file.program);
+
+			count++;
+		}
+
+		return count;
+	}
+
+	bool App::GlPreprocessShader(cstring filepath, string& out)
+	{
+		PROFILE("GlPreprocessShader");
+
+		// No driver involved, runs headless too
+		sGlShaderSource src{};
+		const bool valid = shader_load_source(filepath, src);
+		out = std::move(src.text);
+		return valid;
+	}
+
+	void App::GlSetShader(u32 shader)
+	{
+		if (gl_record)
+		{
+			gl_record_cmd(eGlCmd::SHADER).u[0] = shader;
+			return;
+		}
+
+		g.shader = shader;
+		if (gl_context())
+			glUseProgram(g.shader);
+	}
+
+	static size_type gl_image_bytes(i32 w, i32 h, i32 c, u32 levels)
+	{
+		size_type bytes = 0;
+		for (u32 i = 0; i < std::max(1u, levels); ++i)
+			bytes += (size_type)std::max(1, w >> i) * std::max(1, h >> i) * c;
+		return bytes;
+	}
+
+	static bool gl_read_image_blob(const sFileView& view, sGlImage& img)
+	{
+		if (view.size < sizeof(sGlImageBlob))
+			return false;
+
+		sGlImageBlob blob{};
+		std::memcpy(&blob, view.data, sizeof(blob));
+		const size_type bytes = blob.w > 0 && blob.h > 0 && blob.c > 0 && blob.levels <= 32 ? gl_image_bytes(blob.w, blob.h, blob.c, blob.levels) : 0;
+		if (bytes == 0 || view.size < sizeof(sGlImageBlob) + bytes)
+			return false;
+
+		img.w = blob.w;
+		img.h = blob.h;
+		img.c = blob.c;
+		img.levels = std::max(1u, blob.levels);
+		img.data = static_cast<u8*>(App::MemAlloc(eMemTag::GRAPHICS, bytes));
+		std::memcpy(img.data, view.data + sizeof(sGlImageBlob), bytes);
+		return true;
+	}
+
+	static void gl_decode_image(void* data)
+	{
+		PROFILE("GlDecodeImage");
+
+		auto* load = static_cast<sGlImageLoad*>(data);
+		auto& img = load->image;
+
+		// Baked images are already flipped and mipmapped, the source isn't read at all
+		{
+			const auto baked = App::FileBakedLoad(load->path.c_str(), load->flipY ? "image 1 flip" : "image 1");
+			if (!baked.empty() && gl_read_image_blob(baked, img))
+				return;
+		}
+
+		const auto content = App::FileMap(load->path.c_str());
+		if (content.empty())
+			return;
+
+		// Cached as raw texels after the size
+		const size_type key = App::FileCacheKey(content, load->flipY ? "image 1 flip" : "image 1");
+		const auto cached = App::FileCacheLoad(key);
+		if (!cached.empty())
+		{
+			if (gl_read_image_blob(cached, img))
+				return;
+			App::FileCacheReject(key);
+		}
+
+		stbi_set_flip_vertically_on_load_thread(load->flipY);
+		img.data = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(content.data), (i32)content.size, &img.w, &img.h, &img.c, 0);
+		if (img.data == nullptr)
+			return;
+
+		sGlImageBlob blob{ img.w, img.h, img.c, 0 };
+		const size_type bytes = (size_type)img.w * img.h * img.c;
+		list<u8> payload(sizeof(blob) + bytes);
+		std::memcpy(payload.data(), &blob, sizeof(blob));
+		std::memcpy(payload.data() + sizeof(blob), img.data, bytes);
+		App::FileCacheStore(key, payload.data(), payload.size());
+	}
+
+	// Box filtered level below, odd edges repeat their last texel
+	static void gl_downsample(const u8* src, i32 w, i32 h, i32 c, u8* dst)
+	{
+		const i32 dw = std::max(1, w >> 1), dh = std::max(1, h >> 1);
+		for (i32 y = 0; y < dh; ++y)
+		{
+			const u8* row0 = src + (size_type)std::min(y * 2, h - 1) * w * c;
+			const u8* row1 = src + (size_type)std::min(y * 2 + 1, h - 1) * w * c;
+			for (i32 x = 0; x < dw; ++x)
+			{
+				const i32 x0 = std::min(x * 2, w - 1) * c, x1 = std::min(x * 2 + 1, w - 1) * c;
+				for (i32 i = 0; i < c; ++i)
+					*dst++ = (u8)((row0[x0 + i] + row0[x1 + i] + row1[x0 + i] + row1[x1 + i] + 2) >> 2);
+			}
+		}
+	}
+
+	static bool gl_bake_image(cstring filepath, const u8* texels, i32 w, i32 h, i32 c, bool flipY)
+	{
+		u32 levels = 1;
+		while ((w >> levels) > 0 || (h >> levels) > 0)
+			levels++;
+
+		sGlImageBlob blob{ w, h, c, levels };
+		list<u8> payload(sizeof(blob) + gl_image_bytes(w, h, c, levels));
+		std::memcpy(payload.data(), &blob, sizeof(blob));
+
+		// First level in load order, then each level from the one above
+		u8* level = payload.data() + sizeof(blob);
+		const size_type pitch = (size_type)w * c;
+		for (i32 y = 0; y < h; ++y)
+			std::memcpy(level + y * pitch, texels + (flipY ? h - 1 - y : y) * pitch, pitch);
+
+		for (u32 i = 1; i < levels; ++i)
+		{
+			const i32 lw = std::max(1, w >> (i - 1)), lh = std::max(1, h >> (i - 1));
+			u8* next = level + (size_type)lw * lh * c;
+			gl_downsample(level, lw, lh, c, next);
+			level = next;
+		}
+
+		return App::FileBakedStore(filepath, flipY ? "image 1 flip" : "image 1", payload.data(), payload.size());
+	}
+
+	bool App::GlBakeImage(cstring filepath)
+	{
+		PROFILE("GlBakeImage");
+
+		// Both orientations, the loader picks one per call
+		if (FileBakedFresh(filepath, "image 1") && FileBakedFresh(filepath, "image 1 flip"))
+			return true;
+
+		const auto content = FileMap(filepath);
+		i32 w = 0, h = 0, c = 0;
+		stbi_set_flip_vertically_on_load_thread(false);
+		u8* texels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(content.data), (i32)content.size, &w, &h, &c, 0);
+		if (texels == nullptr)
+		{
+			LOGW("Failed to bake image: %s", filepath);
+			return false;
+		}
+
+		const bool baked = gl_bake_image(filepath, texels, w, h, c, false) && gl_bake_image(filepath, texels, w, h, c, true);
+		stbi_image_free(texels);
+		return baked;
+	}
+
+	static sGlImage* gl_get_image(u32 image)
+	{
+		if (image == 0 || image > g.images.size())
+		{
+			LOGW("Invalid image handle!");
+			return nullptr;
+		}
+
+		auto* img = &g.images[static_cast<size_type>(image) - 1];
+		if (img->load)
+		{
+			auto* load = img->load;
+			App::JobWait(load->counter);
+			*img = load->image;
+			if (!img->data)
+				LOGW("Failed to load image: %s", load->path.c_str());
+			delete load;
+		}
+
+		return img;
+	}
+
+	u32 App::GlLoadImage(cstring filepath, bool flipY)
+	{
+		PROFILE("GlLoadImage");
+
+		// Decoding starts now and overlaps with the next loads, the first use of the handle waits for it
+		auto* load = new sGlImageLoad();
+		load->path = filepath;
+		load->flipY = flipY;
+		JobSubmit(gl_decode_image, load, &load->counter);
+
+		sGlImage img{};
+		img.load = load;
+		g.images.emplace_back(img);
+		return (u32)(g.images.size());
+	}
+
+	static bool gl_image_ready(const sGlImage& img)
+	{
+		return img.load == nullptr || img.load->counter.pending.load(std::memory_order_acquire) == 0;
+	}
+
+	bool App::GlImageReady(u32 image)
+	{
+		if (image == 0 || image > g.images.size())
+			return false;
+
+		return gl_image_ready(g.images[static_cast<size_type>(image) - 1]);
+	}
+
+	u32 App::GlCreateImage(i32 w, i32 h, i32 c, u8* data)
+	{
+		sGlImage img{ w, h, c, data };
+
+		g.images.emplace_back(img);
+		return (u32)(g.images.size());
+	}
+
+	void App::GlDestroyImage(u32 image)
+	{
+		auto img = gl_get_image(image);
+		if (img == nullptr) return;
+		stbi_image_free(img->data);
+		*img = sGlImage{};
+	}
+
+	i32 App::GlImageWidth(u32 image)
+	{
+		auto img = gl_get_image(image);
+		if (img == nullptr) return 0;
+		return img->w;
+	}
+
+	i32 App::GlImageHeight(u32 image)
+	{
+		auto img = gl_get_image(image);
+		if (img == nullptr) return 0;
+		return img->h;
+	}
+
+	i32 App::GlImageChannels(u32 image)
+	{
+		auto img = gl_get_image(image);
+		if (img == nullptr) return 0;
+		return img->c;
+	}
+
+	u8* App::GlImageData(u32 image)
+	{
+		auto img = gl_get_image(image);
+		if (img == nullptr) return nullptr;
+		return img->data;
+	}
+
+	static void gltf_free(cgltf_data* data)
+	{
+		if (data != nullptr)
 			cgltf_free(data);
 	}
 
-	static cgltf_data* gltf_load(cstring filepath)
+	static void* gltf_alloc(void* user, cgltf_size size) { return App::MemAlloc(eMemTag::GRAPHICS, size); }
+	static void gltf_dealloc(void* user, void* ptr) { App::MemFree(ptr); }
+
+	// Meshes are extracted in parallel into their own buffer, then gathered into the model in order
+	struct sGltfMeshJob
+	{
+		const cgltf_mesh* mesh{ nullptr };
+		sGlMesh glMesh{}; // Ranges relative to data until gathered
+		list<f32> data{};
+	};
+
+	// A model in its own index space, appended to the global model data on the main thread
+	struct sGltfModel
+	{
+		list<f32> data{};
+		list<sGlMesh> meshes{};
+		list<sGlAnim> anims{};
+		list<sGlNode> nodes{};
+	};
+
+	// Reading, parsing and extraction run on the job system, gltf_append_model adds the result on the main thread
+	struct sGlModelLoad
+	{
+		string path{};
+		size_type key{ 0 };	// Asset cache key of the model file
+		list<sFileView> views{}; // The model file first, referenced by the glTF data until it is freed
+		list<std::pair<string, size_type>> buffers{}; // External buffers and their content hash
+		cgltf_data* data{ nullptr };
+		list<sGltfMeshJob> meshes{};
+		sGltfModel model{};
+		bool loaded{ false };
+		u32 handle{ 0 };
+		sJobCounter meshCounter{};
+		sJobCounter counter{};
+	};
+
+	// The model and its external buffers are read through file views, kept alive by the load until the data is freed
+	static cgltf_result gltf_read(const cgltf_memory_options* memory, const cgltf_file_options* file, cstring path, cgltf_size* size, void** data)
+	{
+		auto content = App::FileMap(path);
+		if (content.empty())
+			return cgltf_result_file_not_found;
+
+		auto* load = static_cast<sGlModelLoad*>(file->user_data);
+		load->buffers.emplace_back(path, App::Hash(content.data, content.size));
+		*size = content.size;
+		*data = const_cast<char*>(content.data);
+		load->views.push_back(std::move(content));
+		return cgltf_result_success;
+	}
+
+	static void gltf_release(const cgltf_memory_options* memory, const cgltf_file_options* file, void* data) {}
+
+	static cgltf_data* gltf_load(sGlModelLoad& load)
 	{
+		cstring filepath = load.path.c_str();
 		cgltf_options options = {};
+		options.memory.alloc_func = gltf_alloc;
+		options.memory.free_func = gltf_dealloc;
+		options.file.read = gltf_read;
+		options.file.release = gltf_release;
+		options.file.user_data = &load;
 		cgltf_data* data{ nullptr };
 
-		cgltf_result result = cgltf_parse_file(&options, filepath, &data);
+		cgltf_result result = cgltf_parse(&options, load.views.front().data, load.views.front().size, &data);
 		if (result != cgltf_result_success)
 		{
 			LOGW("Failed to parse glTF file: %s", filepath);
@@ -836,144 +2795,594 @@ namespace GASandbox
 		return data;
 	}
 
-	static void gltf_extract_mesh_data(const cgltf_mesh& mesh)
+	static u32 gltf_mesh_attr(cgltf_attribute_type type)
+	{
+		switch (type)
+		{
+		case cgltf_attribute_type_position: return (u32)sGlMeshAttr::POSITION;
+		case cgltf_attribute_type_normal: return (u32)sGlMeshAttr::NORMAL;
+		case cgltf_attribute_type_texcoord: return (u32)sGlMeshAttr::TEXCOORD;
+		case cgltf_attribute_type_tangent: return (u32)sGlMeshAttr::TANGENT;
+		case cgltf_attribute_type_color: return (u32)sGlMeshAttr::COLOR;
+		default: return (u32)sGlMeshAttr::COUNT;
+		}
+	}
+
+	static void gltf_extract_mesh_data(sGltfMeshJob& job)
 	{
-		sGlMesh glMesh;
+		const cgltf_mesh& mesh = *job.mesh;
+		sGlMesh& glMesh = job.glMesh;
 
 		for (cgltf_size i = 0; i < mesh.primitives_count; ++i)
 		{
 			const cgltf_primitive& prim = mesh.primitives[i];
 
-			// Extracting attributes
+			// Extracting attributes, the first set of each
 			for (cgltf_size j = 0; j < prim.attributes_count; ++j)
 			{
-				const cgltf_attribute& attribute = prim.attributes[j];
-				u64& attributeHandle = glMesh.attributes[(u32)attribute.type];
-
-				// Allocate space in global model data and link the attribute buffer
-				if (attributeHandle == 0) {
-					attributeHandle = gl_encode_range(g.g_modelData.size(), attribute.data->count);
-					// Add attribute data to the global buffer here (e.g., position, normal, etc.)
-					for (cgltf_size k = 0; k < attribute.data->count; ++k) {
-						const cgltf_accessor& accessor = *attribute.data;
-						// Convert data based on type and store in g.g_modelData
-						// Example: copying float data for POSITION
-						if (accessor.type == cgltf_type_vec3) {
-							const float* position = (const float*)accessor.buffer_view->buffer->data + accessor.offset;
-							g.g_modelData.insert(g.g_modelData.end(), position, position + 3);
-						}
-					}
+				const cgltf_attribute& attribute = prim.attributes[j];
+				const u32 attr = gltf_mesh_attr(attribute.type);
+				if (attr == (u32)sGlMeshAttr::COUNT || attribute.index != 0)
+					continue;
+
+				// Allocate space in the mesh data and link the attribute buffer
+				u64& attributeHandle = glMesh.attributes[attr];
+				if (attributeHandle == 0) {
+					const cgltf_accessor& accessor = *attribute.data;
+					attributeHandle = gl_encode_range(job.data.size(), accessor.count);
+					// Converted to floats, a missing alpha reads as opaque
+					const u32 size = GL_MESH_ATTR_SIZE[attr];
+					for (cgltf_size k = 0; k < accessor.count; ++k) {
+						f32 v[4]{ 0, 0, 0, 1 };
+						cgltf_accessor_read_float(&accessor, k, v, size);
+						job.data.insert(job.data.end(), v, v + size);
+					}
+				}
+			}
+
+			// Extracting indices
+			if (prim.indices)
+			{
+				u64& indicesHandle = glMesh.indices;
+				if (indicesHandle == 0) {
+					indicesHandle = gl_encode_range(job.data.size(), prim.indices->count);
+					for (cgltf_size k = 0; k < prim.indices->count; ++k)
+						job.data.push_back((f32)cgltf_accessor_read_index(prim.indices, k));
+				}
+			}
+		}
+	}
+
+	static void gltf_extract_mesh(void* data)
+	{
+		gltf_extract_mesh_data(*static_cast<sGltfMeshJob*>(data));
+	}
+
+	static u64 gltf_rebase_range(u64 range, size_type base)
+	{
+		return range == 0 ? 0 : gl_encode_range(gl_extract_index(range) + (u32)base, gl_extract_count(range));
+	}
+
+	static void gltf_extract_node_data(const cgltf_node& node, list<sGlNode>& nodes)
+	{
+		sGlNode glNode;
+
+		glNode.name = node.name ? node.name : "Unnamed";
+
+		// Extracting mesh and animation references
+		//if (node.mesh)
+		//	glNode.mesh = g.g_meshes.size() + 1;  // Store mesh handle
+		//if (node.animation)
+		//	glNode.anim = g.g_anims.size() + 1; // Store animation handle
+
+		// Extracting children (stored as a range of indices)
+		u32 childStart = nodes.size();
+		for (cgltf_size i = 0; i < node.children_count; ++i)
+		{
+			gltf_extract_node_data(*node.children[i], nodes);
+		}
+		u32 childEnd = nodes.size();
+		glNode.children = gl_encode_range(childStart, childEnd - childStart);
+
+		nodes.push_back(glNode);
+	}
+
+	static sGlAnim gltf_extract_animation_data(const cgltf_animation& animation)
+	{
+		sGlAnim glAnim;
+		glAnim.name = animation.name ? animation.name : "Unnamed";
+
+		for (cgltf_size i = 0; i < animation.channels_count; ++i)
+		{
+			const cgltf_animation_channel& channel = animation.channels[i];
+			switch (channel.target_path) {
+			case cgltf_animation_path_type_translation:
+				// Store translation data (timestamp + vec3 translation)
+				break;
+			case cgltf_animation_path_type_rotation:
+				// Store rotation data (timestamp + quat rotation)
+				break;
+			case cgltf_animation_path_type_scale:
+				// Store scale data (timestamp + vec3 scale)
+				break;
+			default:
+				break;
+		}
+	}
+
+		return glAnim;
+	}
+
+	// Cached model: external buffers with their hash, then the data, meshes, animations and nodes, each list after its count
+	static void gltf_write(list<u8>& blob, const void* data, size_type size)
+	{
+		const auto* bytes = static_cast<const u8*>(data);
+		blob.insert(blob.end(), bytes, bytes + size);
+	}
+
+	static void gltf_write_string(list<u8>& blob, const string& str)
+	{
+		const u32 size = (u32)str.size();
+		gltf_write(blob, &size, sizeof(size));
+		gltf_write(blob, str.data(), size);
+	}
+
+	struct sGltfReader
+	{
+		cstring at{ nullptr };
+		cstring end{ nullptr };
+
+		bool read(void* data, size_type size)
+		{
+			if ((size_type)(end - at) < size)
+				return false;
+			std::memcpy(data, at, size);
+			at += size;
+			return true;
+		}
+
+		bool read(string& str)
+		{
+			u32 size = 0;
+			if (!read(&size, sizeof(size)) || (size_type)(end - at) < size)
+				return false;
+			str.assign(at, size);
+			at += size;
+			return true;
+		}
+
+		template<typename T>
+		bool read(list<T>& items)
+		{
+			u64 count = 0;
+			if (!read(&count, sizeof(count)) || count > (u64)(end - at) / sizeof(T))
+				return false;
+			items.resize((size_type)count);
+			return read(items.data(), items.size() * sizeof(T));
+		}
+	};
+
+	static void gltf_write_model(const sGlModelLoad& load, list<u8>& blob)
+	{
+		const auto& model = load.model;
+		u64 count = load.buffers.size();
+		gltf_write(blob, &count, sizeof(count));
+		for (const auto& buffer : load.buffers)
+		{
+			const u64 hash = buffer.second;
+			gltf_write_string(blob, buffer.first);
+			gltf_write(blob, &hash, sizeof(hash));
+		}
+
+		count = model.data.size();
+		gltf_write(blob, &count, sizeof(count));
+		gltf_write(blob, model.data.data(), model.data.size() * sizeof(f32));
+
+		count = model.meshes.size();
+		gltf_write(blob, &count, sizeof(count));
+		gltf_write(blob, model.meshes.data(), model.meshes.size() * sizeof(sGlMesh));
+
+		count = model.anims.size();
+		gltf_write(blob, &count, sizeof(count));
+		for (const auto& anim : model.anims)
+		{
+			gltf_write_string(blob, anim.name);
+			gltf_write(blob, &anim.translations, sizeof(u64) * 3);
+		}
+
+		count = model.nodes.size();
+		gltf_write(blob, &count, sizeof(count));
+		for (const auto& node : model.nodes)
+		{
+			gltf_write_string(blob, node.name);
+			gltf_write(blob, &node.children, sizeof(node.children));
+			gltf_write(blob, &node.mesh, sizeof(u32) * 3);
+		}
+	}
+
+	static void gltf_store_model(const sGlModelLoad& load)
+	{
+		PROFILE("GlStoreModel");
+
+		list<u8> blob{};
+		gltf_write_model(load, blob);
+		App::FileCacheStore(load.key, blob.data(), blob.size());
+	}
+
+	static bool gltf_load_cached(const sFileView& cached, sGlModelLoad& load)
+	{
+		PROFILE("GlLoadCachedModel");
+
+		sGltfReader reader{ cached.data, cached.data + cached.size };
+		u64 count = 0;
+		if (!reader.read(&count, sizeof(count)))
+			return false;
+
+		// The key only covers the model file, its buffers are checked here
+		for (u64 i = 0; i < count; ++i)
+		{
+			string path{};
+			u64 hash = 0;
+			if (!reader.read(path) || !reader.read(&hash, sizeof(hash)))
+				return false;
+
+			const auto content = App::FileMap(path.c_str());
+			if (content.empty() || App::Hash(content.data, content.size) != hash)
+				return false;
+			load.buffers.emplace_back(std::move(path), (size_type)hash);
+		}
+
+		auto& model = load.model;
+		if (!reader.read(model.data) || !reader.read(model.meshes))
+			return false;
+
+		if (!reader.read(&count, sizeof(count)))
+			return false;
+		for (u64 i = 0; i < count; ++i)
+		{
+			sGlAnim anim{};
+			if (!reader.read(anim.name) || !reader.read(&anim.translations, sizeof(u64) * 3))
+				return false;
+			model.anims.push_back(anim);
+		}
+
+		if (!reader.read(&count, sizeof(count)))
+			return false;
+		for (u64 i = 0; i < count; ++i)
+		{
+			sGlNode node{};
+			if (!reader.read(node.name) || !reader.read(&node.children, sizeof(node.children)) || !reader.read(&node.mesh, sizeof(u32) * 3))
+				return false;
+			model.nodes.push_back(node);
+		}
+
+		return true;
+	}
+
+	static void gltf_gather_model(void* data)
+	{
+		PROFILE("GlGatherModel");
+
+		auto* load = static_cast<sGlModelLoad*>(data);
+		auto& model = load->model;
+		for (auto& mesh : load->meshes)
+		{
+			const size_type base = model.data.size();
+			for (auto& attribute : mesh.glMesh.attributes)
+				attribute = gltf_rebase_range(attribute, base);
+			mesh.glMesh.indices = gltf_rebase_range(mesh.glMesh.indices, base);
+
+			model.data.insert(model.data.end(), mesh.data.begin(), mesh.data.end());
+			model.meshes.push_back(mesh.glMesh);
+		}
+
+		// Extract animations
+		for (cgltf_size i = 0; i < load->data->animations_count; ++i)
+		{
+			model.anims.push_back(gltf_extract_animation_data(load->data->animations[i]));
+		}
+
+		// Extract nodes (scenegraph)
+		for (cgltf_size i = 0; load->data->scene && i < load->data->scene->nodes_count; ++i)
+		{
+			gltf_extract_node_data(*load->data->scene->nodes[i], model.nodes);
+		}
+
+		gltf_free(load->data); // Done with glTF data
+		load->data = nullptr;
+		load->meshes.clear();
+		load->views.clear();
+
+		gltf_store_model(*load);
+		load->loaded = true;
+	}
+
+	static void gltf_decode_model(void* data)
+	{
+		PROFILE("GlDecodeModel");
+
+		auto* load = static_cast<sGlModelLoad*>(data);
+
+		// Baked models come interleaved and index optimized, their external buffers are still checked
+		{
+			const auto baked = App::FileBakedLoad(load->path.c_str(), "model 2");
+			if (!baked.empty())
+			{
+				if (gltf_load_cached(baked, *load))
+				{
+					load->loaded = true;
+					return;
+				}
+				load->model = sGltfModel{};
+				load->buffers.clear();
+			}
+		}
+
+		auto content = App::FileMap(load->path.c_str());
+		if (content.empty())
+			return;
+
+		load->key = App::FileCacheKey(content, "model 2");
+		{
+			const auto cached = App::FileCacheLoad(load->key);
+			if (!cached.empty())
+			{
+				if (gltf_load_cached(cached, *load))
+				{
+					load->loaded = true;
+					return;
+				}
+				App::FileCacheReject(load->key);
+				load->model = sGltfModel{};
+				load->buffers.clear();
+			}
+		}
+
+		load->views.push_back(std::move(content));
+		load->data = gltf_load(*load);
+		if (load->data == nullptr)
+			return;
+
+		// Extract meshes, one job each, then gather them once they are all done
+		load->meshes.resize(load->data->meshes_count);
+		for (cgltf_size i = 0; i < load->data->meshes_count; ++i)
+		{
+			load->meshes[i].mesh = &load->data->meshes[i];
+			App::JobSubmit(gltf_extract_mesh, &load->meshes[i], &load->meshCounter);
+		}
+		App::JobSubmit(gltf_gather_model, load, &load->counter, &load->meshCounter);
+	}
+
+	// Vertices interleaved and renumbered in the order the indices first fetch them, exact duplicates merged, so the
+	// vertex fetch walks memory forward. Triangle order is kept.
+	static sGlMesh gltf_bake_mesh(const list<f32>& src, const sGlMesh& mesh, list<f32>& data)
+	{
+		constexpr u32 count = (u32)sGlMeshAttr::COUNT;
+		u32 offsets[count]{};
+		u32 stride = 0;
+		u32 vertices = 0;
+		for (u32 a = 0; a < count; ++a)
+		{
+			if (mesh.attributes[a] == 0)
+				continue;
+			offsets[a] = stride;
+			stride += GL_MESH_ATTR_SIZE[a];
+			const u32 elements = gl_extract_count(mesh.attributes[a]);
+			vertices = vertices == 0 ? elements : std::min(vertices, elements);
+		}
+		if (vertices == 0 || mesh.stride != 0)
+			return mesh;
+
+		list<u32> indices(mesh.indices ? gl_extract_count(mesh.indices) : vertices);
+		for (u32 i = 0; i < (u32)indices.size(); ++i)
+			indices[i] = mesh.indices ? std::min((u32)src[gl_extract_index(mesh.indices) + i], vertices - 1) : i;
+
+		list<f32> baked{};
+		list<u32> remap(vertices, ~0u);
+		hashmap<size_type, u32> unique{};
+		list<f32> vertex(stride);
+		u32 next = 0;
+		for (auto& index : indices)
+		{
+			if (remap[index] == ~0u)
+			{
+				for (u32 a = 0; a < count; ++a)
+				{
+					if (mesh.attributes[a] == 0)
+						continue;
+					const f32* element = src.data() + gl_extract_index(mesh.attributes[a]) + (size_type)index * GL_MESH_ATTR_SIZE[a];
+					std::copy(element, element + GL_MESH_ATTR_SIZE[a], vertex.begin() + offsets[a]);
 				}
-			}
 
-			// Extracting indices
-			if (prim.indices)
-			{
-				u64& indicesHandle = glMesh.indices;
-				if (indicesHandle == 0) {
-					indicesHandle = gl_encode_range(g.g_modelData.size(), prim.indices->count);
-					// Allocate space in the global model data buffer for indices and copy them
-					const u32* indices = (const u32*)prim.indices->buffer_view->buffer->data + prim.indices->offset;
-					g.g_modelData.insert(g.g_modelData.end(), indices, indices + prim.indices->count);
+				// A hash collision only costs a duplicate
+				const size_type hash = App::Hash(reinterpret_cast<cstring>(vertex.data()), stride * sizeof(f32));
+				const auto it = unique.find(hash);
+				if (it != unique.end() && std::equal(vertex.begin(), vertex.end(), baked.begin() + (size_type)it->second * stride))
+					remap[index] = it->second;
+				else
+				{
+					unique.emplace(hash, next);
+					baked.insert(baked.end(), vertex.begin(), vertex.end());
+					remap[index] = next++;
 				}
 			}
+			index = remap[index];
 		}
 
-		g.g_meshes.push_back(glMesh);
+		sGlMesh result{};
+		result.stride = stride;
+		const u32 base = (u32)data.size();
+		for (u32 a = 0; a < count; ++a)
+			result.attributes[a] = mesh.attributes[a] == 0 ? 0 : gl_encode_range(base + offsets[a], next);
+		data.insert(data.end(), baked.begin(), baked.end());
+
+		// Always indexed, merging duplicates needs the indices even if the source had none
+		result.indices = gl_encode_range((u32)data.size(), (u32)indices.size());
+		for (const auto index : indices)
+			data.push_back((f32)index);
+		return result;
 	}
 
-	static void gltf_extract_node_data(const cgltf_node& node, u64& childrenRange)
+	bool App::GlBakeModel(cstring filepath)
 	{
-		sGlNode glNode;
+		PROFILE("GlBakeModel");
 
-		glNode.name = node.name ? node.name : "Unnamed";
-
-		// Extracting mesh and animation references
-		//if (node.mesh)
-		//	glNode.mesh = g.g_meshes.size() + 1;  // Store mesh handle
-		//if (node.animation)
-		//	glNode.anim = g.g_anims.size() + 1; // Store animation handle
+		if (FileBakedFresh(filepath, "model 2"))
+			return true;
 
-		// Extracting children (stored as a range of indices)
-		u32 childStart = g.g_nodes.size();
-		for (cgltf_size i = 0; i < node.children_count; ++i)
+		sGlModelLoad load{};
+		load.path = filepath;
+		gltf_decode_model(&load);
+		JobWait(load.counter);
+		if (!load.loaded)
 		{
-			gltf_extract_node_data(*node.children[i], childrenRange);
+			LOGW("Failed to bake model: %s", filepath);
+			return false;
 		}
-		u32 childEnd = g.g_nodes.size();
-		glNode.children = gl_encode_range(childStart, childEnd - childStart);
 
-		g.g_nodes.push_back(glNode);
+		sGltfModel model{};
+		for (const auto& mesh : load.model.meshes)
+			model.meshes.push_back(gltf_bake_mesh(load.model.data, mesh, model.data));
+		model.anims = load.model.anims;
+		model.nodes = load.model.nodes;
+		load.model = std::move(model);
+
+		// Edited buffers make the bake stale too
+		list<string> depends{};
+		for (const auto& buffer : load.buffers)
+			depends.push_back(buffer.first);
+
+		list<u8> blob{};
+		gltf_write_model(load, blob);
+		return FileBakedStore(filepath, "model 2", blob.data(), blob.size(), depends);
 	}
 
-	static void gltf_extract_animation_data(const cgltf_animation& animation)
+	static u32 gltf_append_model(const sGltfModel& model)
 	{
-		sGlAnim glAnim;
-		glAnim.name = animation.name ? animation.name : "Unnamed";
+		PROFILE("GlAppendModel");
 
-		for (cgltf_size i = 0; i < animation.channels_count; ++i)
+		const size_type base = g.g_modelData.size();
+		for (auto mesh : model.meshes)
 		{
-			const cgltf_animation_channel& channel = animation.channels[i];
-			switch (channel.target_path) {
-			case cgltf_animation_path_type_translation:
-				// Store translation data (timestamp + vec3 translation)
-				break;
-			case cgltf_animation_path_type_rotation:
-				// Store rotation data (timestamp + quat rotation)
-				break;
-			case cgltf_animation_path_type_scale:
-				// Store scale data (timestamp + vec3 scale)
-				break;
-			default:
-				break;
+			for (auto& attribute : mesh.attributes)
+				attribute = gltf_rebase_range(attribute, base);
+			mesh.indices = gltf_rebase_range(mesh.indices, base);
+			g.g_meshes.push_back(mesh);
+		}
+		g.g_modelData.insert(g.g_modelData.end(), model.data.begin(), model.data.end());
+		g.g_anims.insert(g.g_anims.end(), model.anims.begin(), model.anims.end());
+
+		const u32 nodes = (u32)g.g_nodes.size();
+		for (auto node : model.nodes)
+		{
+			node.children = gl_encode_range(gl_extract_index(node.children) + nodes, gl_extract_count(node.children));
+			g.g_nodes.push_back(node);
 		}
+
+		return (u32)g.g_nodes.size(); // Root node
 	}
 
-		g.g_anims.push_back(glAnim);
+	static void gltf_drop_loads()
+	{
+		for (auto* load : g.modelLoads)
+		{
+			App::JobWait(load->counter);
+			delete load;
+		}
+		g.modelLoads.clear();
 	}
 
 	u32 App::GlLoadModel(cstring filepath)
 	{
-	#ifdef _DEBUG
-		string pathStr = PROJECT_PATH;
-		pathStr += filepath;
-		cstring path = pathStr.c_str();
-	#else
-		cstring path = filepath;
-	#endif
+		PROFILE("GlLoadModel");
 
-		auto data = gltf_load(path);
-		if (data == nullptr)
+		sGlModelLoad load{};
+		load.path = filepath;
+		gltf_decode_model(&load);
+		JobWait(load.counter);
+		if (!load.loaded)
 		{
 			throw std::runtime_error("Failed to load model!");
 			return 0;
 		}
 
-		// Extract meshes
-		for (cgltf_size i = 0; i < data->meshes_count; ++i)
-		{
-			gltf_extract_mesh_data(data->meshes[i]);
-		}
+		// Store the model handle (root node)
+		g.g_models.push_back(gltf_append_model(load.model));
+		return (u32)g.g_models.size(); // Return the model handle
+	}
 
-		// Extract animations
-		for (cgltf_size i = 0; i < data->animations_count; ++i)
-		{
-			gltf_extract_animation_data(data->animations[i]);
-		}
+	u32 App::GlLoadModelAsync(cstring filepath)
+	{
+		PROFILE("GlLoadModelAsync");
 
-		// Extract nodes (scenegraph)
-		u64 childrenRange = 0;
-		for (cgltf_size i = 0; i < data->scene->nodes_count; ++i)
+		// The handle is reserved now, its root node is filled in by GlFinishLoads
+		g.g_models.push_back(0);
+
+		auto* load = new sGlModelLoad();
+		load->path = filepath;
+		load->handle = (u32)g.g_models.size();
+		JobSubmit(gltf_decode_model, load, &load->counter);
+		g.modelLoads.push_back(load);
+		return load->handle;
+	}
+
+	bool App::GlModelReady(u32 model)
+	{
+		for (const auto* load : g.modelLoads)
+			if (load->handle == model)
+				return false;
+		return model != 0 && model <= g.g_models.size();
+	}
+
+	void App::GlFinishLoads(f64 budget)
+	{
+		PROFILE("GlFinishLoads");
+
+		// Only work whose decode is already done, at least one item per frame so a small budget still makes progress
+		const f64 start = GetTime();
+		bool spent = false;
+		for (size_type i = 0; i < g.modelLoads.size() && !spent;)
 		{
-			gltf_extract_node_data(*data->scene->nodes[i], childrenRange);
+			auto* load = g.modelLoads[i];
+			if (load->counter.pending.load(std::memory_order_acquire) != 0)
+			{
+				++i;
+				continue;
+			}
+
+			JobWait(load->counter);
+			if (load->loaded)
+				g.g_models[load->handle - 1] = gltf_append_model(load->model);
+			else
+				LOGW("Failed to load model: %s", load->path.c_str());
+
+			delete load;
+			g.modelLoads.erase(g.modelLoads.begin() + i);
+			spent = GetTime() - start >= budget;
 		}
 
-		// Store the model handle (root node)
-		g.g_models.push_back(g.g_nodes.size());
+		if (!gl_context())
+			return;
+
+		for (size_type i = 0; i < g.uploads.size() && !spent;)
+		{
+			const auto upload = g.uploads[i];
+			auto& img = g.images[static_cast<size_type>(upload.image) - 1];
+			if (!gl_image_ready(img))
+			{
+				++i;
+				continue;
+			}
 
-		gltf_free(data); // Done with glTF data
+			auto* ready = gl_get_image(upload.image);
+			if (ready->data && ready->w > 0 && ready->h > 0)
+				gl_upload_texture(upload.texture, *ready, upload.format, upload.genMipmaps);
+			else
+				LOGW("Attempted to create texture from invalid image data.");
 
-		return (u32)g.g_models.size(); // Return the model handle
+			g.uploads.erase(g.uploads.begin() + i);
+			spent = GetTime() - start >= budget;
+		}
 	}
 
 	void App::GlDestroyModel(u32 model)
@@ -1044,12 +3453,67 @@ namespace GASandbox
 		return wrap == eGlTextureWrap::REPEAT ? GL_REPEAT : GL_CLAMP_TO_EDGE;
 	}
 
+	static GLuint gl_create_texture(eGlTextureFilter minFilter, eGlTextureFilter magFilter, eGlTextureWrap wrapS, eGlTextureWrap wrapT, bool genMipmaps)
+	{
+		GLuint texture = 0;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+
+		// Set texture parameters: filtering and wrapping
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, opengl_filter(minFilter, genMipmaps));
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, opengl_filter(magFilter, false));
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, opengl_wrap(wrapS));
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, opengl_wrap(wrapT));
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return texture;
+	}
+
+	static void gl_upload_texture(GLuint texture, const sGlImage& img, eGlTextureFormat format, bool genMipmaps)
+	{
+		PROFILE("GlUploadTexture");
+
+		glBindTexture(GL_TEXTURE_2D, texture);
+
+		// Rows are packed tightly, a 4 byte alignment would skew RGB, RG and R rows and the small levels of a chain
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		// Upload the texture data
+		glTexImage2D(GL_TEXTURE_2D, 0, opengl_internal_format(format), img.w, img.h, 0, opengl_format(format), opengl_type(format), img.data);
+
+		// Baked images bring their own chain
+		if (genMipmaps && img.levels > 1)
+		{
+			const u8* level = img.data;
+			for (u32 i = 1; i < img.levels; ++i)
+			{
+				level += (size_type)std::max(1, img.w >> (i - 1)) * std::max(1, img.h >> (i - 1)) * img.c;
+				glTexImage2D(GL_TEXTURE_2D, (GLint)i, opengl_internal_format(format), std::max(1, img.w >> i), std::max(1, img.h >> i), 0,
+					opengl_format(format), opengl_type(format), level);
+			}
+		}
+		else if (genMipmaps)
+		{
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		// Unbind the texture
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		if (texture >= g.texturesUploaded.size())
+			g.texturesUploaded.resize((size_type)texture + 1, 0);
+		g.texturesUploaded[texture] = 1;
+	}
+
 	u32 App::GlCreateTexture(
 		u32 image, eGlTextureFormat format,
 		eGlTextureFilter minFilter, eGlTextureFilter magFilter,
 		eGlTextureWrap wrapS, eGlTextureWrap wrapT,
 		bool genMipmaps)
 	{
+		PROFILE("GlCreateTexture");
+
 		auto* img = gl_get_image(image);
 		if (img == nullptr)
 			return 0;
@@ -1060,41 +3524,89 @@ namespace GASandbox
 			return 0;
 		}
 
-		GLenum glInternalFormat = opengl_internal_format(format);
-		GLenum glFormat = opengl_format(format);
-		GLenum glType = opengl_type(format);
-
-		u32 texture = 0;
-		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
+		if (!gl_context() || gl_recording("glCreateTexture"))
+			return 0;
 
-		// Set texture parameters: filtering and wrapping
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, opengl_filter(minFilter, genMipmaps));
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, opengl_filter(magFilter, false));
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, opengl_wrap(wrapS));
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, opengl_wrap(wrapT));
+		u32 texture = gl_create_texture(minFilter, magFilter, wrapS, wrapT, genMipmaps);
+		gl_upload_texture(texture, *img, format, genMipmaps);
+		return texture;
+	}
 
-		// Upload the texture data
-		glTexImage2D(GL_TEXTURE_2D, 0, glInternalFormat, img->w, img->h, 0, glFormat, glType, img->data);
+	u32 App::GlCreateTextureAsync(
+		u32 image, eGlTextureFormat format,
+		eGlTextureFilter minFilter, eGlTextureFilter magFilter,
+		eGlTextureWrap wrapS, eGlTextureWrap wrapT,
+		bool genMipmaps)
+	{
+		PROFILE("GlCreateTextureAsync");
 
-		if (genMipmaps)
+		if (image == 0 || image > g.images.size())
 		{
-			glGenerateMipmap(GL_TEXTURE_2D);
+			LOGW("Invalid image handle!");
+			return 0;
 		}
 
-		// Unbind the texture
-		glBindTexture(GL_TEXTURE_2D, 0);
-		return texture;
+		if (!gl_context() || gl_recording("glCreateTextureAsync"))
+			return 0;
+
+		sGlUpload upload{};
+		upload.texture = gl_create_texture(minFilter, magFilter, wrapS, wrapT, genMipmaps);
+		upload.image = image;
+		upload.format = format;
+		upload.genMipmaps = genMipmaps;
+		g.uploads.push_back(upload);
+		return upload.texture;
+	}
+
+	bool App::GlTextureReady(u32 texture)
+	{
+		// Pending, failed and destroyed textures were never uploaded or no longer are
+		return texture < g.texturesUploaded.size() && g.texturesUploaded[texture] != 0;
 	}
 
 	void App::GlDestroyTexture(u32 texture)
 	{
-		if (texture != 0)
+		if (gl_record)
+		{
+			gl_record_cmd(eGlCmd::DESTROY_TEXTURE).u[0] = texture;
+			return;
+		}
+
+		g.uploads.erase(std::remove_if(g.uploads.begin(), g.uploads.end(), [texture](const sGlUpload& upload) { return upload.texture == texture; }), g.uploads.end());
+
+		if (texture < g.texturesUploaded.size())
+			g.texturesUploaded[texture] = 0;
+		if (texture != 0 && gl_context())
 			glDeleteTextures(1, &texture);
 	}
 
-	void App::GlBegin(bool alpha, bool ztest, f32 pointSize, f32 lineWidth)
+	void App::GlBegin(bool alpha, bool ztest, f32 pointSize, f32 lineWidth, u32 format)
 	{
+		if (format == 0 || format > g.formats.size())
+		{
+			LOGW("Unknown vertex format %u, the batch uses the full format.", format);
+			format = (u32)eGlVertexFormat::FULL;
+		}
+
+		if (gl_record)
+		{
+			auto& cmd = gl_record_cmd(eGlCmd::BEGIN);
+			cmd.u[0] = alpha;
+			cmd.u[1] = ztest;
+			cmd.u[2] = format;
+			cmd.f[0] = pointSize;
+			cmd.f[1] = lineWidth;
+			gl_record->begin = (u32)gl_record->vertices.size();
+			gl_record->format = format;
+			return;
+		}
+
+		g.vertices.clear();
+		g.format = format;
+
+		if (!gl_context())
+			return;
+
 		if (alpha)
 		{
 			glEnable(GL_BLEND);
@@ -1113,29 +3625,26 @@ namespace GASandbox
 
 		glPointSize(pointSize);
 		glLineWidth(lineWidth);
-
-		g.vertices.clear();
 	}
 
 	void App::GlEnd(bool indexed, u32 mode, u32 count)
 	{
-		glBindVertexArray(g.vao);
-		glBindBuffer(GL_ARRAY_BUFFER, g.vbo);
+		PROFILE("GlEnd");
 
-		glBufferData(GL_ARRAY_BUFFER, g.vertices.size() * sizeof(sGlVertex), g.vertices.data(), GL_DYNAMIC_DRAW);
-
-		for (u32 bit = 1; bit <= (u32)eGlTopology::TRIANGLE_FAN; bit <<= 1)
+		if (gl_record)
 		{
-			if (mode & bit)
-			{
-				u32 i = 0, b = bit;
-				while (b > 1 && ++i) b >>= 1;
-				glDrawArrays(GL_POINTS + i, 0, (GLsizei)g.vertices.size());
-			}
+			auto& cmd = gl_record_cmd(eGlCmd::END);
+			cmd.u[0] = indexed;
+			cmd.u[1] = mode;
+			cmd.u[2] = gl_record->begin;
+			cmd.u[3] = (u32)gl_record->vertices.size();
+			return;
 		}
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
+		if (!gl_context())
+			return;
+
+		gl_draw(g.vertices.data(), g.vertices.size() / gl_get(g.formats, g.format).stride, mode, g.format);
 	}
 
 	void App::GlSetRenderTarget(u32 target, u32 depthStencil)
@@ -1148,16 +3657,56 @@ namespace GASandbox
 
 	void App::GlViewport(i32 x, i32 y, u32 w, u32 h)
 	{
+		if (gl_record)
+		{
+			auto& cmd = gl_record_cmd(eGlCmd::VIEWPORT);
+			cmd.u[0] = (u32)x; cmd.u[1] = (u32)y; cmd.u[2] = w; cmd.u[3] = h;
+			return;
+		}
+
+		if (!gl_context())
+			return;
+
 		glViewport(x, y, w, h);
 	}
 
 	void App::GlScissor(i32 x, i32 y, u32 w, u32 h)
 	{
+		if (gl_record)
+		{
+			auto& cmd = gl_record_cmd(eGlCmd::SCISSOR);
+			cmd.u[0] = (u32)x; cmd.u[1] = (u32)y; cmd.u[2] = w; cmd.u[3] = h;
+			return;
+		}
+
+		if (!gl_context())
+			return;
+
 		glScissor(x, y, w, h);
 	}
 
+	void App::GlSetSortDraws(bool enabled)
+	{
+		g.sortDraws = enabled;
+		if (gl_record)
+			gl_record->sort = enabled;
+	}
+
 	void App::GlClear(f32 r, f32 g, f32 b, f32 a, f64 d, i32 s, eGlClearFlags flags)
 	{
+		if (gl_record)
+		{
+			auto& cmd = gl_record_cmd(eGlCmd::CLEAR);
+			cmd.f[0] = r; cmd.f[1] = g; cmd.f[2] = b; cmd.f[3] = a;
+			cmd.d = d;
+			cmd.u[0] = (u32)s;
+			cmd.u[1] = (u32)flags;
+			return;
+		}
+
+		if (!gl_context())
+			return;
+
 		GLbitfield clear = 0;
 
 		if (((u32)flags & (u32)eGlClearFlags::COLOR) != 0)
@@ -1183,58 +3732,105 @@ namespace GASandbox
 
 	void App::GlSetUniform(cstring name)
 	{
-		g.uniformName = name;
+		const size_type nameHash = Hash(name);
+		if (gl_record)
+		{
+			auto& cmd = gl_record_cmd(eGlCmd::UNIFORM);
+			cmd.u[0] = (u32)gl_record->names.size();
+			cmd.u[2] = (u32)((u64)nameHash >> 32);
+			cmd.u[3] = (u32)nameHash;
+			gl_record->names.append(name).push_back('\0');
+			return;
+		}
+
+		g.uniform = gl_find_uniform(g.shader, nameHash);
+	}
+
+	u32 App::GlGetUniform(u32 shader, cstring name)
+	{
+		return gl_find_uniform(shader, Hash(name));
+	}
+
+	void App::GlSetUniformId(u32 uniform)
+	{
+		if (gl_record)
+		{
+			auto& cmd = gl_record_cmd(eGlCmd::UNIFORM);
+			cmd.u[0] = uniform;
+			cmd.u[1] = 1;
+			return;
+		}
+
+		g.uniform = uniform <= g.uniforms.size() ? uniform : 0;
 	}
 
 	void App::GlSetTex2D(u32 i, u32 texture)
 	{
+		if (gl_record)
+		{
+			auto& cmd = gl_record_cmd(eGlCmd::TEX2D);
+			cmd.u[0] = i;
+			cmd.u[1] = texture;
+			return;
+		}
+
+		if (!gl_context())
+			return;
+
 		glActiveTexture(GL_TEXTURE0 + i);
 		glBindTexture(GL_TEXTURE_2D, texture);
-		glUniform1i(glGetUniformLocation(g.shader, g.uniformName), i);
+
+		const f32 unit = (f32)i;
+		if (g.uniform == 0 || g.uniforms[g.uniform - 1].location < 0 || !gl_uniform_changed(g.uniforms[g.uniform - 1], eGlCmd::TEX2D, &unit))
+			return;
+
+		const auto& uniform = g.uniforms[g.uniform - 1];
+		if (uniform.program != g.shader)
+			glUseProgram(uniform.program);
+		glUniform1i(uniform.location, (GLint)i);
+		if (uniform.program != g.shader)
+			glUseProgram(g.shader);
 	}
 
 	void App::GlSetFloat(f32 x)
 	{
-		glUniform1f(glGetUniformLocation(g.shader, g.uniformName), x);
+		gl_set_value(eGlCmd::FLOAT, { x });
 	}
 
 	void App::GlSetVec2F(f32 x, f32 y)
 	{
-		glUniform2f(glGetUniformLocation(g.shader, g.uniformName), x, y);
+		gl_set_value(eGlCmd::VEC2, { x, y });
 	}
 
 	void App::GlSetVec3F(f32 x, f32 y, f32 z)
 	{
-		glUniform3f(glGetUniformLocation(g.shader, g.uniformName), x, y, z);
+		gl_set_value(eGlCmd::VEC3, { x, y, z });
 	}
 
 	void App::GlSetVec4F(f32 x, f32 y, f32 z, f32 w)
 	{
-		glUniform4f(glGetUniformLocation(g.shader, g.uniformName), x, y, z, w);
+		gl_set_value(eGlCmd::VEC4, { x, y, z, w });
 	}
 
 	void App::GlSetMat2x2F(
 		f32 m00, f32 m01,
 		f32 m10, f32 m11)
 	{
-		const GLfloat v[4] = { m00, m01, m10, m11 };
-		glUniformMatrix2fv(glGetUniformLocation(g.shader, g.uniformName), 1, GL_FALSE, v);
+		gl_set_value(eGlCmd::MAT2X2, { m00, m01, m10, m11 });
 	}
 
 	void App::GlSetMat2x3F(
 		f32 m00, f32 m01, f32 m02,
 		f32 m10, f32 m11, f32 m12)
 	{
-		const GLfloat v[6] = { m00, m01, m02, m10, m11, m12 };
-		glUniformMatrix2x3fv(glGetUniformLocation(g.shader, g.uniformName), 1, GL_FALSE, v);
+		gl_set_value(eGlCmd::MAT2X3, { m00, m01, m02, m10, m11, m12 });
 	}
 
 	void App::GlSetMat2x4F(
 		f32 m00, f32 m01, f32 m02, f32 m03,
 		f32 m10, f32 m11, f32 m12, f32 m13)
 	{
-		const GLfloat v[8] = { m00, m01, m02, m03, m10, m11, m12, m13 };
-		glUniformMatrix2x4fv(glGetUniformLocation(g.shader, g.uniformName), 1, GL_FALSE, v);
+		gl_set_value(eGlCmd::MAT2X4, { m00, m01, m02, m03, m10, m11, m12, m13 });
 	}
 
 	void App::GlSetMat3x2F(
@@ -1242,8 +3838,7 @@ namespace GASandbox
 		f32 m10, f32 m11,
 		f32 m20, f32 m21)
 	{
-		const GLfloat v[6] = { m00, m01, m10, m11, m20, m21 };
-		glUniformMatrix3x2fv(glGetUniformLocation(g.shader, g.uniformName), 1, GL_FALSE, v);
+		gl_set_value(eGlCmd::MAT3X2, { m00, m01, m10, m11, m20, m21 });
 	}
 
 	void App::GlSetMat3x3F(
@@ -1251,8 +3846,7 @@ namespace GASandbox
 		f32 m10, f32 m11, f32 m12,
 		f32 m20, f32 m21, f32 m22)
 	{
-		const GLfloat v[9] = { m00, m01, m02, m10, m11, m12, m20, m21, m22 };
-		glUniformMatrix3fv(glGetUniformLocation(g.shader, g.uniformName), 1, GL_FALSE, v);
+		gl_set_value(eGlCmd::MAT3X3, { m00, m01, m02, m10, m11, m12, m20, m21, m22 });
 	}
 
 	void App::GlSetMat3x4F(
@@ -1260,8 +3854,7 @@ namespace GASandbox
 		f32 m10, f32 m11, f32 m12, f32 m13,
 		f32 m20, f32 m21, f32 m22, f32 m23)
 	{
-		const GLfloat v[12] = { m00, m01, m02, m03, m10, m11, m12, m13, m20, m21, m22, m23 };
-		glUniformMatrix3x4fv(glGetUniformLocation(g.shader, g.uniformName), 1, GL_FALSE, v);
+		gl_set_value(eGlCmd::MAT3X4, { m00, m01, m02, m03, m10, m11, m12, m13, m20, m21, m22, m23 });
 	}
 
 	void App::GlSetMat4x2F(
@@ -1270,8 +3863,7 @@ namespace GASandbox
 		f32 m20, f32 m21,
 		f32 m30, f32 m31)
 	{
-		const GLfloat v[8] = { m00, m01, m10, m11, m20, m21 };
-		glUniformMatrix4x2fv(glGetUniformLocation(g.shader, g.uniformName), 1, GL_FALSE, v);
+		gl_set_value(eGlCmd::MAT4X2, { m00, m01, m10, m11, m20, m21, m30, m31 });
 	}
 
 	void App::GlSetMat4x3F(
@@ -1280,8 +3872,7 @@ namespace GASandbox
 		f32 m20, f32 m21, f32 m22,
 		f32 m30, f32 m31, f32 m32)
 	{
-		const GLfloat v[12] = { m00, m01, m02, m10, m11, m12, m20, m21, m22, m30, m31, m32 };
-		glUniformMatrix4x3fv(glGetUniformLocation(g.shader, g.uniformName), 1, GL_FALSE, v);
+		gl_set_value(eGlCmd::MAT4X3, { m00, m01, m02, m10, m11, m12, m20, m21, m22, m30, m31, m32 });
 	}
 
 	void App::GlSetMat4x4F(
@@ -1290,8 +3881,7 @@ namespace GASandbox
 		f32 m20, f32 m21, f32 m22, f32 m23,
 		f32 m30, f32 m31, f32 m32, f32 m33)
 	{
-		const GLfloat v[16] = { m00, m01, m02, m03, m10, m11, m12, m13, m20, m21, m22, m23, m30, m31, m32, m33 };
-		glUniformMatrix4fv(glGetUniformLocation(g.shader, g.uniformName), 1, GL_FALSE, v);
+		gl_set_value(eGlCmd::MAT4X4, { m00, m01, m02, m03, m10, m11, m12, m13, m20, m21, m22, m23, m30, m31, m32, m33 });
 	}
 
 	void App::GlAddVertex(
@@ -1300,6 +3890,94 @@ namespace GASandbox
 		f32 v0, f32 v1, f32 v2, f32 v3,
 		f32 v4, f32 v5, f32 v6, f32 v7)
 	{
-		g.vertices.emplace_back(sGlVertex{ { x, y, z, w }, { c0, c1 }, { i0, i1 }, { v0, v1, v2, v3, v4, v5, v6, v7 } });
+		u32 format = 0;
+		auto& batch = gl_batch(format);
+		if (!gl_batch_format(format, (u32)eGlVertexFormat::FULL, "GlAddVertex"))
+			return;
+
+		const sGlVertex vertex{ { x, y, z, w }, { c0, c1 }, { i0, i1 }, { v0, v1, v2, v3, v4, v5, v6, v7 } };
+		gl_append(batch, &vertex, sizeof(sGlVertex));
+	}
+
+	void App::GlAddVertexXYC(f32 x, f32 y, u32 c)
+	{
+		u32 format = 0;
+		auto& batch = gl_batch(format);
+		if (!gl_batch_format(format, (u32)eGlVertexFormat::XYC, "GlAddVertexXYC"))
+			return;
+
+		u32 words[3]{ 0, 0, c };
+		std::memcpy(&words[0], &x, sizeof(f32));
+		std::memcpy(&words[1], &y, sizeof(f32));
+		gl_append(batch, words, sizeof(words));
+	}
+
+	void App::GlAddVertexXYZC(f32 x, f32 y, f32 z, u32 c)
+	{
+		u32 format = 0;
+		auto& batch = gl_batch(format);
+		if (!gl_batch_format(format, (u32)eGlVertexFormat::XYZC, "GlAddVertexXYZC"))
+			return;
+
+		u32 words[4]{ 0, 0, 0, c };
+		std::memcpy(&words[0], &x, sizeof(f32));
+		std::memcpy(&words[1], &y, sizeof(f32));
+		std::memcpy(&words[2], &z, sizeof(f32));
+		gl_append(batch, words, sizeof(words));
+	}
+
+	void App::GlAddVertices(const void* vertices, u32 count)
+	{
+		u32 format = 0;
+		auto& batch = gl_batch(format);
+		gl_append(batch, vertices, (size_type)count * gl_get(g.formats, format).stride);
+	}
+
+	u32 App::GlCreateVertexFormat(const sGlVertexAttrib* attribs, u32 count)
+	{
+		// Formats get their vertex array on the render thread, the list can't grow under a frame it draws
+		if (gl_recording("glCreateVertexFormat"))
+			return 0;
+
+		sGlVertexFormat format{};
+		list<u32> key{};
+		for (u32 i = 0; i < count; ++i)
+		{
+			const auto& attrib = attribs[i];
+			const u32 type = (u32)attrib.type;
+			const u32 bytes = type < ARRAY_SIZE(GL_VERTEX_TYPES) ? attrib.components * GL_VERTEX_TYPES[type].size : 0;
+			if (bytes == 0 || attrib.components > 4 || bytes % 4 != 0 || attrib.offset % 4 != 0 || attrib.location >= 16)
+			{
+				LOGW("Invalid vertex attribute: location %u, %u components of type %u at offset %u.", attrib.location, attrib.components, type, attrib.offset);
+				return 0;
+			}
+
+			format.stride = std::max(format.stride, attrib.offset + bytes);
+			if (attrib.type == eGlVertexType::FLOAT)
+			{
+				for (u32 word = attrib.offset / 4; word < (attrib.offset + bytes) / 4 && word < GL_FORMAT_MAX_WORDS; ++word)
+					format.floats |= 1u << word;
+			}
+
+			format.attribs.push_back(attrib);
+			key.insert(key.end(), { attrib.location, attrib.components, type, (u32)attrib.normalized, attrib.offset });
+		}
+
+		if (count == 0 || format.stride > GL_FORMAT_MAX_WORDS * 4)
+		{
+			LOGW("A vertex format needs between 1 and %u bytes of attributes.", GL_FORMAT_MAX_WORDS * 4);
+			return 0;
+		}
+
+		// Scripts create their formats in init(), running it again finds the same ones
+		format.hash = std::hash<string>()(string(reinterpret_cast<const char*>(key.data()), key.size() * sizeof(u32)));
+		const auto it = g.formatHandles.find(format.hash);
+		if (it != g.formatHandles.end())
+			return it->second;
+
+		g.formats.push_back(std::move(format));
+		const u32 handle = (u32)g.formats.size();
+		g.formatHandles.insert(std::make_pair(g.formats.back().hash, handle));
+		return handle;
 	}
 }
\ No newline at end of file
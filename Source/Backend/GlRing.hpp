@@ -0,0 +1,61 @@
+#pragma once
+
+#include <App.hpp>
+
+namespace GASandbox
+{
+	// Streaming vertex ring: each batch is written at the head and drawn from there, the buffer storage is never
+	// respecified. The ring is split in segments, a segment is fenced once the head has moved past it and the head
+	// waits on that fence before writing into it again, so neither the driver nor the GPU ever sees a rewritten range.
+	// Only the bookkeeping lives here, the buffer and its fences stay in Gl.cpp, so it is checked without a context.
+	// Uniform block snapshots stream through a second, smaller ring the same way, aligned instead of strided.
+	constexpr u32 GL_RING_SIZE = 8u << 20;
+	constexpr u32 GL_BLOCK_RING_SIZE = 1u << 20;
+	constexpr u32 GL_RING_SEGMENTS = 8;
+
+	struct sGlRingHead
+	{
+		u32 size{ 0 };
+		u32 head{ 0 };
+		u32 segment{ 0 };		// Holding the head, written but not fenced
+		u32 leave{ 0 };			// Masks of the last reserve: the segment a wrap left, fenced before writing,
+		u32 wait{ 0 };			// the segments entered again, waited on before writing,
+		u32 retire{ 0 };		// and the segments moved past, fenced after the draw
+
+		u64 bytes{ 0 };
+		u32 wraps{ 0 };
+	};
+
+	// The offset of the batch and the segments to fence and wait on around it. The offset is a multiple of the vertex
+	// stride so draws index from it. Batches are kept to half the ring by the caller.
+	inline u32 gl_ring_reserve(sGlRingHead& ring, u32 bytes, u32 stride)
+	{
+		const u32 segmentSize = ring.size / GL_RING_SEGMENTS;
+		u32 offset = (ring.head + stride - 1) / stride * stride;
+		u32 from = ring.segment;
+		ring.leave = 0;
+		ring.wait = 0;
+		ring.retire = 0;
+		if (offset + bytes > ring.size)
+		{
+			// Every draw reading the segment holding the head has been issued
+			ring.leave = 1u << ring.segment;
+			offset = 0;
+			from = 0;
+			ring.wait = 1u;
+			ring.wraps++;
+		}
+
+		// Everything from the head's segment up to the batch's last one is passed, the ones after it entered
+		const u32 last = (offset + bytes - 1) / segmentSize;
+		for (u32 s = from + 1; s <= last; ++s)
+			ring.wait |= 1u << s;
+		for (u32 s = from; s < last; ++s)
+			ring.retire |= 1u << s;
+
+		ring.segment = last;
+		ring.head = offset + bytes;
+		ring.bytes += bytes;
+		return offset;
+	}
+}
@@ -11,6 +11,7 @@
 #include <cereal/archives/json.hpp>
 
 #include <fstream>
+#include <sstream>
 
 namespace GASandbox
 {
@@ -26,6 +27,11 @@ namespace GASandbox
 	};
 	static sGuiGlobal g{};
 
+	static bool gui_context() { return ImGui::GetCurrentContext() != nullptr; }
+
+	static void* gui_alloc(size_t size, void* user) { return App::MemAlloc(eMemTag::GUI, size); }
+	static void gui_free(void* ptr, void* user) { App::MemFree(ptr); }
+
 	template<class Archive>
 	void serialize(Archive& archive, sGuiFont& m)
 	{
@@ -166,6 +172,7 @@ namespace GASandbox
 	bool App::GuiInitialize(const sAppConfig& config)
 	{
 		IMGUI_CHECKVERSION();
+		ImGui::SetAllocatorFunctions(gui_alloc, gui_free);
 		ImGui::CreateContext();
 
 		ImGuiIO& io = ImGui::GetIO(); (void)io;
@@ -319,10 +326,14 @@ namespace GASandbox
 	{
 		try
 		{
-			std::ofstream os(PATH("/Assets/App/style.json"));
-			cereal::JSONOutputArchive ar(os);
-			ar(cereal::make_nvp("Font", g.font));
-			ar(cereal::make_nvp("ImGuiStyle", ImGui::GetStyle()));
+			// The archive finishes the json when it goes out of scope, the file is written behind
+			std::ostringstream os;
+			{
+				cereal::JSONOutputArchive ar(os);
+				ar(cereal::make_nvp("Font", g.font));
+				ar(cereal::make_nvp("ImGuiStyle", ImGui::GetStyle()));
+			}
+			FileSave("Assets/App/style.json", os.str());
 		}
 		catch (std::exception e)
 		{
@@ -357,87 +368,135 @@ namespace GASandbox
 	// Gui
 	void App::GuiPushItemWidth(f32 w)
 	{
+		if (!gui_context())
+			return;
+
 		ImGui::PushItemWidth(w);
 	}
 
 	void App::GuiPopItemWidth()
 	{
+		if (!gui_context())
+			return;
+
 		ImGui::PopItemWidth();
 	}
 
 	void App::GuiText(cstring text)
 	{
+		if (!gui_context())
+			return;
+
 		ImGui::Text(text);
 	}
 
 	void App::GuiAbsText(cstring text, f32 x, f32 y, u32 c)
 	{
+		if (!gui_context())
+			return;
+
 		ImDrawList* drawlist = ImGui::GetBackgroundDrawList();
 		drawlist->AddText(ImVec2(x, y), c, text);
 	}
 
 	bool App::GuiBool(cstring label, bool v)
 	{
+		if (!gui_context())
+			return v;
+
 		ImGui::Checkbox(label, &v);
 		return v;
 	}
 
 	i32 App::GuiInt(cstring label, i32 i)
 	{
+		if (!gui_context())
+			return i;
+
 		ImGui::InputInt(label, &i);
 		return i;
 	}
 
 	i32 App::GuiInt(cstring label, i32 i, i32 min, i32 max)
 	{
+		if (!gui_context())
+			return i;
+
 		ImGui::SliderInt(label, &i, min, max);
 		return i;
 	}
 
 	f32 App::GuiFloat(cstring label, f32 v)
 	{
+		if (!gui_context())
+			return v;
+
 		ImGui::DragFloat(label, &v, 0.1f);
 		return v;
 	}
 
 	f32 App::GuiFloat(cstring label, f32 v, f32 min, f32 max)
 	{
+		if (!gui_context())
+			return v;
+
 		ImGui::SliderFloat(label, &v, min, max);
 		return v;
 	}
 
 	void App::GuiSeparator(cstring label)
 	{
+		if (!gui_context())
+			return;
+
 		ImGui::SeparatorText(label);
 	}
 
 	bool App::GuiButton(cstring label)
 	{
+		if (!gui_context())
+			return false;
+
 		return ImGui::Button(label);
 	}
 
 	void App::GuiSameLine()
 	{
+		if (!gui_context())
+			return;
+
 		ImGui::SameLine();
 	}
 
 	f32 App::GuiContentAvailWidth()
 	{
+		if (!gui_context())
+			return 0;
+
 		return ImGui::GetContentRegionAvail().x;
 	}
 
 	f32 App::GuiContentAvailHeight()
 	{
+		if (!gui_context())
+			return 0;
+
 		return ImGui::GetContentRegionAvail().y;
 	}
 
 	bool App::GuiBeginChild(cstring label, f32 w, f32 h)
 	{
+		if (!gui_context())
+			return false;
+
 		return ImGui::BeginChild(label, ImVec2(w, h));
 	}
 
 	void App::GuiEndChild()
 	{
+		if (!gui_context())
+			return;
+
 		ImGui::EndChild();
 	}
 }
\ No newline at end of file
@@ -0,0 +1,373 @@
+#include <App.hpp>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <new>
+
+namespace GASandbox
+{
+	// Every worker owns a deque, it pushes and pops its own jobs at the back and steals the oldest job at the front of
+	// the others when it runs dry. Threads outside the pool (main, simulation, audio) share one extra deque.
+	// Waiting never blocks a thread that could run jobs, JobWait keeps running jobs until its counter is done and
+	// only sleeps with the idle workers when nothing is queued, a counter reaching zero wakes them all.
+	constexpr u32 JOB_MAX_WORKERS = 63;
+	constexpr u32 JOB_STACK_TASKS = 64; // Range tasks of a parallel loop kept on the stack, more go to the heap
+
+	struct sJob
+	{
+		fJob func{ nullptr };
+		void* data{ nullptr };
+		sJobCounter* counter{ nullptr };
+	};
+
+	// Growable ring of jobs, unlike a deque it stops allocating once it has reached its steady state size
+	struct sJobQueue
+	{
+		std::mutex mutex{};
+		list<sJob> jobs{};
+		u32 front{ 0 };
+		u32 count{ 0 };
+	};
+
+	struct sJobRangeTask
+	{
+		fJobRange func{ nullptr };
+		void* data{ nullptr };
+		u32 begin{ 0 };
+		u32 end{ 0 };
+	};
+
+	struct sJobKernelTask
+	{
+		fJobKernel kernel{ nullptr };
+		f64* values{ nullptr };
+	};
+
+	struct sJobGlobal
+	{
+		list<std::thread> threads{};
+		sJobQueue queues[JOB_MAX_WORKERS + 1]{}; // One per worker, then the shared one
+		u32 workers{ 0 };
+
+		std::atomic<u32> queued{ 0 };
+		std::atomic<bool> quit{ false };
+		std::mutex wakeMutex{};
+		std::condition_variable wake{};
+
+		// Counters and their dependent jobs, a counter is only released under this lock
+		std::mutex waitingMutex{};
+
+		hashmap<size_type, fJobKernel> kernels{};
+	};
+	static sJobGlobal g;
+	static thread_local u32 job_queue = JOB_MAX_WORKERS; // Own queue, the shared one outside the pool
+
+	static void job_queue_push(sJobQueue& queue, const sJob& job)
+	{
+		const u32 capacity = (u32)queue.jobs.size();
+		if (queue.count == capacity)
+		{
+			list<sJob> jobs(std::max(64u, capacity * 2));
+			for (u32 i = 0; i < queue.count; ++i)
+				jobs[i] = queue.jobs[(queue.front + i) % capacity];
+			queue.jobs.swap(jobs);
+			queue.front = 0;
+		}
+
+		queue.jobs[(queue.front + queue.count) % queue.jobs.size()] = job;
+		queue.count++;
+	}
+
+	static void job_push(const sJob& job)
+	{
+		auto& queue = g.queues[std::min(job_queue, g.workers)];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			job_queue_push(queue, job);
+		}
+		g.queued.fetch_add(1, std::memory_order_release);
+
+		{
+			std::lock_guard<std::mutex> lock(g.wakeMutex);
+		}
+		g.wake.notify_one();
+	}
+
+	static bool job_pop(sJob& job)
+	{
+		// Own queue first, the newest job is the most likely to be warm in cache
+		const u32 own = std::min(job_queue, g.workers);
+		{
+			auto& queue = g.queues[own];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.count > 0)
+			{
+				queue.count--;
+				job = queue.jobs[(queue.front + queue.count) % queue.jobs.size()];
+				g.queued.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		// Steal the oldest job of another queue
+		for (u32 i = 1; i <= g.workers; ++i)
+		{
+			auto& queue = g.queues[(own + i) % (g.workers + 1)];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.count > 0)
+			{
+				job = queue.jobs[queue.front];
+				queue.front = (queue.front + 1) % (u32)queue.jobs.size();
+				queue.count--;
+				g.queued.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	static void job_run(const sJob& job)
+	{
+		job.func(job.data);
+
+		if (job.counter == nullptr)
+			return;
+
+		// The counter can be released by its waiter as soon as it reads zero, so it is not touched after the lock
+		list<sJob>* waiting = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(g.waitingMutex);
+			if (job.counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+
+			waiting = static_cast<list<sJob>*>(job.counter->waiting);
+			job.counter->waiting = nullptr;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(g.wakeMutex);
+		}
+		g.wake.notify_all();
+
+		if (waiting == nullptr)
+			return;
+
+		for (const auto& next : *waiting)
+			job_push(next);
+		delete waiting;
+	}
+
+	static void job_worker(u32 index)
+	{
+		job_queue = index;
+		App::ProfThread(("Job " + std::to_string(index)).c_str());
+
+		sJob job{};
+		while (!g.quit.load(std::memory_order_acquire))
+		{
+			if (job_pop(job))
+			{
+				job_run(job);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(g.wakeMutex);
+			g.wake.wait(lock, [] { return g.queued.load(std::memory_order_acquire) > 0 || g.quit.load(std::memory_order_acquire); });
+		}
+	}
+
+	static void job_range(void* data)
+	{
+		const auto* task = static_cast<const sJobRangeTask*>(data);
+		task->func(task->data, task->begin, task->end);
+	}
+
+	static void job_kernel(void* data, u32 begin, u32 end)
+	{
+		const auto* task = static_cast<const sJobKernelTask*>(data);
+		task->kernel(task->values, begin, end);
+	}
+
+	// Built in kernels, element wise over the values
+	static void job_kernel_sin(f64* v, u32 begin, u32 end) { for (u32 i = begin; i < end; ++i) v[i] = std::sin(v[i]); }
+	static void job_kernel_cos(f64* v, u32 begin, u32 end) { for (u32 i = begin; i < end; ++i) v[i] = std::cos(v[i]); }
+	static void job_kernel_sqrt(f64* v, u32 begin, u32 end) { for (u32 i = begin; i < end; ++i) v[i] = std::sqrt(v[i]); }
+	static void job_kernel_exp(f64* v, u32 begin, u32 end) { for (u32 i = begin; i < end; ++i) v[i] = std::exp(v[i]); }
+	static void job_kernel_abs(f64* v, u32 begin, u32 end) { for (u32 i = begin; i < end; ++i) v[i] = std::fabs(v[i]); }
+
+	bool App::JobInitialize(const sAppConfig& config)
+	{
+		const u32 hardware = std::max(2u, std::thread::hardware_concurrency());
+		g.workers = config.jobThreads > 0 ? config.jobThreads : hardware - 1;
+		g.workers = std::min(g.workers, JOB_MAX_WORKERS);
+		g.quit = false;
+
+		for (u32 i = 0; i < g.workers; ++i)
+			g.threads.emplace_back(job_worker, i);
+
+		JobBindKernel("sin", job_kernel_sin);
+		JobBindKernel("cos", job_kernel_cos);
+		JobBindKernel("sqrt", job_kernel_sqrt);
+		JobBindKernel("exp", job_kernel_exp);
+		JobBindKernel("abs", job_kernel_abs);
+
+		LOGD("Job system started with %u workers.", g.workers);
+		return true;
+	}
+
+	void App::JobShutdown()
+	{
+		// Finish what is queued, loads still in flight write into backend storage
+		sJob job{};
+		while (job_pop(job))
+			job_run(job);
+
+		{
+			std::lock_guard<std::mutex> lock(g.wakeMutex);
+			g.quit = true;
+		}
+		g.wake.notify_all();
+
+		for (auto& thread : g.threads)
+			thread.join();
+		g.threads.clear();
+		g.workers = 0;
+	}
+
+	void App::JobReload()
+	{
+		CodeBindMethod("app", "App", true, "jobParallelFor(_,_)",
+			[](sCodeVM* vm)
+			{
+				CodeEnsureSlots(vm, 4);
+				cstring name = CodeGetSlotString(vm, 1);
+				const auto it = g.kernels.find(Hash(name));
+				if (it == g.kernels.end())
+				{
+					LOGW("Unknown job kernel: %s", name);
+					return;
+				}
+
+				// Script values never leave the vm thread, the kernel runs on a native copy
+				thread_local list<f64> values;
+				const i32 count = CodeGetListCount(vm, 2);
+				values.resize(count);
+				for (i32 i = 0; i < count; ++i)
+				{
+					CodeGetListElement(vm, 2, i, 3);
+					values[i] = CodeGetSlotF64(vm, 3);
+				}
+
+				sJobKernelTask task{};
+				task.kernel = it->second;
+				task.values = values.data();
+				JobParallelFor((u32)count, 0, job_kernel, &task);
+
+				for (i32 i = 0; i < count; ++i)
+				{
+					CodeSetSlotF64(vm, 3, values[i]);
+					CodeSetListElement(vm, 2, i, 3);
+				}
+			});
+	}
+
+	void App::JobSubmit(fJob job, void* data, sJobCounter* counter, sJobCounter* after)
+	{
+		sJob next{};
+		next.func = job;
+		next.data = data;
+		next.counter = counter;
+
+		if (counter)
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+		if (after)
+		{
+			std::lock_guard<std::mutex> lock(g.waitingMutex);
+			if (after->pending.load(std::memory_order_acquire) != 0)
+			{
+				if (after->waiting == nullptr)
+					after->waiting = new list<sJob>();
+				static_cast<list<sJob>*>(after->waiting)->push_back(next);
+				return;
+			}
+		}
+
+		job_push(next);
+	}
+
+	void App::JobWait(sJobCounter& counter)
+	{
+		PROFILE("JobWait");
+
+		sJob job{};
+		while (counter.pending.load(std::memory_order_acquire) != 0)
+		{
+			if (job_pop(job))
+			{
+				job_run(job);
+				continue;
+			}
+
+			// The rest of the counter runs on other threads
+			std::unique_lock<std::mutex> lock(g.wakeMutex);
+			g.wake.wait(lock, [&counter] { return counter.pending.load(std::memory_order_acquire) == 0 || g.queued.load(std::memory_order_acquire) > 0; });
+		}
+
+		// The last job may still hold the counter while it releases its dependents
+		std::lock_guard<std::mutex> lock(g.waitingMutex);
+	}
+
+	void App::JobParallelFor(u32 count, u32 grain, fJobRange func, void* data)
+	{
+		PROFILE("JobParallelFor");
+
+		if (count == 0)
+			return;
+
+		// A few chunks per thread by default so stealing can even out uneven ranges
+		if (grain == 0)
+			grain = std::max(1u, count / ((g.workers + 1) * 4));
+
+		const u32 chunks = (count + grain - 1) / grain;
+		if (chunks == 1 || g.workers == 0)
+		{
+			func(data, 0, count);
+			return;
+		}
+
+		// Only lives until the wait below. Not in the frame arena, loops run from jobs and other threads outlive a frame.
+		sJobRangeTask stack[JOB_STACK_TASKS];
+		auto* tasks = chunks <= JOB_STACK_TASKS ? stack : static_cast<sJobRangeTask*>(MemAlloc(eMemTag::APP, chunks * sizeof(sJobRangeTask)));
+		sJobCounter counter{};
+		for (u32 i = 0; i < chunks; ++i)
+		{
+			auto& task = *new (tasks + i) sJobRangeTask();
+			task.func = func;
+			task.data = data;
+			task.begin = i * grain;
+			task.end = std::min(count, task.begin + grain);
+			JobSubmit(job_range, &task, &counter);
+		}
+
+		JobWait(counter);
+
+		if (tasks != stack)
+			MemFree(tasks);
+	}
+
+	void App::JobBindKernel(cstring name, fJobKernel kernel)
+	{
+		g.kernels[Hash(name)] = kernel;
+	}
+
+	u32 App::JobWorkerCount()
+	{
+		return g.workers;
+	}
+}
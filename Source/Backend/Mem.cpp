@@ -0,0 +1,340 @@
+#include <App.hpp>
+
+#include <imgui.h>
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+namespace GASandbox
+{
+	// Tagged allocations carry a small header with their size and tag, so C style callbacks (wren, enet, stb, miniaudio)
+	// that free without a size still count. Untagged heap allocations are only counted, by the executable's
+	// global operator new calling MemCountHeapAlloc.
+	constexpr size_type MEM_HEADER_SIZE = 16; // Keeps the malloc alignment
+	constexpr size_type MEM_ARENA_ALIGN = 16;
+	constexpr f64 MEM_RATE_WINDOW = 1.0; // Seconds between allocation rate updates
+
+	static cstring MEM_TAG_NAMES[] = { "App", "Code", "Gl", "Gui", "Sfx", "Net" };
+	static_assert(ARRAY_SIZE(MEM_TAG_NAMES) == (size_type)eMemTag::COUNT, "Missing memory tag name");
+
+	struct sMemHeader
+	{
+		size_type size{ 0 };
+		eMemTag tag{ eMemTag::APP };
+	};
+	static_assert(sizeof(sMemHeader) <= MEM_HEADER_SIZE, "Memory header too large");
+
+	// Written from any thread, only atomics so they are ready before static constructors allocate
+	struct sMemCounter
+	{
+		std::atomic<size_type> bytes{ 0 };
+		std::atomic<size_type> peak{ 0 };
+		std::atomic<size_type> allocs{ 0 };
+		std::atomic<size_type> allocBytes{ 0 };
+	};
+	static sMemCounter mem_counters[(size_type)eMemTag::COUNT]{};
+	static std::atomic<size_type> mem_heap_allocs{ 0 };
+
+	// Main thread view, updated once per frame
+	struct sMemStat
+	{
+		size_type markAllocs{ 0 };
+		size_type frameAllocs{ 0 };
+		size_type windowAllocs{ 0 };
+		size_type windowBytes{ 0 };
+		f64 allocRate{ 0 }; // Allocations per second
+		f64 byteRate{ 0 };	// Bytes per second
+	};
+
+	// Linear allocator reset every frame, anything past the capacity comes from the heap until the arena grows
+	struct sMemArena
+	{
+		u8* base{ nullptr };
+		size_type capacity{ 0 };
+		std::atomic<size_type> offset{ 0 };
+		size_type used{ 0 }; // Last frame
+		size_type peak{ 0 };
+		u32 grows{ 0 };
+
+		std::mutex mutex{};
+		list<void*> overflow{};
+	};
+
+	struct sMemGlobal
+	{
+		sMemArena arena{};
+		sMemStat stats[(size_type)eMemTag::COUNT]{};
+
+		size_type heapMark{ 0 };
+		size_type heapFrameAllocs{ 0 };
+		u32 frameAllocs{ 0 };	// Native heap allocations of the last frame, scripts excluded
+		u32 steadyFrames{ 0 };	// Frames in a row without any
+		u32 maxFrameAllocs{ 0 };
+		f64 windowStart{ 0 };
+	};
+	static sMemGlobal g;
+
+	static void mem_count_alloc(eMemTag tag, size_type size)
+	{
+		auto& counter = mem_counters[(size_type)tag];
+		counter.allocs.fetch_add(1, std::memory_order_relaxed);
+		counter.allocBytes.fetch_add(size, std::memory_order_relaxed);
+
+		const size_type bytes = counter.bytes.fetch_add(size, std::memory_order_relaxed) + size;
+		size_type peak = counter.peak.load(std::memory_order_relaxed);
+		while (bytes > peak && !counter.peak.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {}
+	}
+
+	static void mem_count_free(const sMemHeader& header)
+	{
+		mem_counters[(size_type)header.tag].bytes.fetch_sub(header.size, std::memory_order_relaxed);
+	}
+
+	static cstring mem_format(size_type bytes, char* buffer, size_type size)
+	{
+		if (bytes >= 1024 * 1024)
+			std::snprintf(buffer, size, "%.2f MB", bytes / (1024.0 * 1024.0));
+		else if (bytes >= 1024)
+			std::snprintf(buffer, size, "%.2f KB", bytes / 1024.0);
+		else
+			std::snprintf(buffer, size, "%zu B", bytes);
+		return buffer;
+	}
+
+	bool App::MemInitialize(const sAppConfig& config)
+	{
+		g.arena.capacity = std::max(config.frameArena, MEM_ARENA_ALIGN);
+		g.arena.base = static_cast<u8*>(MemAlloc(eMemTag::APP, g.arena.capacity));
+		g.arena.offset = 0;
+		g.windowStart = GetTime();
+		return g.arena.base != nullptr;
+	}
+
+	void App::MemShutdown()
+	{
+		for (void* ptr : g.arena.overflow)
+			MemFree(ptr);
+		g.arena.overflow.clear();
+
+		MemFree(g.arena.base);
+		g.arena.base = nullptr;
+		g.arena.capacity = 0;
+	}
+
+	void App::MemFrame()
+	{
+		PROFILE("MemFrame");
+
+		// Nothing allocates from the arena between frames, the simulation worker and parallel jobs are done
+		auto& arena = g.arena;
+		arena.used = arena.offset.exchange(0, std::memory_order_acq_rel);
+		arena.peak = std::max(arena.peak, arena.used);
+
+		if (!arena.overflow.empty())
+		{
+			for (void* ptr : arena.overflow)
+				MemFree(ptr);
+			arena.overflow.clear();
+		}
+
+		if (arena.used > arena.capacity)
+		{
+			size_type capacity = arena.capacity;
+			while (capacity < arena.used)
+				capacity *= 2;
+
+			LOGD("Frame arena grown from %zu to %zu bytes.", arena.capacity, capacity);
+			MemFree(arena.base);
+			arena.base = static_cast<u8*>(MemAlloc(eMemTag::APP, capacity));
+			arena.capacity = capacity;
+			arena.grows++;
+		}
+
+		// Script allocations are the scene's business, everything else should reach zero once warmed up
+		const size_type heap = mem_heap_allocs.load(std::memory_order_relaxed);
+		g.heapFrameAllocs = heap - g.heapMark;
+		g.heapMark = heap;
+
+		size_type native = g.heapFrameAllocs;
+		for (size_type i = 0; i < (size_type)eMemTag::COUNT; ++i)
+		{
+			auto& stat = g.stats[i];
+			const size_type allocs = mem_counters[i].allocs.load(std::memory_order_relaxed);
+			stat.frameAllocs = allocs - stat.markAllocs;
+			stat.markAllocs = allocs;
+
+			if (i != (size_type)eMemTag::CODE)
+				native += stat.frameAllocs;
+		}
+
+		g.frameAllocs = (u32)native;
+		g.maxFrameAllocs = std::max(g.maxFrameAllocs, g.frameAllocs);
+		g.steadyFrames = native == 0 ? g.steadyFrames + 1 : 0;
+
+		const f64 time = GetTime();
+		const f64 window = time - g.windowStart;
+		if (window >= MEM_RATE_WINDOW)
+		{
+			for (size_type i = 0; i < (size_type)eMemTag::COUNT; ++i)
+			{
+				auto& stat = g.stats[i];
+				const size_type allocs = mem_counters[i].allocs.load(std::memory_order_relaxed);
+				const size_type bytes = mem_counters[i].allocBytes.load(std::memory_order_relaxed);
+				stat.allocRate = (allocs - stat.windowAllocs) / window;
+				stat.byteRate = (bytes - stat.windowBytes) / window;
+				stat.windowAllocs = allocs;
+				stat.windowBytes = bytes;
+			}
+			g.windowStart = time;
+		}
+	}
+
+	void App::MemGuiRender(bool* open)
+	{
+		ImGui::SetNextWindowSize(ImVec2(700, 400), ImGuiCond_FirstUseEver);
+		if (!ImGui::Begin("Memory", open, ImGuiWindowFlags_NoSavedSettings))
+		{
+			ImGui::End();
+			return;
+		}
+
+		char a[32], b[32], c[32];
+		ImGui::Text("Native allocations: %u last frame | %u max | %u frames without any", g.frameAllocs, g.maxFrameAllocs, g.steadyFrames);
+		ImGui::SameLine();
+		if (ImGui::SmallButton("Reset"))
+		{
+			g.maxFrameAllocs = 0;
+			g.steadyFrames = 0;
+			for (auto& counter : mem_counters)
+				counter.peak = counter.bytes.load();
+			g.arena.peak = g.arena.used;
+		}
+		ImGui::Text("Untracked heap: %zu allocations last frame", g.heapFrameAllocs);
+		ImGui::Text("Frame arena: %s used | %s peak | %s capacity | %u grows",
+			mem_format(g.arena.used, a, sizeof(a)), mem_format(g.arena.peak, b, sizeof(b)), mem_format(g.arena.capacity, c, sizeof(c)), g.arena.grows);
+
+		if (ImGui::BeginTable("Tags", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			ImGui::TableSetupColumn("Tag");
+			ImGui::TableSetupColumn("Current");
+			ImGui::TableSetupColumn("Peak");
+			ImGui::TableSetupColumn("Allocs/frame");
+			ImGui::TableSetupColumn("Allocs/s");
+			ImGui::TableSetupColumn("Bytes/s");
+			ImGui::TableHeadersRow();
+
+			for (size_type i = 0; i < (size_type)eMemTag::COUNT; ++i)
+			{
+				const auto& counter = mem_counters[i];
+				const auto& stat = g.stats[i];
+
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(MEM_TAG_NAMES[i]);
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(mem_format(counter.bytes.load(std::memory_order_relaxed), a, sizeof(a)));
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(mem_format(counter.peak.load(std::memory_order_relaxed), b, sizeof(b)));
+				ImGui::TableNextColumn();
+				ImGui::Text("%zu", stat.frameAllocs);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.0f", stat.allocRate);
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(mem_format((size_type)stat.byteRate, c, sizeof(c)));
+			}
+
+			ImGui::EndTable();
+		}
+
+		ImGui::End();
+	}
+
+	void* App::MemAlloc(eMemTag tag, size_type size)
+	{
+		auto* header = static_cast<sMemHeader*>(std::malloc(MEM_HEADER_SIZE + size));
+		if (header == nullptr)
+			return nullptr;
+
+		header->size = size;
+		header->tag = tag;
+		mem_count_alloc(tag, size);
+		return reinterpret_cast<u8*>(header) + MEM_HEADER_SIZE;
+	}
+
+	void* App::MemRealloc(eMemTag tag, void* ptr, size_type size)
+	{
+		if (ptr == nullptr)
+			return MemAlloc(tag, size);
+
+		if (size == 0)
+		{
+			MemFree(ptr);
+			return nullptr;
+		}
+
+		auto* header = reinterpret_cast<sMemHeader*>(static_cast<u8*>(ptr) - MEM_HEADER_SIZE);
+		const sMemHeader old = *header;
+		header = static_cast<sMemHeader*>(std::realloc(header, MEM_HEADER_SIZE + size));
+		if (header == nullptr)
+			return nullptr;
+
+		mem_count_free(old);
+		header->size = size;
+		header->tag = tag;
+		mem_count_alloc(tag, size);
+		return reinterpret_cast<u8*>(header) + MEM_HEADER_SIZE;
+	}
+
+	void App::MemFree(void* ptr)
+	{
+		if (ptr == nullptr)
+			return;
+
+		auto* header = reinterpret_cast<sMemHeader*>(static_cast<u8*>(ptr) - MEM_HEADER_SIZE);
+		mem_count_free(*header);
+		std::free(header);
+	}
+
+	void* App::MemFrameAlloc(size_type size)
+	{
+		// Valid until the next frame starts, never hold it across frames or in jobs that outlive the frame
+		auto& arena = g.arena;
+		size = (size + MEM_ARENA_ALIGN - 1) & ~(MEM_ARENA_ALIGN - 1);
+		const size_type offset = arena.offset.fetch_add(size, std::memory_order_relaxed);
+		if (offset + size <= arena.capacity)
+			return arena.base + offset;
+
+		void* ptr = MemAlloc(eMemTag::APP, size);
+		std::lock_guard<std::mutex> lock(arena.mutex);
+		arena.overflow.push_back(ptr);
+		return ptr;
+	}
+
+	size_type App::MemBytes(eMemTag tag)
+	{
+		return mem_counters[(size_type)tag].bytes.load(std::memory_order_relaxed);
+	}
+
+	size_type App::MemTotalBytes()
+	{
+		size_type total = 0;
+		for (const auto& counter : mem_counters)
+			total += counter.bytes.load(std::memory_order_relaxed);
+		return total;
+	}
+
+	u32 App::MemFrameAllocs()
+	{
+		return g.frameAllocs;
+	}
+
+	void App::MemCountHeapAlloc()
+	{
+		mem_heap_allocs.fetch_add(1, std::memory_order_relaxed);
+	}
+}
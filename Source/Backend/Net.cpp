@@ -12,11 +12,12 @@ namespace GASandbox
 {
     using fNetcode = void (*)(bool, u32, eNetEvent, u16, u32, u32);
 
+    // Packet payloads live in one buffer cleared after every poll, it keeps its capacity so steady traffic never allocates
     struct sNetPacket
     {
         u32 id{ 0 };
         u32 size{ 0 };
-        char* data{ nullptr };
+        u32 offset{ 0 }; // Into the payload buffer
     };
 
     struct sNetClient
@@ -28,6 +29,7 @@ namespace GASandbox
     struct sNetGlobal
     {
         fNetcode netcodeFn{ nullptr };
+        bool started{ false }; // Enet comes up with the first host
 
         ENetHost* server{ nullptr };
         list<ENetPeer*> peers;
@@ -35,31 +37,49 @@ namespace GASandbox
         list<sNetClient> clients;
 
         list<sNetPacket> packets{};
+        tagged_list<char, eMemTag::NET> payloads{};
     };
     static sNetGlobal g{};
 
+    // Enet hosts and packets count as net memory
+    static void* net_malloc(size_t size) { return App::MemAlloc(eMemTag::NET, size); }
+    static void net_free(void* ptr) { App::MemFree(ptr); }
+
+    static char* net_data(const sNetPacket& packet)
+    {
+        return g.payloads.data() + packet.offset;
+    }
+
+    static u32 net_alloc_payload(u32 size)
+    {
+        const u32 offset = (u32)g.payloads.size();
+        g.payloads.resize(offset + size);
+        return offset;
+    }
+
     static ENetPacket* net_create_packet(const sNetPacket& packet, eNetPacketMode mode)
     {
-        int totalSize = sizeof(packet.id) + sizeof(packet.size) + packet.size;
-        char* buffer = new char[totalSize];
+        const size_type totalSize = sizeof(packet.id) + sizeof(packet.size) + packet.size;
 
+        // Written straight into the enet packet, no staging copy
+        enet_uint32 flags = (enet_uint32)mode;
+        ENetPacket* enetPacket = enet_packet_create(nullptr, totalSize, flags);
+        if (enetPacket == nullptr)
+            return nullptr;
+
+        char* buffer = (char*)enetPacket->data;
         u32 offset = 0;
         memcpy(buffer, &packet.id, sizeof(packet.id));
         offset += sizeof(packet.id);
         memcpy(buffer + offset, &packet.size, sizeof(packet.size));
         offset += sizeof(packet.size);
-        memcpy(buffer + offset, packet.data, packet.size);
-
-        enet_uint32 flags = (enet_uint32)mode;
-        ENetPacket* enetPacket = enet_packet_create(buffer, totalSize, flags);
+        memcpy(buffer + offset, net_data(packet), packet.size);
 
-        delete[] buffer;
         return enetPacket;
     }
 
-    static sNetPacket net_receive_packet(ENetPacket* packet)
+    static bool net_receive_packet(ENetPacket* packet, sNetPacket& received)
     {
-        sNetPacket received{};
 
         // Ensure packet is large enough to contain `id` and `size`
         const size_type headerSize = sizeof(sNetPacket::id) + sizeof(sNetPacket::size);
@@ -73,12 +93,9 @@ namespace GASandbox
 
             if (received.size > 0 && packet->dataLength >= headerSize + received.size)
             {
-                received.data = new char[received.size];
-                memcpy(received.data, (char*)packet->data + offset, received.size);
-            }
-            else
-            {
-                received.data = nullptr;
+                received.offset = net_alloc_payload(received.size);
+                memcpy(net_data(received), (char*)packet->data + offset, received.size);
+                return true;
             }
         }
         else
@@ -86,7 +103,7 @@ namespace GASandbox
             LOGE("Received packet too small! Size: %d", packet->dataLength);
         }
 
-        return received;
+        return false;
     }
 
     static void net_connect(const ENetEvent& e, bool server, u32 client)
@@ -106,9 +123,8 @@ namespace GASandbox
 
     static void net_receive(const ENetEvent& e, bool server, u32 client)
     {
-        auto received = net_receive_packet(e.packet);
-
-        if (received.data != nullptr)
+        sNetPacket received{};
+        if (net_receive_packet(e.packet, received))
         {
             g.packets.emplace_back(received);
             g.netcodeFn(server, client, eNetEvent::RECEIVE, e.peer->incomingPeerID, e.channelID, (u32)(g.packets.size() - 1));
@@ -169,14 +185,29 @@ namespace GASandbox
         return true;
     }
 
-    bool App::NetInitialize(const sAppConfig& config)
+    // Most scenes never open a socket, enet starts when the first server or client is created
+    static bool net_startup()
     {
-        if (enet_initialize() != 0)
+        if (g.started)
+            return true;
+
+        PROFILE("NetStartup");
+
+        ENetCallbacks callbacks{};
+        callbacks.malloc = net_malloc;
+        callbacks.free = net_free;
+        if (enet_initialize_with_callbacks(ENET_VERSION, &callbacks) != 0)
         {
             LOGE("Failed to initialize ENet.");
             return false;
         }
 
+        g.started = true;
+        return true;
+    }
+
+    bool App::NetInitialize(const sAppConfig& config)
+    {
         g.netcodeFn = App::CodeNetcode;
         return true;
     }
@@ -184,7 +215,9 @@ namespace GASandbox
     void App::NetShutdown()
     {
         NetReload();
-        enet_deinitialize();
+        if (g.started)
+            enet_deinitialize();
+        g.started = false;
     }
 
     void App::NetReload()
@@ -321,7 +354,7 @@ namespace GASandbox
 
     void App::NetStartServer(cstring ip, u32 port, u32 peerCount, u32 channelLimit)
     {
-        if (NetIsServer())
+        if (NetIsServer() || !net_startup())
             return;
 
         ENetAddress address{};
@@ -354,6 +387,9 @@ namespace GASandbox
 
     u32 App::NetConnectClient(cstring ip, u32 port, u32 peerCount, u32 channelLimit)
     {
+        if (!net_startup())
+            return -1;
+
         sNetClient client{};
         client.client = enet_host_create(nullptr, peerCount, channelLimit, 0, 0);
         if (client.client == nullptr)
@@ -417,7 +453,7 @@ namespace GASandbox
         sNetPacket packet{};
         memcpy(&packet.id, &id, sizeof(packet.id)); // Copy only the actual data
         packet.size = size;
-        packet.data = new char[size];
+        packet.offset = net_alloc_payload(size);
         g.packets.emplace_back(std::move(packet));
         return (u32)(g.packets.size() - 1);
     }
@@ -469,6 +505,8 @@ namespace GASandbox
 
     void App::NetPollEvents()
     {
+        PROFILE("NetPollEvents");
+
         if (g.server)
         {
             ENetEvent e{};
@@ -524,10 +562,9 @@ namespace GASandbox
             clientIdx++;
         }
 
-        // Free memory
-        for (const auto& p : g.packets)
-            delete[] p.data;
+        // Payloads are only valid until the next poll
         g.packets.clear();
+        g.payloads.clear();
     }
 
     bool App::NetGetBool(u32 packet, u32 offset)
@@ -539,7 +576,7 @@ namespace GASandbox
         if (!net_guard_packet(p.size, offset, 1))
             return false;
 
-        return p.data[offset] != 0;
+        return net_data(p)[offset] != 0;
     }
 
     u32 App::NetGetUInt(u32 packet, u32 offset)
@@ -552,7 +589,7 @@ namespace GASandbox
             return 0;
 
         u32 value;
-        std::memcpy(&value, p.data + offset, sizeof(u32));
+        std::memcpy(&value, net_data(p) + offset, sizeof(u32));
         return value;
     }
 
@@ -566,7 +603,7 @@ namespace GASandbox
             return 0;
 
         i32 value;
-        std::memcpy(&value, p.data + offset, sizeof(i32));
+        std::memcpy(&value, net_data(p) + offset, sizeof(i32));
         return value;
     }
 
@@ -580,7 +617,7 @@ namespace GASandbox
             return 0;
 
         f32 value;
-        std::memcpy(&value, p.data + offset, sizeof(f32));
+        std::memcpy(&value, net_data(p) + offset, sizeof(f32));
         return value;
     }
 
@@ -594,7 +631,7 @@ namespace GASandbox
             return 0;
 
         f64 value;
-        std::memcpy(&value, p.data + offset, sizeof(f64));
+        std::memcpy(&value, net_data(p) + offset, sizeof(f64));
         return value;
     }
 
@@ -607,7 +644,7 @@ namespace GASandbox
         if (!net_guard_packet(p.size, offset, p.size - offset))
             return "";
 
-        char* str = reinterpret_cast<char*>(p.data + offset);
+        char* str = reinterpret_cast<char*>(net_data(p) + offset);
         size_type maxLen = (size_type)p.size - offset;
 
         cstring end = static_cast<cstring>(std::memchr(str, '\0', maxLen));
@@ -629,7 +666,7 @@ namespace GASandbox
         if (!net_guard_packet(p.size, offset, 1))
             return;
 
-        p.data[offset] = v ? 1 : 0;
+        net_data(p)[offset] = v ? 1 : 0;
     }
 
     void App::NetSetUInt(u32 packet, u32 offset, u32 v)
@@ -641,7 +678,7 @@ namespace GASandbox
         if (!net_guard_packet(p.size, offset, sizeof(u32)))
             return;
 
-        std::memcpy(p.data + offset, &v, sizeof(u32));
+        std::memcpy(net_data(p) + offset, &v, sizeof(u32));
     }
 
     void App::NetSetInt(u32 packet, u32 offset, i32 v)
@@ -653,7 +690,7 @@ namespace GASandbox
         if (!net_guard_packet(p.size, offset, sizeof(i32)))
             return;
 
-        std::memcpy(p.data + offset, &v, sizeof(i32));
+        std::memcpy(net_data(p) + offset, &v, sizeof(i32));
     }
 
     void App::NetSetFloat(u32 packet, u32 offset, f32 v)
@@ -665,7 +702,7 @@ namespace GASandbox
         if (!net_guard_packet(p.size, offset, sizeof(f32)))
             return;
 
-        std::memcpy(p.data + offset, &v, sizeof(f32));
+        std::memcpy(net_data(p) + offset, &v, sizeof(f32));
     }
 
     void App::NetSetDouble(u32 packet, u32 offset, f64 v)
@@ -677,7 +714,7 @@ namespace GASandbox
         if (!net_guard_packet(p.size, offset, sizeof(f64)))
             return;
 
-        std::memcpy(p.data + offset, &v, sizeof(f64));
+        std::memcpy(net_data(p) + offset, &v, sizeof(f64));
     }
 
     void App::NetSetString(u32 packet, u32 offset, cstring v)
@@ -700,6 +737,6 @@ namespace GASandbox
         if (!net_guard_packet(p.size, offset, length))
             return;
 
-        std::memcpy(p.data + offset, v, length);
+        std::memcpy(net_data(p) + offset, v, length);
     }
 }
\ No newline at end of file
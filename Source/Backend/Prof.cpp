@@ -0,0 +1,501 @@
+#include <App.hpp>
+
+#include <imgui.h>
+
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <deque>
+#include <unordered_set>
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+
+namespace GASandbox
+{
+	// Zones are recorded into per thread single producer rings, only the owning thread writes its ring and
+	// ProfFrame drains every ring on the main thread once per frame. Zone names are kept by pointer.
+	constexpr u64 PROF_RING_SIZE = 1 << 14; // Must be a power of two
+	constexpr u32 PROF_STACK_SIZE = 64;
+	constexpr u32 PROF_THREAD_COUNT = 32;
+	constexpr u32 PROF_NAME_SIZE = 32;
+	constexpr u32 PROF_HISTORY_SIZE = 256; // Frames kept for the live view
+	constexpr size_type PROF_RECORD_SIZE = 1 << 20; // Events kept while recording
+
+	struct sProfEvent
+	{
+		cstring name{ nullptr };
+		i64 start{ 0 };
+		i64 end{ 0 };
+		u32 depth{ 0 };
+		u32 thread{ 0 };
+	};
+
+	struct sProfThread
+	{
+		char name[PROF_NAME_SIZE]{};
+		u32 id{ 0 };
+
+		// Head is written by the owning thread, tail by the collector
+		sProfEvent ring[PROF_RING_SIZE]{};
+		std::atomic<u64> head{ 0 };
+		std::atomic<u64> tail{ 0 };
+		std::atomic<u64> dropped{ 0 };
+
+		// Open zones, owning thread only
+		u32 depth{ 0 };
+		cstring stackName[PROF_STACK_SIZE]{};
+		i64 stackStart[PROF_STACK_SIZE]{};
+		bool stackScript[PROF_STACK_SIZE]{};
+	};
+
+	struct sProfStat
+	{
+		cstring name{ nullptr };
+		u32 thread{ 0 };
+		u32 calls{ 0 };
+		i64 total{ 0 };
+		i64 max{ 0 };
+	};
+
+	struct sProfGlobal
+	{
+		std::atomic<bool> enabled{ false };
+
+		// Threads are registered on their first zone and never freed, a ring may outlive its thread
+		sProfThread* threads[PROF_THREAD_COUNT]{};
+		std::atomic<u32> threadCount{ 0 };
+		std::mutex threadMutex{};
+
+		// Main thread
+		std::deque<sProfEvent> events{};
+		i64 frames[PROF_HISTORY_SIZE]{};
+		u64 frameCount{ 0 };
+		u64 dropped{ 0 };
+		bool recording{ false };
+
+		// Interned zone names from scripts, never released while zones may point at them
+		std::unordered_set<string> names{};
+		std::mutex nameMutex{};
+
+		// Gui
+		bool paused{ false };
+		i32 selected{ 0 };
+		list<sProfStat> stats{};
+	};
+	static sProfGlobal g{};
+
+	static thread_local sProfThread* t_thread{ nullptr };
+	static thread_local char t_threadName[PROF_NAME_SIZE]{};
+
+	static i64 prof_now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static sProfThread* prof_thread()
+	{
+		if (t_thread != nullptr)
+			return t_thread;
+
+		std::lock_guard<std::mutex> lock(g.threadMutex);
+		const u32 id = g.threadCount.load(std::memory_order_relaxed);
+		if (id >= PROF_THREAD_COUNT)
+			return nullptr;
+
+		auto* thread = new sProfThread();
+		thread->id = id;
+		if (t_threadName[0] != '\0')
+			std::snprintf(thread->name, PROF_NAME_SIZE, "%s", t_threadName);
+		else
+			std::snprintf(thread->name, PROF_NAME_SIZE, "Thread %u", id);
+
+		g.threads[id] = thread;
+		g.threadCount.store(id + 1, std::memory_order_release);
+
+		t_thread = thread;
+		return thread;
+	}
+
+	static void prof_collect()
+	{
+		const bool keep = !g.paused || g.recording;
+		const u32 count = g.threadCount.load(std::memory_order_acquire);
+		for (u32 t = 0; t < count; ++t)
+		{
+			auto* thread = g.threads[t];
+			const u64 head = thread->head.load(std::memory_order_acquire);
+			u64 tail = thread->tail.load(std::memory_order_relaxed);
+
+			for (; tail != head; ++tail)
+			{
+				if (keep)
+					g.events.push_back(thread->ring[tail & (PROF_RING_SIZE - 1)]);
+			}
+
+			thread->tail.store(tail, std::memory_order_release);
+			g.dropped += thread->dropped.exchange(0, std::memory_order_relaxed);
+		}
+
+		while (g.events.size() > PROF_RECORD_SIZE)
+		{
+			g.events.pop_front();
+			g.dropped++;
+		}
+	}
+
+	static i32 prof_frame_count()
+	{
+		return (i32)std::min<u64>(g.frameCount, PROF_HISTORY_SIZE) - 1;
+	}
+
+	// Frame k counts back from the last complete frame
+	static void prof_frame_range(i32 k, i64& start, i64& end)
+	{
+		start = g.frames[(g.frameCount - 2 - k) % PROF_HISTORY_SIZE];
+		end = g.frames[(g.frameCount - 1 - k) % PROF_HISTORY_SIZE];
+	}
+
+	static ImU32 prof_color(cstring name)
+	{
+		u32 hash = 2166136261u;
+		for (; *name; ++name)
+			hash = (hash ^ (u8)*name) * 16777619u;
+		return ImColor::HSV((hash % 360) / 360.0f, 0.55f, 0.75f);
+	}
+
+	static void prof_json_string(FILE* file, cstring str)
+	{
+		std::fputc('"', file);
+		for (; *str; ++str)
+		{
+			if (*str == '"' || *str == '\\')
+				std::fputc('\\', file);
+			std::fputc(*str, file);
+		}
+		std::fputc('"', file);
+	}
+
+	bool App::ProfBegin(cstring name)
+	{
+		if (!g.enabled.load(std::memory_order_relaxed))
+			return false;
+
+		auto* thread = prof_thread();
+		if (thread == nullptr || thread->depth >= PROF_STACK_SIZE)
+			return false;
+
+		thread->stackName[thread->depth] = name;
+		thread->stackStart[thread->depth] = prof_now();
+		thread->stackScript[thread->depth] = false;
+		thread->depth++;
+		return true;
+	}
+
+	void App::ProfEnd()
+	{
+		auto* thread = t_thread;
+		if (thread == nullptr || thread->depth == 0)
+			return;
+
+		const i64 end = prof_now();
+		thread->depth--;
+
+		// Full ring, the collector is behind so drop instead of blocking the caller
+		const u64 head = thread->head.load(std::memory_order_relaxed);
+		if (head - thread->tail.load(std::memory_order_acquire) >= PROF_RING_SIZE)
+		{
+			thread->dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		auto& ev = thread->ring[head & (PROF_RING_SIZE - 1)];
+		ev.name = thread->stackName[thread->depth];
+		ev.start = thread->stackStart[thread->depth];
+		ev.end = end;
+		ev.depth = thread->depth;
+		ev.thread = thread->id;
+		thread->head.store(head + 1, std::memory_order_release);
+	}
+
+	void App::ProfScriptBegin(cstring name)
+	{
+		if (ProfBegin(name))
+			t_thread->stackScript[t_thread->depth - 1] = true;
+	}
+
+	// A stray profEnd() must not close the native zone the script runs in
+	void App::ProfScriptEnd()
+	{
+		auto* thread = t_thread;
+		if (thread == nullptr || thread->depth == 0 || !thread->stackScript[thread->depth - 1])
+		{
+			LOGW("App.profEnd() without a matching App.profBegin(name).");
+			return;
+		}
+
+		ProfEnd();
+	}
+
+	// Closes the zones a script left open, when it returns or stops on an error
+	void App::ProfScriptClose()
+	{
+		auto* thread = t_thread;
+		while (thread != nullptr && thread->depth > 0 && thread->stackScript[thread->depth - 1])
+			ProfEnd();
+	}
+
+	void App::ProfThread(cstring name)
+	{
+		// Applied when the thread records its first zone, copied since callers may pass a temporary
+		std::snprintf(t_threadName, PROF_NAME_SIZE, "%s", name);
+	}
+
+	cstring App::ProfName(cstring name)
+	{
+		std::lock_guard<std::mutex> lock(g.nameMutex);
+		return g.names.insert(name).first->c_str();
+	}
+
+	void App::ProfEnable(bool enabled)
+	{
+		g.enabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	bool App::ProfIsEnabled()
+	{
+		return g.enabled.load(std::memory_order_relaxed);
+	}
+
+	void App::ProfRecord(bool recording)
+	{
+		if (recording && !g.recording)
+		{
+			prof_collect();
+			g.events.clear();
+			g.dropped = 0;
+		}
+
+		g.recording = recording;
+	}
+
+	void App::ProfFrame()
+	{
+		if (g.threadCount.load(std::memory_order_relaxed) == 0)
+			return;
+
+		const i64 now = prof_now();
+		prof_collect();
+
+		if (!ProfIsEnabled() || (g.paused && !g.recording))
+			return;
+
+		g.frames[g.frameCount % PROF_HISTORY_SIZE] = now;
+		g.frameCount++;
+
+		// Live view only keeps what the frame history can show
+		if (!g.recording && g.frameCount >= PROF_HISTORY_SIZE)
+		{
+			const i64 oldest = g.frames[g.frameCount % PROF_HISTORY_SIZE];
+			while (!g.events.empty() && g.events.front().end < oldest)
+				g.events.pop_front();
+		}
+	}
+
+	bool App::ProfSave(cstring filepath)
+	{
+		prof_collect();
+
+		FILE* file = std::fopen(filepath, "w");
+		if (file == nullptr)
+			return false;
+
+		i64 origin = g.events.empty() ? 0 : g.events.front().start;
+		for (const auto& ev : g.events)
+			origin = std::min(origin, ev.start);
+
+		std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+		bool first = true;
+		const u32 count = g.threadCount.load(std::memory_order_acquire);
+		for (u32 t = 0; t < count; ++t)
+		{
+			std::fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",", t);
+			prof_json_string(file, g.threads[t]->name);
+			std::fprintf(file, "}}");
+			first = false;
+		}
+
+		for (const auto& ev : g.events)
+		{
+			std::fprintf(file, "%s\n{\"name\":", first ? "" : ",");
+			prof_json_string(file, ev.name);
+			std::fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				ev.thread, (ev.start - origin) / 1000.0, (ev.end - ev.start) / 1000.0);
+			first = false;
+		}
+
+		std::fprintf(file, "\n]}\n");
+		std::fclose(file);
+		return true;
+	}
+
+	void App::ProfGuiRender(bool* open)
+	{
+		ImGui::SetNextWindowSize(ImVec2(900, 500), ImGuiCond_FirstUseEver);
+		if (!ImGui::Begin("Profiler", open, ImGuiWindowFlags_NoSavedSettings))
+		{
+			ImGui::End();
+			return;
+		}
+
+		bool enabled = ProfIsEnabled();
+		if (ImGui::Checkbox("Enabled", &enabled))
+			ProfEnable(enabled);
+		ImGui::SameLine();
+		ImGui::Checkbox("Pause", &g.paused);
+		ImGui::SameLine();
+		bool recording = g.recording;
+		if (ImGui::Checkbox("Record", &recording))
+			ProfRecord(recording);
+		ImGui::SameLine();
+		if (ImGui::Button("Save Trace"))
+		{
+			if (ProfSave("trace.json"))
+				LOGI("Saved %zu profiler zones to trace.json", g.events.size());
+			else
+				LOGW("Failed to save profiler trace!");
+		}
+		ImGui::SameLine();
+		ImGui::Text("| %zu zones | %llu dropped", g.events.size(), (unsigned long long)g.dropped);
+
+		const i32 count = prof_frame_count();
+		if (count <= 0)
+		{
+			ImGui::TextDisabled("No frames captured yet.");
+			ImGui::End();
+			return;
+		}
+
+		// Frame history, oldest on the left
+		f32 history[PROF_HISTORY_SIZE]{};
+		for (i32 k = 0; k < count; ++k)
+		{
+			i64 start, end;
+			prof_frame_range(k, start, end);
+			history[count - 1 - k] = (f32)((end - start) / 1e6);
+		}
+		ImGui::PlotHistogram("##Frames", history, count, 0, nullptr, 0.0f, FLT_MAX, ImVec2(-1, 60));
+
+		g.selected = std::min(g.selected, count - 1);
+		ImGui::SliderInt("Frame", &g.selected, 0, count - 1, "%d frames ago");
+
+		i64 frameStart, frameEnd;
+		prof_frame_range(g.selected, frameStart, frameEnd);
+		ImGui::Text("%.3f ms", (frameEnd - frameStart) / 1e6);
+
+		// Timeline, one lane per thread with nested zones stacked by depth
+		const u32 threadCount = g.threadCount.load(std::memory_order_acquire);
+		if (ImGui::BeginChild("Timeline", ImVec2(0, ImGui::GetContentRegionAvail().y * 0.6f), ImGuiChildFlags_Border))
+		{
+			ImDrawList* drawList = ImGui::GetWindowDrawList();
+			const f32 width = ImGui::GetContentRegionAvail().x;
+			const f32 barHeight = ImGui::GetTextLineHeight() + 2.0f;
+			const f64 scale = width / (f64)std::max<i64>(frameEnd - frameStart, 1);
+
+			for (u32 t = 0; t < threadCount; ++t)
+			{
+				u32 depth = 0;
+				for (const auto& ev : g.events)
+				{
+					if (ev.thread == t && ev.end >= frameStart && ev.start <= frameEnd)
+						depth = std::max(depth, ev.depth + 1);
+				}
+				if (depth == 0)
+					continue;
+
+				ImGui::TextUnformatted(g.threads[t]->name);
+				const ImVec2 origin = ImGui::GetCursorScreenPos();
+
+				for (const auto& ev : g.events)
+				{
+					if (ev.thread != t || ev.end < frameStart || ev.start > frameEnd)
+						continue;
+
+					const f32 x0 = origin.x + (f32)(std::max<i64>(ev.start - frameStart, 0) * scale);
+					const f32 x1 = std::max(x0 + 1.0f, origin.x + (f32)(std::min(ev.end - frameStart, frameEnd - frameStart) * scale));
+					const f32 y0 = origin.y + ev.depth * barHeight;
+					const ImVec2 min(x0, y0), max(x1, y0 + barHeight - 1.0f);
+
+					drawList->AddRectFilled(min, max, prof_color(ev.name));
+					drawList->PushClipRect(min, max, true);
+					drawList->AddText(ImVec2(x0 + 2.0f, y0 + 1.0f), 0xFFFFFFFF, ev.name);
+					drawList->PopClipRect();
+
+					if (ImGui::IsMouseHoveringRect(min, max))
+						ImGui::SetTooltip("%s\n%.3f ms", ev.name, (ev.end - ev.start) / 1e6);
+				}
+
+				ImGui::Dummy(ImVec2(width, depth * barHeight));
+			}
+		}
+		ImGui::EndChild();
+
+		// Zone totals of the selected frame
+		g.stats.clear();
+		for (const auto& ev : g.events)
+		{
+			if (ev.start < frameStart || ev.start >= frameEnd)
+				continue;
+
+			auto it = std::find_if(g.stats.begin(), g.stats.end(), [&ev](const sProfStat& stat)
+				{
+					return stat.thread == ev.thread && std::strcmp(stat.name, ev.name) == 0;
+				});
+			if (it == g.stats.end())
+			{
+				sProfStat stat{};
+				stat.name = ev.name;
+				stat.thread = ev.thread;
+				g.stats.push_back(stat);
+				it = g.stats.end() - 1;
+			}
+
+			const i64 duration = ev.end - ev.start;
+			it->calls++;
+			it->total += duration;
+			it->max = std::max(it->max, duration);
+		}
+		std::sort(g.stats.begin(), g.stats.end(), [](const sProfStat& a, const sProfStat& b) { return a.total > b.total; });
+
+		if (ImGui::BeginTable("Zones", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY))
+		{
+			ImGui::TableSetupColumn("Zone");
+			ImGui::TableSetupColumn("Thread");
+			ImGui::TableSetupColumn("Calls");
+			ImGui::TableSetupColumn("Total (ms)");
+			ImGui::TableSetupColumn("Max (ms)");
+			ImGui::TableHeadersRow();
+
+			for (const auto& stat : g.stats)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(stat.name);
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(g.threads[stat.thread]->name);
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", stat.calls);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", stat.total / 1e6);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", stat.max / 1e6);
+			}
+
+			ImGui::EndTable();
+		}
+
+		ImGui::End();
+	}
+}
@@ -10,22 +10,38 @@
 #include <algorithm>
 #include <cstring>
 #include <atomic>
+#include <mutex>
 
 namespace GASandbox
 {
     using fReadSample = bool (*)(f32&);
     using fIsCallbackBound = bool (*)();
 
+    // Short audio is decoded once to the device format on the job system, the handle is joined the first time it plays.
+    // Files past SFX_STREAM_BYTES only keep their encoded bytes and every instance decodes them while it plays.
+    // Frames live on the heap so playing instances keep a stable pointer while the audio list grows.
+    struct sSfxDecode
+    {
+        string path{};
+        f32* frames{ nullptr }; // Interleaved stereo at the device rate, freed with ma_free and the sfx allocator
+        ma_uint64 count{ 0 };
+        sFileView content{};    // Encoded file of streamed audio, frames stay null
+        sJobCounter counter{};
+    };
+
     struct sSfxInstance
     {
         u32 audio{ 0 };
-        ma_decoder decoder{};
+        const f32* frames{ nullptr };
+        ma_uint64 count{ 0 };
+        ma_uint64 cursor{ 0 };
+        ma_decoder* decoder{ nullptr }; // Streamed audio, read in the callback instead of the frames
         bool loop{ false };
     };
 
     struct sSfxAudio
     {
-        ma_decoder decoder{};
+        sSfxDecode* decode{ nullptr };
         f32 volume{ 1.0f };
         string filepath{};
     };
@@ -45,8 +61,12 @@ namespace GASandbox
     struct sSfxGlobal
     {
         ma_device device{};
+        bool headless{ false };
+        bool deviceStarted{ false };
+        bool deviceFailed{ false }; // Not retried every call
         list<sSfxAudio> audios{};
         list<sSfxChannel> channels{};
+        std::mutex instanceMutex{}; // Held by the callback while mixing, instances are only added or removed under it
 
         list<f32> buffer{};
         size_type capacity{ 0 };
@@ -61,34 +81,212 @@ namespace GASandbox
     };
     static sSfxGlobal g;
 
+    constexpr size_type SFX_BLOB_HEADER = 16; // Frame count, padded so the cached frames stay aligned
+    constexpr size_type SFX_STREAM_BYTES = 1 << 20; // Encoded files past this stream, music would decode to tens of MB
+    constexpr ma_uint32 SFX_STREAM_FRAMES = 512; // Frames a streamed instance decodes at a time in the callback
+
+    // Decoded frames count as audio memory
+    static void* sfx_malloc(size_t size, void* user) { return App::MemAlloc(eMemTag::AUDIO, size); }
+    static void* sfx_realloc(void* ptr, size_t size, void* user) { return App::MemRealloc(eMemTag::AUDIO, ptr, size); }
+    static void sfx_free(void* ptr, void* user) { App::MemFree(ptr); }
+    static const ma_allocation_callbacks sfx_allocator = { nullptr, sfx_malloc, sfx_realloc, sfx_free };
+
+    static bool sfx_read_blob(const sFileView& view, sSfxDecode* decode)
+    {
+        ma_uint64 count = 0;
+        if (view.size >= SFX_BLOB_HEADER)
+            std::memcpy(&count, view.data, sizeof(count));
+        const size_type bytes = (size_type)count * 2 * sizeof(f32);
+        if (count == 0 || view.size < SFX_BLOB_HEADER + bytes)
+            return false;
+
+        decode->frames = static_cast<f32*>(App::MemAlloc(eMemTag::AUDIO, bytes));
+        decode->count = count;
+        std::memcpy(decode->frames, view.data + SFX_BLOB_HEADER, bytes);
+        return true;
+    }
+
+    static void sfx_write_blob(const sSfxDecode* decode, list<u8>& payload)
+    {
+        const size_type bytes = (size_type)decode->count * 2 * sizeof(f32);
+        payload.assign(SFX_BLOB_HEADER + bytes, 0);
+        std::memcpy(payload.data(), &decode->count, sizeof(decode->count));
+        std::memcpy(payload.data() + SFX_BLOB_HEADER, decode->frames, bytes);
+    }
+
+    static ma_decoder_config sfx_decoder_config()
+    {
+        ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 2, 48000);
+        config.allocationCallbacks = sfx_allocator;
+        return config;
+    }
+
+    static bool sfx_decode_memory(const sFileView& content, sSfxDecode* decode)
+    {
+        ma_decoder_config config = sfx_decoder_config();
+        void* frames = nullptr;
+        if (ma_decode_memory(content.data, content.size, &config, &decode->count, &frames) != MA_SUCCESS)
+        {
+            decode->count = 0;
+            return false;
+        }
+        decode->frames = static_cast<f32*>(frames);
+        return true;
+    }
+
+    static void sfx_decode_audio(void* data)
+    {
+        PROFILE("SfxDecodeAudio");
+
+        auto* decode = static_cast<sSfxDecode*>(data);
+
+        // Baked audio is already resampled to the device format, the source isn't read at all
+        {
+            const auto baked = App::FileBakedLoad(decode->path.c_str(), "audio 1 f32 2 48000");
+            if (!baked.empty() && sfx_read_blob(baked, decode))
+                return;
+        }
+
+        auto content = App::FileMap(decode->path.c_str());
+        if (content.empty())
+            return;
+
+        // Long files are kept encoded, the decoder is only checked here so a bad file fails like a short one
+        if (content.size > SFX_STREAM_BYTES)
+        {
+            ma_decoder decoder{};
+            ma_decoder_config config = sfx_decoder_config();
+            if (ma_decoder_init_memory(content.data, content.size, &config, &decoder) != MA_SUCCESS)
+                return;
+            ma_decoder_uninit(&decoder);
+            decode->content = std::move(content);
+            return;
+        }
+
+        // Cached as PCM after the frame count, in the output format below
+        const size_type key = App::FileCacheKey(content, "audio 1 f32 2 48000");
+        const auto cached = App::FileCacheLoad(key);
+        if (!cached.empty())
+        {
+            if (sfx_read_blob(cached, decode))
+                return;
+            App::FileCacheReject(key);
+        }
+
+        if (!sfx_decode_memory(content, decode))
+            return;
+
+        list<u8> payload{};
+        sfx_write_blob(decode, payload);
+        App::FileCacheStore(key, payload.data(), payload.size());
+    }
+
+    static sSfxDecode* sfx_join_audio(sSfxAudio& audio)
+    {
+        if (audio.decode == nullptr)
+            return nullptr;
+
+        App::JobWait(audio.decode->counter);
+        return audio.decode;
+    }
+
+    static bool sfx_streamed(const sSfxDecode* decode)
+    {
+        return !decode->content.empty();
+    }
+
+    // Called with the instance mutex held or once the instance left its channel
+    static void sfx_release_instance(sSfxInstance& instance)
+    {
+        if (instance.decoder == nullptr)
+            return;
+
+        ma_decoder_uninit(instance.decoder);
+        delete instance.decoder;
+        instance.decoder = nullptr;
+    }
+
+    static void sfx_clear_instances(sSfxChannel& channel)
+    {
+        std::lock_guard<std::mutex> lock(g.instanceMutex);
+        for (auto& instance : channel.instances)
+            sfx_release_instance(instance);
+        channel.instances.clear();
+    }
+
+    // Streamed instances decode into a stack block and mix it, looping seeks back to the first frame
+    static void sfx_mix_stream(sSfxInstance& instance, f32* out, ma_uint32 frameCount, f32 volume)
+    {
+        f32 block[SFX_STREAM_FRAMES * 2];
+        ma_uint32 done = 0;
+        while (done < frameCount)
+        {
+            const ma_uint32 want = std::min<ma_uint32>(frameCount - done, SFX_STREAM_FRAMES);
+            ma_uint64 framesRead = 0;
+            ma_decoder_read_pcm_frames(instance.decoder, block, want, &framesRead);
+            for (ma_uint64 i = 0; i < framesRead * 2; ++i)
+            {
+                out[done * 2 + i] += block[i] * volume;
+            }
+            done += static_cast<ma_uint32>(framesRead);
+            instance.cursor += framesRead;
+
+            // An instance that read nothing since its first frame has nothing to loop
+            if (framesRead < want)
+            {
+                if (!instance.loop || instance.cursor == 0 || ma_decoder_seek_to_pcm_frame(instance.decoder, 0) != MA_SUCCESS)
+                    break;
+                instance.cursor = 0;
+            }
+        }
+    }
+
+    static void sfx_free_audio(sSfxAudio& audio)
+    {
+        auto* decode = sfx_join_audio(audio);
+        if (decode == nullptr)
+            return;
+
+        ma_free(decode->frames, &sfx_allocator);
+        delete decode;
+        audio.decode = nullptr;
+    }
+
     static void sfx_data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount)
     {
+        App::ProfThread("Audio");
+        PROFILE("SfxCallback");
+
         auto* data = static_cast<sSfxGlobal*>(pDevice->pUserData);
         f32* out = static_cast<f32*>(pOutput);
         std::memset(out, 0, frameCount * sizeof(f32) * 2);
 
+        std::unique_lock<std::mutex> lock(data->instanceMutex);
         for (auto& channel : data->channels)
         {
             if (!channel.active) continue;
 
             for (auto& instance : channel.instances)
             {
-                list<f32> tempBuffer(frameCount * 2);
-                ma_uint64 framesRead;
-                ma_decoder_read_pcm_frames(&instance.decoder, tempBuffer.data(), frameCount, &framesRead);
-
-                if (framesRead == 0 && instance.loop)
+                if (instance.decoder != nullptr)
                 {
-                    ma_decoder_seek_to_pcm_frame(&instance.decoder, 0);
-                    ma_decoder_read_pcm_frames(&instance.decoder, tempBuffer.data(), frameCount, &framesRead);
+                    sfx_mix_stream(instance, out, frameCount, channel.volume);
+                    continue;
                 }
 
+                if (instance.cursor >= instance.count && instance.loop)
+                    instance.cursor = 0;
+
+                const ma_uint64 framesRead = std::min<ma_uint64>(frameCount, instance.count - std::min(instance.cursor, instance.count));
+                const f32* frames = instance.frames + instance.cursor * 2;
                 for (ma_uint32 i = 0; i < framesRead * 2; ++i)
                 {
-                    out[i] += tempBuffer[i] * channel.volume;
+                    out[i] += frames[i] * channel.volume;
                 }
+                instance.cursor += framesRead;
             }
         }
+        lock.unlock();
 
         if (data->fisCallbackBound())
         {
@@ -108,12 +306,13 @@ namespace GASandbox
         (void)pInput;
     }
 
-    bool App::SfxInitialize(const sAppConfig& config)
+    // The playback device is opened the first time something plays, never headless
+    static bool sfx_start_device()
     {
-        g.capacity = (size_type)48000 * 2 + 1;
-        g.buffer.resize(g.capacity);
-        g.freadSample = App::SfxReadSample;
-        g.fisCallbackBound = App::SfxIsCallbackBound;
+        if (g.deviceStarted || g.deviceFailed || g.headless)
+            return g.deviceStarted;
+
+        PROFILE("SfxStartDevice");
 
         ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
         deviceConfig.playback.format = ma_format_f32;
@@ -125,20 +324,37 @@ namespace GASandbox
         if (ma_device_init(nullptr, &deviceConfig, &g.device) != MA_SUCCESS)
         {
             LOGE("Failed to initialize playback device.");
+            g.deviceFailed = true;
             return false;
         }
         ma_device_start(&g.device);
+        g.deviceStarted = true;
+        return true;
+    }
+
+    bool App::SfxInitialize(const sAppConfig& config)
+    {
+        g.capacity = (size_type)48000 * 2 + 1;
+        g.buffer.resize(g.capacity);
+        g.freadSample = App::SfxReadSample;
+        g.fisCallbackBound = App::SfxIsCallbackBound;
+        g.headless = config.headless;
         return true;
     }
 
     void App::SfxShutdown()
     {
         SfxReload();
-        ma_device_uninit(&g.device);
+        if (g.deviceStarted)
+            ma_device_uninit(&g.device);
+        g.deviceStarted = false;
+        g.deviceFailed = false;
     }
 
     void App::SfxUpdate(f64 dt)
     {
+        PROFILE("SfxUpdate");
+
         if (!SfxIsCallbackBound())
             return;
 
@@ -213,20 +429,19 @@ namespace GASandbox
 
         for (auto& channel : g.channels)
         {
-            for (auto& inst : channel.instances)
-            {
-                ma_decoder_uninit(&inst.decoder);
-            }
-            channel.instances.clear();
+            sfx_clear_instances(channel);
         }
 
-        for (auto& audio : g.audios)
+        for (u32 i = 0; i < g.audios.size(); ++i)
         {
-            ma_decoder_uninit(&audio.decoder);
+            sfx_free_audio(g.audios[i]);
         }
 
         g.audios.clear();
-        g.channels.clear();
+        {
+            std::lock_guard<std::mutex> lock(g.instanceMutex);
+            g.channels.clear();
+        }
 
         // Audio API
         CodeBindMethod("app", "App", true, "sfxBindCallback()",
@@ -258,6 +473,13 @@ namespace GASandbox
                 CodeSetSlotUInt(vm, 0, audio);
             });
 
+        CodeBindMethod("app", "App", true, "sfxAudioReady(_)",
+            [](sCodeVM* vm)
+            {
+                CodeEnsureSlots(vm, 1);
+                CodeSetSlotBool(vm, 0, SfxAudioReady(CodeGetSlotUInt(vm, 1)));
+            });
+
         CodeBindMethod("app", "App", true, "sfxDestroyAudio(_)",
             [](sCodeVM* vm)
             {
@@ -326,6 +548,7 @@ namespace GASandbox
 
     void App::SfxBindCallback()
     {
+        sfx_start_device();
         SfxClearSamples();
         g.callbackBound.store(true, std::memory_order_release);
     }
@@ -340,33 +563,72 @@ namespace GASandbox
         return g.callbackBound.load(std::memory_order_acquire);
     }
 
+    bool App::SfxBakeAudio(cstring filepath)
+    {
+        PROFILE("SfxBakeAudio");
+
+        if (FileBakedFresh(filepath, "audio 1 f32 2 48000"))
+            return true;
+
+        // Streamed audio is played from the source, baking it would load it whole
+        const auto content = FileMap(filepath);
+        if (content.size > SFX_STREAM_BYTES)
+            return true;
+
+        sSfxDecode decode{};
+        if (!sfx_decode_memory(content, &decode))
+        {
+            LOGW("Failed to bake audio: %s", filepath);
+            return false;
+        }
+
+        list<u8> payload{};
+        sfx_write_blob(&decode, payload);
+        ma_free(decode.frames, &sfx_allocator);
+        return FileBakedStore(filepath, "audio 1 f32 2 48000", payload.data(), payload.size());
+    }
+
     u32 App::SfxLoadAudio(cstring filepath)
     {
+        PROFILE("SfxLoadAudio");
+
         cstring path = FilePath(filepath);
 
         sSfxAudio audio;
         audio.filepath = path;
-
-        if (ma_decoder_init_file(path, nullptr, &audio.decoder) != MA_SUCCESS)
-        {
-            LOGW("Failed to load audio: %s", filepath);
-            return 0;
-        }
+        audio.decode = new sSfxDecode();
+        audio.decode->path = filepath;
+        JobSubmit(sfx_decode_audio, audio.decode, &audio.decode->counter);
 
         g.audios.push_back(audio);
         return static_cast<u32>(g.audios.size());
     }
 
+    bool App::SfxAudioReady(u32 audio)
+    {
+        if (audio == 0 || audio > g.audios.size())
+            return false;
+
+        const auto* decode = g.audios[static_cast<size_type>(audio) - 1].decode;
+        return decode == nullptr || decode->counter.pending.load(std::memory_order_acquire) == 0;
+    }
+
     void App::SfxDestroyAudio(u32 audio)
     {
         auto aud = sfx_get_audio(audio);
         if (aud == nullptr) return;
-        ma_decoder_uninit(&aud->decoder);
+
+        // Instances read the frames directly
+        for (u32 i = 0; i < g.channels.size(); ++i)
+            SfxStop(audio, i + 1);
+
+        sfx_free_audio(*aud);
         *aud = sSfxAudio{};
     }
 
     u32 App::SfxCreateChannel(f32 volume)
     {
+        std::lock_guard<std::mutex> lock(g.instanceMutex);
         g.channels.emplace_back(sSfxChannel{ volume, true });
         return static_cast<u32>(g.channels.size());
     }
@@ -377,11 +639,7 @@ namespace GASandbox
         if (chn == nullptr)
             return;
 
-        for (auto& inst : chn->instances)
-        {
-            ma_decoder_uninit(&inst.decoder);
-        }
-
+        sfx_clear_instances(*chn);
         *chn = sSfxChannel{};
     }
 
@@ -402,15 +660,35 @@ namespace GASandbox
         if (aud == nullptr || chn == nullptr)
             return;
 
+        auto decode = sfx_join_audio(*aud);
+        if (decode == nullptr || (decode->frames == nullptr && !sfx_streamed(decode)))
+        {
+            LOGW("Failed to load audio: %s", aud->filepath.c_str());
+            return;
+        }
+
         sSfxInstance instance;
         instance.audio = audio;
+        instance.frames = decode->frames;
+        instance.count = decode->count;
+        instance.loop = loop;
 
-        if (ma_decoder_init_file(aud->filepath.c_str(), nullptr, &instance.decoder) != MA_SUCCESS)
+        // Each instance of streamed audio reads the shared encoded bytes with its own decoder
+        if (sfx_streamed(decode))
         {
-            LOGW("Failed to initialize decoder for playback.");
-            return;
+            instance.decoder = new ma_decoder();
+            ma_decoder_config config = sfx_decoder_config();
+            if (ma_decoder_init_memory(decode->content.data, decode->content.size, &config, instance.decoder) != MA_SUCCESS)
+            {
+                LOGW("Failed to stream audio: %s", aud->filepath.c_str());
+                delete instance.decoder;
+                return;
+            }
         }
-        instance.loop = loop;
+
+        sfx_start_device();
+
+        std::lock_guard<std::mutex> lock(g.instanceMutex);
         chn->instances.push_back(instance);
     }
 
@@ -422,12 +700,13 @@ namespace GASandbox
         if (aud == nullptr || chn == nullptr)
             return;
 
+        std::lock_guard<std::mutex> lock(g.instanceMutex);
         auto& instances = chn->instances;
         for (size_type i = 0; i < instances.size(); )
         {
             if (instances[i].audio == audio)
             {
-                ma_decoder_uninit(&instances[i].decoder);
+                sfx_release_instance(instances[i]);
                 instances.erase(instances.begin() + i);
             }
             else
@@ -4,8 +4,21 @@
 #include <GLFW/glfw3native.h>
 #include <backends/imgui_impl_glfw.h>
 
+#include <chrono>
+
 namespace GASandbox
 {
+	// Input captured at the pipeline handoff, the simulation thread reads it instead of glfw (main thread only)
+	struct sWinInput
+	{
+		i32 width{ 0 }, height{ 0 };
+		f64 mouseX{ 0 }, mouseY{ 0 };
+		bool buttons[GLFW_MOUSE_BUTTON_LAST + 1]{};
+		bool keys[GLFW_KEY_LAST + 1]{};
+		bool pads[GLFW_JOYSTICK_LAST + 1]{};
+		GLFWgamepadstate padStates[GLFW_JOYSTICK_LAST + 1]{};
+	};
+
 	struct sWinGlobal
 	{
 		// Window
@@ -13,6 +26,18 @@ namespace GASandbox
 		eWinMode winMode{ eWinMode::WINDOWED };
 		i32 winX{ 0 }, winY{ 0 };
 		i32 winWidth{ 0 }, winHeight{ 0 };
+
+		// Pipelined frames, queries read the snapshot and window changes wait for the next handoff
+		bool deferred{ false };
+		sWinInput input{};
+		i32 pendingMode{ -1 };
+		i32 pendingCursor{ -1 };
+		i32 pendingOnTop{ -1 };
+		bool pendingClose{ false };
+
+		// Headless, no window or glfw
+		bool closed{ false };
+		std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
 	};
 	static sWinGlobal g{};
 
@@ -23,6 +48,14 @@ namespace GASandbox
 
 	bool App::WinInitialize(const sAppConfig& config)
 	{
+		// Headless keeps the configured size for scripts and never touches glfw
+		if (config.headless)
+		{
+			g.winWidth = config.width;
+			g.winHeight = config.height;
+			return true;
+		}
+
 		glfwSetErrorCallback(glfw_error_callback);
 		if (!glfwInit())
 		{
@@ -106,6 +139,9 @@ namespace GASandbox
 
 	void App::WinShutdown()
 	{
+		if (g.window == nullptr)
+			return;
+
 		glfwDestroyWindow(g.window);
 		glfwTerminate();
 	}
@@ -223,21 +259,71 @@ namespace GASandbox
 
 	void App::WinPollEvents()
 	{
+		PROFILE("WinPollEvents");
+
+		if (g.window == nullptr)
+			return;
+
 		glfwPollEvents();
 	}
 
+	void App::WinDefer(bool enabled)
+	{
+		g.deferred = enabled && g.window != nullptr;
+	}
+
+	void App::WinHandoff()
+	{
+		PROFILE("WinHandoff");
+
+		if (g.window == nullptr)
+			return;
+
+		// Apply what the simulation asked for during its frame
+		const bool deferred = g.deferred;
+		g.deferred = false;
+		if (g.pendingMode >= 0) WinMode((eWinMode)g.pendingMode);
+		if (g.pendingCursor >= 0) WinCursor((eWinCursor)g.pendingCursor);
+		if (g.pendingOnTop >= 0) WinAlwaysOnTop(g.pendingOnTop != 0);
+		if (g.pendingClose) WinClose();
+		g.pendingMode = g.pendingCursor = g.pendingOnTop = -1;
+		g.pendingClose = false;
+		g.deferred = deferred;
+
+		auto& in = g.input;
+		glfwGetWindowSize(g.window, &in.width, &in.height);
+		glfwGetCursorPos(g.window, &in.mouseX, &in.mouseY);
+		for (i32 b = 0; b <= GLFW_MOUSE_BUTTON_LAST; ++b)
+			in.buttons[b] = glfwGetMouseButton(g.window, b) == GLFW_PRESS;
+		for (i32 k = GLFW_KEY_SPACE; k <= GLFW_KEY_LAST; ++k)
+			in.keys[k] = glfwGetKey(g.window, k) == GLFW_PRESS;
+		for (i32 i = 0; i <= GLFW_JOYSTICK_LAST; ++i)
+			in.pads[i] = glfwJoystickPresent(GLFW_JOYSTICK_1 + i) && glfwGetGamepadState(GLFW_JOYSTICK_1 + i, &in.padStates[i]);
+	}
+
 	bool App::WinShouldClose()
 	{
+		if (g.window == nullptr)
+			return g.closed;
+
 		return glfwWindowShouldClose(g.window);
 	}
 
 	void App::WinSwapBuffers()
 	{
+		PROFILE("WinSwapBuffers");
+
+		if (g.window == nullptr)
+			return;
+
 		glfwSwapBuffers(g.window);
 	}
 
 	f64 App::GetTime()
 	{
+		if (g.window == nullptr)
+			return std::chrono::duration<f64>(std::chrono::steady_clock::now() - g.start).count();
+
 		return glfwGetTime();
 	}
 
@@ -248,8 +334,14 @@ namespace GASandbox
 
 	void App::WinMode(eWinMode mode)
 	{
+		if (g.deferred)
+		{
+			g.pendingMode = (i32)mode;
+			return;
+		}
+
 		auto winMode = mode;
-		if (winMode == g.winMode)
+		if (winMode == g.winMode || g.window == nullptr)
 			return;
 
 		GLFWmonitor* pMonitor = glfwGetPrimaryMonitor();
@@ -286,16 +378,39 @@ namespace GASandbox
 
 	void App::WinCursor(eWinCursor cursor)
 	{
+		if (g.window == nullptr)
+			return;
+
+		if (g.deferred)
+		{
+			g.pendingCursor = (i32)cursor;
+			return;
+		}
+
 		glfwSetInputMode(g.window, GLFW_CURSOR, (i32)cursor);
 	}
 
 	void App::WinAlwaysOnTop(bool enabled)
 	{
+		if (g.window == nullptr)
+			return;
+
+		if (g.deferred)
+		{
+			g.pendingOnTop = enabled ? 1 : 0;
+			return;
+		}
+
 		glfwSetWindowAttrib(g.window, GLFW_FLOATING, enabled ? GLFW_TRUE : GLFW_FALSE);
 	}
 
 	i32 App::WinWidth()
 	{
+		if (g.window == nullptr)
+			return g.winWidth;
+		if (g.deferred)
+			return g.input.width;
+
 		i32 w, h;
 		glfwGetWindowSize(g.window, &w, &h);
 		return w;
@@ -303,6 +418,11 @@ namespace GASandbox
 
 	i32 App::WinHeight()
 	{
+		if (g.window == nullptr)
+			return g.winHeight;
+		if (g.deferred)
+			return g.input.height;
+
 		i32 w, h;
 		glfwGetWindowSize(g.window, &w, &h);
 		return h;
@@ -310,6 +430,11 @@ namespace GASandbox
 
 	f64 App::WinMouseX()
 	{
+		if (g.window == nullptr)
+			return 0;
+		if (g.deferred)
+			return g.input.mouseX;
+
 		f64 x, y;
 		glfwGetCursorPos(g.window, &x, &y);
 		return x;
@@ -317,6 +442,11 @@ namespace GASandbox
 
 	f64 App::WinMouseY()
 	{
+		if (g.window == nullptr)
+			return 0;
+		if (g.deferred)
+			return g.input.mouseY;
+
 		f64 x, y;
 		glfwGetCursorPos(g.window, &x, &y);
 		return y;
@@ -324,21 +454,33 @@ namespace GASandbox
 
 	bool App::WinButton(i32 b)
 	{
+		if (g.window == nullptr)
+			return false;
+		if (g.deferred)
+			return b >= 0 && b <= GLFW_MOUSE_BUTTON_LAST && g.input.buttons[b];
+
 		return glfwGetMouseButton(g.window, b) == GLFW_PRESS;
 	}
 
 	bool App::WinKey(i32 k)
 	{
-		GLFW_KEY_W;
+		if (g.window == nullptr)
+			return false;
+		if (g.deferred)
+			return k >= 0 && k <= GLFW_KEY_LAST && g.input.keys[k];
+
 		return glfwGetKey(g.window, k) == GLFW_PRESS;
 	}
 
 	i32 App::WinPadCount()
 	{
+		if (g.window == nullptr)
+			return 0;
+
 		i32 count = 0;
 		for (i32 i = 0; i < 16; ++i)
 		{
-			if (glfwJoystickPresent(GLFW_JOYSTICK_1 + i))
+			if (g.deferred ? g.input.pads[i] : glfwJoystickPresent(GLFW_JOYSTICK_1 + i))
 				++count;
 		}
 		return count;
@@ -346,6 +488,11 @@ namespace GASandbox
 
 	bool App::WinPadButton(i32 i, i32 b)
 	{
+		if (g.window == nullptr)
+			return false;
+		if (g.deferred)
+			return i >= 0 && i <= GLFW_JOYSTICK_LAST && g.input.pads[i] && g.input.padStates[i].buttons[b] == GLFW_PRESS;
+
 		GLFWgamepadstate state;
 		return glfwJoystickPresent(GLFW_JOYSTICK_1 + i) &&
 			glfwGetGamepadState(GLFW_JOYSTICK_1 + i, &state) &&
@@ -354,6 +501,11 @@ namespace GASandbox
 
 	f32 App::WinPadAxis(i32 i, i32 a)
 	{
+		if (g.window == nullptr)
+			return 0;
+		if (g.deferred)
+			return i >= 0 && i <= GLFW_JOYSTICK_LAST && g.input.pads[i] ? g.input.padStates[i].axes[a] : 0.0f;
+
 		GLFWgamepadstate state;
 		return glfwJoystickPresent(GLFW_JOYSTICK_1 + i) &&
 			glfwGetGamepadState(GLFW_JOYSTICK_1 + i, &state) ? state.axes[a] : 0.0f;
@@ -361,6 +513,18 @@ namespace GASandbox
 
 	void App::WinClose()
 	{
+		if (g.window == nullptr)
+		{
+			g.closed = true;
+			return;
+		}
+
+		if (g.deferred)
+		{
+			g.pendingClose = true;
+			return;
+		}
+
 		glfwSetWindowShouldClose(g.window, GLFW_TRUE);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,10 @@
+#include <App.hpp>
+
+using namespace GASandbox;
+
+// Offline asset bake, built with the GASANDBOX_BAKE option (on by default).
+// Usage: GASandboxBake [--baked <dir>] [--jobs <n>], only sources changed since their last bake are processed.
+int main(int argc, char** args)
+{
+	return App::Bake(argc, args);
+}
@@ -0,0 +1,311 @@
+#include <App.hpp>
+#include "Backend/GlRing.hpp"
+
+#include <iostream>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <ctime>
+
+using namespace GASandbox;
+
+// Native micro benchmarks, built with -DGASANDBOX_BENCH=ON.
+// Usage: GASandboxBench [filter], runs every benchmark whose name contains the filter.
+
+using fBenchCall = void (*)(u32 thread, u32 i);
+using bench_clock = std::chrono::steady_clock;
+
+struct sBenchResult
+{
+	f64 seconds{ 0 };
+	f64 drainSeconds{ 0 };
+	f64 p50{ 0 }, p99{ 0 }, max{ 0 };
+};
+
+static sBenchResult bench_run(u32 threads, u32 count, fBenchCall call, void (*drain)())
+{
+	list<list<f64>> latencies(threads);
+	list<std::thread> workers;
+
+	auto start = bench_clock::now();
+	for (u32 t = 0; t < threads; ++t)
+	{
+		workers.emplace_back([t, count, call, &latencies]()
+			{
+				auto& lat = latencies[t];
+				lat.resize(count);
+				for (u32 i = 0; i < count; ++i)
+				{
+					auto t0 = bench_clock::now();
+					call(t, i);
+					auto t1 = bench_clock::now();
+					lat[i] = std::chrono::duration<f64, std::micro>(t1 - t0).count();
+				}
+			});
+	}
+	for (auto& w : workers)
+		w.join();
+	auto end = bench_clock::now();
+
+	if (drain)
+		drain();
+	auto drained = bench_clock::now();
+
+	list<f64> all;
+	for (const auto& lat : latencies)
+		all.insert(all.end(), lat.begin(), lat.end());
+	std::sort(all.begin(), all.end());
+
+	sBenchResult res{};
+	res.seconds = std::chrono::duration<f64>(end - start).count();
+	res.drainSeconds = std::chrono::duration<f64>(drained - start).count();
+	res.p50 = all[all.size() / 2];
+	res.p99 = all[(size_type)(all.size() * 0.99)];
+	res.max = all.back();
+	return res;
+}
+
+static void bench_report(cstring name, u32 threads, u32 count, const sBenchResult& res)
+{
+	const f64 total = (f64)threads * count;
+	std::printf("%-16s %2u threads | %10.0f calls/s | %10.0f drained/s | p50 %7.2f us | p99 %8.2f us | max %9.2f us\n",
+		name, threads, total / res.seconds, total / res.drainSeconds, res.p50, res.p99, res.max);
+}
+
+// Log: previous synchronous App::Log, kept here as the baseline
+namespace legacy
+{
+	struct sLogData
+	{
+		u32 color{ 0xFFFFFFFF };
+		string message{};
+		size_type hash{ 0 };
+		size_type count{ 0 };
+	};
+
+	static list<sLogData> logs{};
+	static hashmap<size_type, size_type> logsHash{};
+	static std::mutex logMutex{};
+
+	static void Log(bool verbose, cstring file, i32 line, cstring func, u32 color, cstring format, ...)
+	{
+		static string buffer;
+
+		std::lock_guard<std::mutex> lock(logMutex);
+
+		auto now = std::chrono::system_clock::now();
+		auto in_time_t = std::chrono::system_clock::to_time_t(now);
+
+		std::ostringstream ss;
+		ss << std::put_time(std::localtime(&in_time_t), "[%Y-%m-%d %H:%M:%S]");
+		string timestamp = ss.str();
+
+		va_list args;
+		va_start(args, format);
+		va_list args_copy;
+		va_copy(args_copy, args);
+		i32 size = std::vsnprintf(nullptr, 0, format, args_copy);
+		va_end(args_copy);
+		buffer.resize(size + 1);
+		std::vsnprintf(&buffer[0], buffer.size(), format, args);
+		va_end(args);
+
+		cstring filename = std::max(strrchr(file, '/'), strrchr(file, '\\'));
+		filename = filename ? filename + 1 : file;
+
+		static std::hash<string> g_hash{};
+		size_type hash = g_hash(func) ^ g_hash(filename) ^ line ^ g_hash(buffer);
+		auto it = logsHash.find(hash);
+		if (it != logsHash.end())
+		{
+			logs[it->second].count++;
+			std::swap(logs[it->second], logs.back());
+			return;
+		}
+		logsHash.insert(std::make_pair(hash, logs.size()));
+
+		sLogData log{};
+		log.color = color;
+		log.hash = hash;
+
+		if (verbose)
+		{
+			size = std::snprintf(nullptr, 0, "%s [%s] (%s:%d)\n%s", timestamp.c_str(), func, filename, line, buffer.c_str());
+			string temp;
+			temp.resize(size + 1);
+			std::snprintf(&temp[0], temp.size(), "%s [%s] (%s:%d)\n%s", timestamp.c_str(), func, filename, line, buffer.c_str());
+			log.message = std::move(temp);
+		}
+		else
+		{
+			log.message = buffer;
+		}
+
+#ifdef _DEBUG
+		std::cout << log.message << std::endl;
+#else
+		std::ofstream logFile("log.txt", std::ios::app);
+		if (logFile.is_open())
+		{
+			logFile << log.message << std::endl;
+			logFile.flush();
+			logFile.close();
+		}
+#endif
+
+		logs.emplace_back(std::move(log));
+		if (logs.size() > 1024)
+		{
+			logsHash.erase(logs.begin()->hash);
+			logs.erase(logs.begin());
+		}
+	}
+}
+
+static void bench_log_legacy(u32 thread, u32 i)
+{
+	legacy::Log(true, __FILE__, __LINE__, __func__, 0xFFFFFFFF, "Bench thread %u message %u value %f", thread, i, i * 0.5);
+}
+
+static void bench_log_async(u32 thread, u32 i)
+{
+	App::Log(true, __FILE__, __LINE__, __func__, 0xFFFFFFFF, "Bench thread %u message %u value %f", thread, i, i * 0.5);
+}
+
+static void bench_log()
+{
+	const u32 count = 20000;
+	const u32 threads[] = { 1, 4 };
+
+	for (u32 t : threads)
+	{
+		bench_report("log legacy", t, count, bench_run(t, count, bench_log_legacy, nullptr));
+		bench_report("log async", t, count, bench_run(t, count, bench_log_async, App::LogFlush));
+	}
+}
+
+// Profiler: cost of a zone with the profiler off and on, the ring is never drained here so it mostly measures drops once full
+static f64 bench_zone_ns(u32 count)
+{
+	auto start = bench_clock::now();
+	for (u32 i = 0; i < count; ++i)
+	{
+		PROFILE("Bench");
+	}
+	return std::chrono::duration<f64, std::nano>(bench_clock::now() - start).count() / count;
+}
+
+static void bench_profile()
+{
+	const u32 count = 1000000;
+
+	App::ProfEnable(false);
+	std::printf("%-16s %8.2f ns/zone\n", "zone disabled", bench_zone_ns(count));
+
+	App::ProfEnable(true);
+	std::printf("%-16s %8.2f ns/zone\n", "zone enabled", bench_zone_ns(count));
+	App::ProfEnable(false);
+}
+
+// Vertex ring bookkeeping: checked against known offsets and masks first, then timed. A failed check aborts.
+static sGlRingHead bench_ring_head(u32 size)
+{
+	sGlRingHead ring{};
+	ring.size = size;
+	return ring;
+}
+
+static void bench_ring_check(sGlRingHead& ring, u32 bytes, u32 stride, u32 offset, u32 leave, u32 wait, u32 retire)
+{
+	const u32 at = gl_ring_reserve(ring, bytes, stride);
+	ASSERT(at == offset && at % stride == 0, "ring offset");
+	ASSERT(ring.leave == leave && ring.wait == wait && ring.retire == retire, "ring fence masks");
+	ASSERT(ring.head == at + bytes && ring.segment == (ring.head - 1) / (ring.size / GL_RING_SEGMENTS), "ring head");
+}
+
+static void bench_ring()
+{
+	// Segments of 1 KB
+	sGlRingHead ring = bench_ring_head(8 * 1024);
+	bench_ring_check(ring, 100, 4, 0, 0, 0, 0);
+	bench_ring_check(ring, 10, 12, 108, 0, 0, 0);				// Aligned up to the stride
+	bench_ring_check(ring, 1000, 4, 120, 0, 0x02, 0x01);		// Into the next segment
+	bench_ring_check(ring, 3000, 4, 1120, 0, 0x1C, 0x0E);		// Across several
+	bench_ring_check(ring, 4072, 4, 4120, 0, 0xE0, 0x70);		// Up to the exact end, no wrap
+	bench_ring_check(ring, 8, 4, 0, 0x80, 0x01, 0);				// Wraps, leaving the last segment
+	bench_ring_check(ring, 1500, 4, 8, 0, 0x02, 0x01);
+	bench_ring_check(ring, 6000, 4, 1508, 0, 0xFC, 0x7E);
+	bench_ring_check(ring, 1200, 12, 0, 0x80, 0x03, 0x01);		// Wraps into two segments
+	ASSERT(ring.wraps == 2 && ring.bytes == 100 + 10 + 1000 + 3000 + 4072 + 8 + 1500 + 6000 + 1200, "ring totals");
+
+	// Random batches: every segment written was waited on unless the head already held it, every segment the head
+	// left was fenced, and nothing is written past the end
+	ring = bench_ring_head(64 * 1024);
+	const u32 segmentSize = ring.size / GL_RING_SEGMENTS;
+	u32 seed = 1;
+	for (u32 i = 0; i < 100000; ++i)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		const u32 stride = 4 * (1 + (seed >> 28));
+		const u32 bytes = stride * (1 + (seed >> 8) % (ring.size / 2 / stride - 1));
+		const u32 from = ring.segment;
+		const u32 wraps = ring.wraps;
+		const u32 at = gl_ring_reserve(ring, bytes, stride);
+		const bool wrapped = ring.wraps != wraps;
+
+		u32 written = 0;
+		for (u32 s = at / segmentSize; s <= ring.segment; ++s)
+			written |= 1u << s;
+		u32 left = 0;
+		for (u32 s = wrapped ? 0 : from; s < ring.segment; ++s)
+			left |= 1u << s;
+
+		ASSERT(at % stride == 0 && at + bytes <= ring.size, "ring bounds");
+		ASSERT(ring.wait == (wrapped ? written : written & ~(1u << from)), "ring waits");
+		ASSERT(ring.leave == (wrapped ? 1u << from : 0) && ring.retire == left, "ring fences");
+	}
+
+	const u32 count = 10000000;
+	ring = bench_ring_head(GL_RING_SIZE);
+	auto start = bench_clock::now();
+	for (u32 i = 0; i < count; ++i)
+		gl_ring_reserve(ring, 4096 + (i & 1023) * 12, 12);
+	const f64 ns = std::chrono::duration<f64, std::nano>(bench_clock::now() - start).count() / count;
+	std::printf("%-16s %8.2f ns/reserve, %u wraps\n", "ring reserve", ns, ring.wraps);
+}
+
+struct sBench
+{
+	cstring name;
+	void (*run)();
+};
+
+static const sBench g_benches[] =
+{
+	{ "log", bench_log },
+	{ "profile", bench_profile },
+	{ "ring", bench_ring },
+};
+
+int main(int argc, char** args)
+{
+	cstring filter = argc > 1 ? args[1] : "";
+
+	for (const auto& bench : g_benches)
+	{
+		if (std::strstr(bench.name, filter) == nullptr)
+			continue;
+
+		std::printf("== %s\n", bench.name);
+		bench.run();
+	}
+
+	return EXIT_SUCCESS;
+}
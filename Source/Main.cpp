@@ -1,7 +1,52 @@
 #include <App.hpp>
 
+#include <new>
+#include <cstdlib>
+
 using namespace GASandbox;
 
+// Every other heap allocation is counted, the memory panel and reports show what is left once a scene is warm.
+// Replaced here rather than in GASandboxLib so the bake tool and the benchmarks keep the standard allocator.
+void* operator new(std::size_t size)
+{
+	App::MemCountHeapAlloc();
+	if (size == 0)
+		size = 1;
+
+	for (;;)
+	{
+		if (void* ptr = std::malloc(size))
+			return ptr;
+
+		std::new_handler handler = std::get_new_handler();
+		if (handler == nullptr)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+void* operator new[](std::size_t size)
+{
+	return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try { return ::operator new(size); }
+	catch (...) { return nullptr; }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	try { return ::operator new(size); }
+	catch (...) { return nullptr; }
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+
 int main(int argc, char** args)
 {
 	return App::Run(argc, args);